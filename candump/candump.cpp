@@ -7,11 +7,17 @@
 #include <fstream>
 
 #include <sys/neutrino.h>
+#include <sys/syspage.h>
 
+#include <errno.h>
 #include <fcntl.h>
+#include <sys/select.h>
 #include <unistd.h>
 
 #include <can.h>
+#include <can_error.h>
+#include <canrm.h>
+#include <can_shm.h>
 
 #define SILENT_INI 42 /* detect user setting on commandline */
 #define SILENT_OFF 0 /* no silent mode */
@@ -19,6 +25,8 @@
 
 #define SWAP_DELIMITER '`'
 
+#define READ_BATCH_SIZE 64 /* frames requested by one read() */
+
 std::chrono::steady_clock::time_point lastTp;
 
 static char* progname;
@@ -27,6 +35,9 @@ unsigned char timeStamp = 0;
 unsigned char logTimeStamp = 'a';
 unsigned char useNs = 0;
 
+/* time since the driver took the printed frame out of the controller */
+std::chrono::nanoseconds frameAge(0);
+
 extern int optind;
 
 void PrintUsage(void)
@@ -44,6 +55,7 @@ void PrintUsage(void)
 	std::cout << "         -n <count>  (terminate after reception of <count> CAN frames)" << std::endl;
 	std::cout << "         -e          (dump CAN error frames in human-readable format)" << std::endl;
 	std::cout << "         -T <msecs>  (terminate after <msecs> if no frames were received)" << std::endl;
+	std::cout << "         -m          (read the frames from the driver shared memory, see canrmd -M)" << std::endl;
 	std::cout << std::endl;
 	std::cout << "One CAN interfaces with optional filter sets can be specified" << std::endl;
 	std::cout << "on the commandline in the form: <ifname>[,filter]*" << std::endl;
@@ -67,7 +79,7 @@ std::ostream& SprintTimestamp(std::ostream& os)
 	switch (timeStamp) {
 	case 'a': /* absolute with timestamp */
 	{
-		const auto now = std::chrono::system_clock::now();
+		const auto now = std::chrono::system_clock::now() - frameAge;
 		const auto duration = now.time_since_epoch();
 
 		const auto sec = std::chrono::duration_cast<std::chrono::seconds>(duration);
@@ -85,7 +97,7 @@ std::ostream& SprintTimestamp(std::ostream& os)
 	}
 	case 'A': /* absolute with date */
 	{
-		const auto now = std::chrono::system_clock::now();
+		const auto now = std::chrono::time_point_cast<std::chrono::system_clock::duration>(std::chrono::system_clock::now() - frameAge);
 		const auto time_t = std::chrono::system_clock::to_time_t(now);
 		std::tm tm = *std::localtime(&time_t);
 
@@ -108,7 +120,7 @@ std::ostream& SprintTimestamp(std::ostream& os)
 	case 'd': /* delta */
 	case 'z': /* starting with zero */
 	{
-		const auto now = std::chrono::steady_clock::now();
+		const auto now = std::chrono::time_point_cast<std::chrono::steady_clock::duration>(std::chrono::steady_clock::now() - frameAge);
 
 		if (lastTp == std::chrono::steady_clock::time_point()) /* first init */
 			lastTp = now;
@@ -139,6 +151,124 @@ std::ostream& SprintTimestamp(std::ostream& os)
 	return os;
 }
 
+// Age of a driver receive timestamp, the driver and we share the ClockCycles() counter.
+std::chrono::nanoseconds TimestampAge(uint64_t timestamp)
+{
+	const uint64_t cyclesPerSec = SYSPAGE_ENTRY(qtime)->cycles_per_sec;
+	const uint64_t cycles = ClockCycles() - timestamp;
+
+	return std::chrono::seconds(cycles / cyclesPerSec) +
+	       std::chrono::nanoseconds(((cycles % cyclesPerSec) * 1000000000) / cyclesPerSec);
+}
+
+// Protocol error locations of data[3], see can_error.h
+const char* ErrorLocation(uint8_t location)
+{
+	switch (location) {
+	case CAN_ERR_PROT_LOC_SOF:     return "start-of-frame";
+	case CAN_ERR_PROT_LOC_ID28_21: return "id.28-to-id.21";
+	case CAN_ERR_PROT_LOC_ID20_18: return "id.20-to-id.18";
+	case CAN_ERR_PROT_LOC_SRTR:    return "substitute-rtr-bit";
+	case CAN_ERR_PROT_LOC_IDE:     return "identifier-extension";
+	case CAN_ERR_PROT_LOC_ID17_13: return "id.17-to-id.13";
+	case CAN_ERR_PROT_LOC_ID12_05: return "id.12-to-id.05";
+	case CAN_ERR_PROT_LOC_ID04_00: return "id.04-to-id.00";
+	case CAN_ERR_PROT_LOC_RTR:     return "rtr-bit";
+	case CAN_ERR_PROT_LOC_RES1:    return "reserved-bit-1";
+	case CAN_ERR_PROT_LOC_RES0:    return "reserved-bit-0";
+	case CAN_ERR_PROT_LOC_DLC:     return "data-length-code";
+	case CAN_ERR_PROT_LOC_DATA:    return "data-field";
+	case CAN_ERR_PROT_LOC_CRC_SEQ: return "crc-sequence";
+	case CAN_ERR_PROT_LOC_CRC_DEL: return "crc-delimiter";
+	case CAN_ERR_PROT_LOC_ACK:     return "ack-slot";
+	case CAN_ERR_PROT_LOC_ACK_DEL: return "ack-delimiter";
+	case CAN_ERR_PROT_LOC_EOF:     return "end-of-frame";
+	case CAN_ERR_PROT_LOC_INTERM:  return "intermission";
+	default:                       return "unspecified";
+	}
+}
+
+// Prints the bit names of value which are set, comma separated
+void SprintBits(std::ostream& os, uint8_t value, const char* const names[8])
+{
+	const char* separator = "";
+
+	for (int bit = 0; bit < 8; ++bit)
+	{
+		if (value & (1 << bit))
+		{
+			os << separator << names[bit];
+			separator = ",";
+		}
+	}
+}
+
+// Error classes and details of an error frame, like can-utils candump -e
+void SprintCanError(std::ostream& os, const can_frame& message)
+{
+	static const char* const controllerProblems[8] = {
+		"rx-overflow", "tx-overflow", "rx-error-warning", "tx-error-warning",
+		"rx-error-passive", "tx-error-passive", "back-to-error-active", "unspecified" };
+
+	static const char* const protocolViolations[8] = {
+		"single-bit-error", "frame-format-error", "bit-stuffing-error", "tried-to-send-dominant-bit",
+		"tried-to-send-recessive-bit", "bus-overload", "active-error", "error-on-tx" };
+
+	const canid_t errorClass = message.can_id & CAN_ERR_MASK;
+
+	os << "  ERRORFRAME";
+
+	if (errorClass & CAN_ERR_TX_TIMEOUT)
+	{
+		os << std::endl << "	tx-timeout";
+	}
+
+	if (errorClass & CAN_ERR_LOSTARB)
+	{
+		os << std::endl << "	lost-arbitration{at bit " << std::dec << int(message.data[0]) << "}";
+	}
+
+	if (errorClass & CAN_ERR_CRTL)
+	{
+		os << std::endl << "	controller-problem{";
+		SprintBits(os, message.data[1], controllerProblems);
+		os << "}";
+	}
+
+	if (errorClass & CAN_ERR_PROT)
+	{
+		os << std::endl << "	protocol-violation{{";
+		SprintBits(os, message.data[2], protocolViolations);
+		os << "}{" << ErrorLocation(message.data[3]) << "}}";
+	}
+
+	if (errorClass & CAN_ERR_ACK)
+	{
+		os << std::endl << "	no-acknowledgement-on-tx";
+	}
+
+	if (errorClass & CAN_ERR_BUSOFF)
+	{
+		os << std::endl << "	bus-off";
+	}
+
+	if (errorClass & CAN_ERR_BUSERROR)
+	{
+		os << std::endl << "	bus-error";
+	}
+
+	if (errorClass & CAN_ERR_RESTARTED)
+	{
+		os << std::endl << "	restarted-after-bus-off";
+	}
+
+	if (errorClass & CAN_ERR_CNT)
+	{
+		os << std::endl << "	error-counter-tx-rx{{" << std::dec << int(message.data[6])
+		   << "}{" << int(message.data[7]) << "}}";
+	}
+}
+
 std::vector<std::string> SplitString(const std::string& input)
 {
     std::vector<std::string> tokens;
@@ -207,6 +337,92 @@ bool CanFilterPassed(const std::vector<can_filter>& canFilters, const can_frame&
 	return false;
 }
 
+// Hand the filters over to the driver, so rejected frames are not copied to us at all.
+// Older drivers don't know EDCMD_SET_FILTERS, then the filters are checked here.
+// Error frames of the classes in errorMask are selected by an additional rule.
+bool InstallDriverFilters(int canController, const std::vector<can_filter>& canFilters, can_err_mask_t errorMask)
+{
+	const size_t count = canFilters.size() + (errorMask ? 1 : 0);
+
+	std::vector<uint8_t> buffer(sizeof(CanFilterSetHeader) + count * sizeof(CanFilterRule));
+
+	CanFilterSetHeader* header = reinterpret_cast<CanFilterSetHeader*>(buffer.data());
+	CanFilterRule* rules = reinterpret_cast<CanFilterRule*>(header + 1);
+
+	header->count_ = count;
+
+	if (errorMask)
+	{
+		rules[canFilters.size()].type_ = CanFilterRule::ET_ERROR;
+		rules[canFilters.size()].id_ = 0;
+		rules[canFilters.size()].mask_ = errorMask;
+		rules[canFilters.size()].upper_ = 0;
+	}
+
+	for(size_t i = 0; i < canFilters.size(); ++i)
+	{
+		const bool inverse = (canFilters[i].can_id & CAN_INV_FILTER);
+
+		rules[i].type_ = inverse ? CanFilterRule::ET_INV_MASK : CanFilterRule::ET_MASK;
+		rules[i].id_ = canFilters[i].can_id & ~CAN_INV_FILTER;
+		rules[i].mask_ = canFilters[i].can_mask;
+		rules[i].upper_ = 0;
+	}
+
+	return EOK == devctl(canController, EDCMD_SET_FILTERS, buffer.data(), buffer.size(), nullptr);
+}
+
+// Takes the frames from the shared receive history of the driver, the file is
+// only used to sleep while there is nothing new.
+template <typename DumpFrame>
+bool DumpSharedMemory(int canController, DumpFrame dumpFrame)
+{
+	CanShmReader reader;
+
+	if (!reader.Attach(canController))
+	{
+		std::cout << "shared memory attach error" << std::endl;
+		return false;
+	}
+
+	for (;;)
+	{
+		can_frame message;
+		uint64_t timestamp;
+
+		switch (reader.Read(message, &timestamp))
+		{
+		case CanShmReader::ER_FRAME:
+			if (!dumpFrame(message, timestamp))
+			{
+				return true;
+			}
+			break;
+
+		case CanShmReader::ER_OVERRUN:
+			std::cerr << "frames lost, reader is too slow" << std::endl;
+			break;
+
+		case CanShmReader::ER_EMPTY:
+		{
+			// wake up with the first frame after the last one taken
+			lseek(canController, reader.Next(), SEEK_SET);
+
+			fd_set readSet;
+			FD_ZERO(&readSet);
+			FD_SET(canController, &readSet);
+
+			if (-1 == select(canController + 1, &readSet, nullptr, nullptr, nullptr))
+			{
+				std::cout << "select error" << std::endl;
+				return false;
+			}
+			break;
+		}
+		}
+	}
+}
+
 int main(int argc, char *argv[]) {
 
 	progname = argv[0];
@@ -217,8 +433,10 @@ int main(int argc, char *argv[]) {
 	std::string logname;
 	int asciiView = 0;
 	unsigned char silent = SILENT_INI;
+	bool sharedMemory = false;
+	can_err_mask_t errorMask = 0;
 
-	while ((option = getopt(argc, argv, "t:HNciaSs:lf:Ln:r:Dde8xT:h?")) != -1)
+	while ((option = getopt(argc, argv, "t:HNciaSs:lf:Ln:r:Dde8xT:mh?")) != -1)
 	{
 		switch (option)
 		{
@@ -260,6 +478,14 @@ int main(int argc, char *argv[]) {
 			log = 1;
 			break;
 
+		case 'm':
+			sharedMemory = true;
+			break;
+
+		case 'e':
+			errorMask = CAN_ERR_MASK;
+			break;
+
 		case 'n':
 			count = atoi(optarg);
 			if (count < 1)
@@ -350,71 +576,139 @@ int main(int argc, char *argv[]) {
         return -1;
     }
 
-    while (true)
+    // error frames come with an error rule only, the data frames keep the '0:0' default
+    if (errorMask && canFilters.empty())
     {
-        can_frame message;
+        canFilters.emplace_back(can_filter{0, 0});
+    }
 
-        auto result = read(canController, &message, sizeof(can_frame));
+    // the shared memory holds all frames, the driver filters only select the wakeups
+    if (!canFilters.empty() && InstallDriverFilters(canController, canFilters, errorMask) && !sharedMemory)
+    {
+        canFilters.clear();
+    }
 
-        if (-1 == result)
+    // prints one frame stamped with the driver receive time, returns false when the frame count limit is reached
+    auto dumpFrame = [&](const can_frame& message, uint64_t timestamp)
+    {
+        const bool errorFrame = (message.can_id & CAN_ERR_FLAG) != 0;
+
+        if (errorFrame && !errorMask)
         {
-            std::cout << "read error" << std::endl;
-            break;
+            return true;
         }
 
-        if (result != 0 && (canFilters.empty() || CanFilterPassed(canFilters, message)))
+        if (!errorFrame && !canFilters.empty() && !CanFilterPassed(canFilters, message))
         {
-        	std::ostringstream os;
+            return true;
+        }
 
-        	os << SprintTimestamp << " ";
-        	os << tokens[0];
+        frameAge = TimestampAge(timestamp);
 
-      		os << std::hex << std::setfill(' ') << std::setw(10) << (message.can_id & CAN_EFF_MASK);
-      		os << std::dec << std::setfill(' ') << std::setw(3) << int(message.len) << " ";
+    	std::ostringstream os;
 
-      		for(int i = 0; i < 8; ++i)
-      		{
-      			if(message.len <= i)
-      			{
-      				os	<< "   ";
-      			}
-      			else
-      			{
-      				os << " " << std::hex << std::setfill('0') << std::setw(2) << int(message.data[i]);
-      			}
-      		}
+    	os << SprintTimestamp << " ";
+    	os << tokens[0];
 
-      		if(asciiView)
-      		{
-      			os << "  ";
-
-      			for(int i = 0; i < message.len; ++i)
-          		{
-      				if(message.data[i] > 31 && message.data[i] != 127)
-      				{
-      					os << message.data[i];
-      				}
-      				else
-      				{
-      					os << '.';
-      				}
-          		}
-      		}
+  		os << std::hex << std::setfill(' ') << std::setw(10) << (message.can_id & CAN_EFF_MASK);
+  		os << std::dec << std::setfill(' ') << std::setw(3) << int(message.len) << " ";
 
-      		if(silent != SILENT_ON)
-      		{
-      			std::cout << os.str() << std::endl;
-      		}
+  		for(int i = 0; i < 8; ++i)
+  		{
+  			if(message.len <= i)
+  			{
+  				os	<< "   ";
+  			}
+  			else
+  			{
+  				os << " " << std::hex << std::setfill('0') << std::setw(2) << int(message.data[i]);
+  			}
+  		}
+
+  		if(asciiView)
+  		{
+  			os << "  ";
 
-      		if(log && logFile)
+  			for(int i = 0; i < message.len; ++i)
       		{
-      			logFile << os.str() << std::endl;
+  				if(message.data[i] > 31 && message.data[i] != 127)
+  				{
+  					os << message.data[i];
+  				}
+  				else
+  				{
+  					os << '.';
+  				}
       		}
+  		}
 
-			if(count && (--count == 0))
-			{
-				break;
-			}
+  		if(errorFrame)
+  		{
+  			SprintCanError(os, message);
+  		}
+
+  		if(silent != SILENT_ON)
+  		{
+  			std::cout << os.str() << std::endl;
+  		}
+
+  		if(log && logFile)
+  		{
+  			logFile << os.str() << std::endl;
+  		}
+
+        return !(count && (--count == 0));
+    };
+
+    if (sharedMemory)
+    {
+        return DumpSharedMemory(canController, dumpFrame) ? 0 : 1;
+    }
+
+    // frames carry the receive timestamps of the driver, older drivers are stamped here
+    const uint32_t frameFormat = ECFF_TIMED_FRAME;
+    const bool timedFrames = (EOK == devctl(canController, EDCMD_SET_FRAME_FORMAT, &frameFormat, sizeof(frameFormat), nullptr));
+
+    bool terminate = false;
+
+    while (!terminate && timedFrames)
+    {
+        CanTimedFrame messages[READ_BATCH_SIZE];
+
+        auto result = read(canController, messages, sizeof(messages));
+
+        if (-1 == result)
+        {
+            std::cout << "read error" << std::endl;
+            break;
+        }
+
+        for (size_t n = 0; n < result / sizeof(CanTimedFrame); ++n)
+        {
+            if (!dumpFrame(messages[n].frame_, messages[n].timestamp_))
+            {
+                terminate = true;
+                break;
+            }
+        }
+    }
+
+    // older drivers take exactly one can_frame per read() and refuse larger buffers
+    while (!terminate && !timedFrames)
+    {
+        can_frame message;
+
+        auto result = read(canController, &message, sizeof(message));
+
+        if (-1 == result)
+        {
+            std::cout << "read error" << std::endl;
+            break;
+        }
+
+        if ((sizeof(can_frame) == result) && !dumpFrame(message, ClockCycles()))
+        {
+            terminate = true;
         }
     }
 
@@ -164,7 +164,7 @@ int main(int argc, char **argv)
 	std::string controllerName("/dev/");
 	controllerName += argv[1];
 
-	int canController = open(controllerName.c_str(), O_RDWR | O_APPEND);
+	int canController = open(controllerName.c_str(), O_WRONLY | O_APPEND);
 
 	if (-1 == canController)
 	{
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/neutrino.h>
+
+#include <can.h>
+#include <canrm.h>
+
+//==============================================================================
+// Receive history of the driver exported as read only shared memory.
+//
+// Layout: CanShmHeader | sequence words [slotCount_] | frames [slotCount_] |
+//         receive timestamps [slotCount_]
+//
+// Frame number n is stored in slot n & (slotCount_ - 1). The sequence word of
+// the slot is 2n + 1 while the driver writes the frame and 2n + 2 once it is
+// complete, head_ is the number of the next frame.
+
+struct CanShmHeader
+{
+    static const std::uint32_t MAGIC = 0x524e4143;     // "CANR"
+
+    std::uint32_t magic_;
+    std::uint32_t slotCount_;
+    std::uint32_t sequenceOffset_;
+    std::uint32_t frameOffset_;
+    std::uint32_t timestampOffset_;     // ClockCycles() of the frames
+
+    std::atomic<std::uint32_t> head_;
+};
+
+//==============================================================================
+// Reply of EDCMD_GET_RX_SHM
+
+struct CanShmInfo
+{
+    char name_[64];
+    std::uint32_t size_;
+};
+
+//==============================================================================
+// Client side reader of the shared receive history.
+//
+// Read() takes frames with plain loads. When it reports ER_EMPTY the client
+// may lseek() the file to Next() and wait with select() or ionotify(), the
+// driver wakes it when a frame at or after that position is received.
+
+class CanShmReader
+{
+public:
+
+    enum EResult
+    {
+        ER_FRAME,
+        ER_EMPTY,
+        ER_OVERRUN      // frames were overwritten before they were read, Next() is moved on
+    };
+
+    CanShmReader()
+     : header_(0)
+     , size_(0)
+     , next_(0)
+    { }
+
+    ~CanShmReader()
+    {
+        if(0 != header_)
+        {
+            munmap(const_cast<CanShmHeader*>(header_), size_);
+        }
+    }
+
+    bool Attach(int canController)
+    {
+        CanShmInfo info;
+
+        if(EOK != devctl(canController, EDCMD_GET_RX_SHM, &info, sizeof(info), nullptr))
+        {
+            return false;
+        }
+
+        info.name_[sizeof(info.name_) - 1] = 0;
+
+        const int fd = shm_open(info.name_, O_RDONLY, 0);
+
+        if(-1 == fd)
+        {
+            return false;
+        }
+
+        void* memory = mmap(0, info.size_, PROT_READ, MAP_SHARED, fd, 0);
+
+        close(fd);
+
+        if(MAP_FAILED == memory)
+        {
+            return false;
+        }
+
+        header_ = static_cast<const CanShmHeader*>(memory);
+        size_ = info.size_;
+
+        if(CanShmHeader::MAGIC != header_->magic_)
+        {
+            return false;
+        }
+
+        const std::uint8_t* base = static_cast<const std::uint8_t*>(memory);
+
+        sequence_ = reinterpret_cast<const std::atomic<std::uint32_t>*>(base + header_->sequenceOffset_);
+        frames_ = reinterpret_cast<const can_frame*>(base + header_->frameOffset_);
+        timestamps_ = reinterpret_cast<const std::uint64_t*>(base + header_->timestampOffset_);
+
+        next_ = header_->head_.load(std::memory_order_acquire);
+
+        return true;
+    }
+
+    EResult Read(can_frame& canFrame, std::uint64_t* timestamp = nullptr)
+    {
+        if(next_ == header_->head_.load(std::memory_order_acquire))
+        {
+            return ER_EMPTY;
+        }
+
+        const std::uint32_t slot = next_ & (header_->slotCount_ - 1);
+        const std::uint32_t expected = 2 * next_ + 2;
+
+        const std::uint32_t before = sequence_[slot].load(std::memory_order_acquire);
+
+        memcpy(&canFrame, &frames_[slot], sizeof(canFrame));
+
+        if(timestamp != nullptr)
+        {
+            *timestamp = timestamps_[slot];
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        const std::uint32_t after = sequence_[slot].load(std::memory_order_relaxed);
+
+        if((before != expected) || (after != expected))
+        {
+            // continue with the oldest frame which is still available
+            next_ = header_->head_.load(std::memory_order_acquire) - header_->slotCount_ + 1;
+
+            return ER_OVERRUN;
+        }
+
+        ++next_;
+
+        return ER_FRAME;
+    }
+
+    std::uint32_t Next() const { return next_; }
+
+private:
+
+    const CanShmHeader* header_;
+    const std::atomic<std::uint32_t>* sequence_;
+    const can_frame* frames_;
+    const std::uint64_t* timestamps_;
+
+    std::size_t size_;
+
+    std::uint32_t next_;
+};
+
+//==============================================================================
+// Transmit ring of an open file, created by the driver with EDCMD_ATTACH_TX_SHM.
+//
+// Layout: CanShmTxRing | frames [slotCount_]
+//
+// The client is the only producer (head_), the driver the only consumer
+// (tail_). The driver sets idle_ when it found the ring empty; the client then
+// rings the doorbell pulse once after its next frame. While the driver keeps
+// finding frames no pulse is needed.
+
+struct CanShmTxRing
+{
+    static const std::uint32_t MAGIC = 0x584e4143;     // "CANX"
+
+    std::uint32_t magic_;
+    std::uint32_t slotCount_;
+    std::uint32_t frameOffset_;
+
+    alignas(64) std::atomic<std::uint32_t> head_;
+    alignas(64) std::atomic<std::uint32_t> tail_;
+    std::atomic<std::uint32_t> idle_;
+};
+
+//==============================================================================
+// Data of EDCMD_ATTACH_TX_SHM. The object belongs to the user of the client,
+// the driver unlinks it when the file is closed or another ring is attached.
+
+struct CanShmTxAttach
+{
+    std::uint32_t slotCount_;   // in: frames of the ring, a power of two up to 65536
+    char name_[64];             // out: shared memory object of the ring
+    std::uint32_t size_;        // out: size of the object
+    std::int32_t doorbell_;     // out: pulse code of the doorbell
+};
+
+//==============================================================================
+// Client side producer of a transmit ring
+
+class CanShmTxWriter
+{
+public:
+
+    CanShmTxWriter()
+     : ring_(0)
+     , frames_(0)
+     , size_(0)
+     , slotCount_(0)
+     , canController_(-1)
+     , doorbell_(0)
+    { }
+
+    ~CanShmTxWriter()
+    {
+        if(0 != ring_)
+        {
+            munmap(ring_, size_);
+        }
+    }
+
+    // slotCount must be a power of two
+    bool Attach(int canController, std::uint32_t slotCount)
+    {
+        CanShmTxAttach attach;
+
+        memset(&attach, 0, sizeof(attach));
+        attach.slotCount_ = slotCount;
+
+        if(EOK != devctl(canController, EDCMD_ATTACH_TX_SHM, &attach, sizeof(attach), nullptr))
+        {
+            return false;
+        }
+
+        attach.name_[sizeof(attach.name_) - 1] = 0;
+
+        const int fd = shm_open(attach.name_, O_RDWR, 0);
+
+        if(-1 == fd)
+        {
+            return false;
+        }
+
+        void* memory = mmap(0, attach.size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        close(fd);
+
+        if(MAP_FAILED == memory)
+        {
+            return false;
+        }
+
+        ring_ = static_cast<CanShmTxRing*>(memory);
+        size_ = attach.size_;
+
+        if((CanShmTxRing::MAGIC != ring_->magic_) || (slotCount != ring_->slotCount_))
+        {
+            return false;
+        }
+
+        frames_ = reinterpret_cast<can_frame*>(static_cast<std::uint8_t*>(memory) + ring_->frameOffset_);
+        slotCount_ = slotCount;
+
+        canController_ = canController;
+        doorbell_ = attach.doorbell_;
+
+        return true;
+    }
+
+    // Returns false if the ring is full
+    bool Write(const can_frame& canFrame)
+    {
+        const std::uint32_t head = ring_->head_.load(std::memory_order_relaxed);
+
+        if((head - ring_->tail_.load(std::memory_order_acquire)) == slotCount_)
+        {
+            return false;
+        }
+
+        frames_[head & (slotCount_ - 1)] = canFrame;
+
+        ring_->head_.store(head + 1, std::memory_order_release);
+
+        // pairs with the fence of the driver between setting idle_ and checking head_
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if((0 != ring_->idle_.load(std::memory_order_relaxed)) &&
+           (0 != ring_->idle_.exchange(0, std::memory_order_relaxed)))
+        {
+            MsgSendPulse(canController_, -1, doorbell_, 0);
+        }
+
+        return true;
+    }
+
+private:
+
+    CanShmTxRing* ring_;
+    can_frame* frames_;
+
+    std::size_t size_;
+
+    std::uint32_t slotCount_;
+
+    int canController_;
+    std::int32_t doorbell_;
+};
+
+//==============================================================================
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <cstdint>
+
+#include "can.h"
+
+#ifdef __QNX__
+#include <devctl.h>
+#else // __QNX__
+#define _POSIX_DEVDIR_TO 0
+#define _POSIX_DEVDIR_FROM 0
+#define _POSIX_DEVDIR_TOFROM 0
+#endif // __QNX__
+
+
+//==============================================================================
+
+enum ECanResMgr_DCMD
+{
+    EDCMD_UNDEFINED     = 0,
+    EDCMD_SET_MASK      = 1 + _POSIX_DEVDIR_TO,
+    EDCMD_SET_FILTERS   = 2 + _POSIX_DEVDIR_TO,   // CanFilterSetHeader followed by CanFilterRule[count_]
+    EDCMD_GET_RX_SHM    = 3 + _POSIX_DEVDIR_FROM, // CanShmInfo of the shared receive history
+    EDCMD_ATTACH_TX_SHM = 4 + _POSIX_DEVDIR_TOFROM, // CanShmTxAttach, transmit ring created for the file
+    EDCMD_SET_FRAME_FORMAT = 5 + _POSIX_DEVDIR_TO,  // uint32_t ECanFrameFormat of read()
+    EDCMD_SET_CYCLIC_TX = 6 + _POSIX_DEVDIR_TO,     // CanCyclicJob, adds or updates a cyclic transmission
+    EDCMD_DEL_CYCLIC_TX = 7 + _POSIX_DEVDIR_TO,     // uint32_t job identifier
+    EDCMD_GET_CYCLIC_STATS = 8 + _POSIX_DEVDIR_TOFROM, // CanCyclicStats, jobId_ selects the job
+    EDCMD_SET_RX_JOB    = 9 + _POSIX_DEVDIR_TO,     // CanRxJob, adds or replaces the receive job of an identifier
+    EDCMD_DEL_RX_JOB    = 10 + _POSIX_DEVDIR_TO,    // uint32_t CAN identifier with CAN_EFF_FLAG / CAN_RTR_FLAG
+    EDCMD_GET_RX_JOB_STATUS = 11 + _POSIX_DEVDIR_TOFROM, // CanRxJobStatus, canId_ selects the job
+    EDCMD_SET_ISOTP     = 12 + _POSIX_DEVDIR_TO,    // CanIsoTpConfig, read() and write() transfer ISO-TP PDUs
+    EDCMD_GET_STATS     = 13 + _POSIX_DEVDIR_FROM,  // CanStats of the channel and the open file
+};
+
+//==============================================================================
+
+struct CanMessageFilter
+{
+    enum EType
+    {
+        ET_DISABLED     = 0,
+        ET_AMASK        = 1,
+        ET_RANGE        = 2,
+    } type_;
+
+    union
+    {
+        std::uint32_t acceptanceMask_;
+        std::uint32_t lower_;
+    };
+
+    union
+    {
+        std::uint32_t acceptancePattern_;
+        std::uint32_t upper_;
+    };
+
+    CanMessageFilter()
+     : type_(ET_DISABLED)
+     , lower_(0)
+     , upper_(0)
+    { }
+
+    CanMessageFilter(EType type, std::uint32_t first, std::uint32_t second)
+     : type_(type)
+     , lower_(first)
+     , upper_(second)
+    { }
+
+    CanMessageFilter(const CanMessageFilter &tcmf)
+     : type_(tcmf.type_)
+     , lower_(tcmf.lower_)
+     , upper_(tcmf.upper_)
+    { }
+
+
+};
+
+//==============================================================================
+// Filter rule of EDCMD_SET_FILTERS, a frame is accepted if any rule matches.
+// Without rules no data frame is accepted.
+
+struct CanFilterRule
+{
+    enum EType
+    {
+        ET_MASK         = 1,    // (can_id & mask_) == (id_ & mask_)
+        ET_INV_MASK     = 2,    // (can_id & mask_) != (id_ & mask_)
+        ET_RANGE        = 3,    // id_ <= (can_id & CAN_EFF_MASK) <= upper_,
+                                // frame flags selected by mask_ equal to the flags of id_
+        ET_ERROR        = 4,    // error frames of the classes in mask_
+    };
+
+    std::uint32_t type_;
+
+    // CAN identifier with CAN_EFF_FLAG / CAN_RTR_FLAG, lower bound of ET_RANGE
+    std::uint32_t id_;
+
+    // CAN mask with CAN_EFF_FLAG / CAN_RTR_FLAG, flag mask of ET_RANGE, error class mask of ET_ERROR
+    std::uint32_t mask_;
+
+    // Upper bound of ET_RANGE
+    std::uint32_t upper_;
+};
+
+struct CanFilterSetHeader
+{
+    static const std::uint32_t MAX_RULES = 256;
+
+    std::uint32_t count_;
+};
+
+//==============================================================================
+
+//==============================================================================
+// Element of read() selected with EDCMD_SET_FRAME_FORMAT
+
+enum ECanFrameFormat
+{
+    ECFF_FRAME          = 0,    // can_frame
+    ECFF_TIMED_FRAME    = 1,    // CanTimedFrame
+};
+
+struct CanTimedFrame
+{
+    can_frame frame_;
+
+    // ClockCycles() when the frame was taken out of the controller
+    std::uint64_t timestamp_;
+};
+
+//==============================================================================
+
+//==============================================================================
+// Cyclic transmission of EDCMD_SET_CYCLIC_TX, driven by the driver scheduler.
+// Jobs belong to the open file, they are deleted when it is closed.
+
+struct CanCyclicJob
+{
+    // Chosen by the client, unique per open file
+    std::uint32_t jobId_;
+
+    // Period, at least MIN_PERIOD_US
+    std::uint32_t periodUs_;
+
+    // Delay of the first transmission
+    std::uint32_t phaseUs_;
+
+    // Number of transmissions, 0 for an endless job
+    std::uint32_t count_;
+
+    can_frame frame_;
+
+    static const std::uint32_t MIN_PERIOD_US = 1000;
+};
+
+// Statistics of a job, the period error is the measured interval between
+// two releases to the transmit queue minus the period
+struct CanCyclicStats
+{
+    std::uint32_t jobId_;
+
+    // Transmissions left, 0 for an endless job
+    std::uint32_t remaining_;
+
+    std::uint64_t released_;            // frames put to the transmit queue
+    std::uint64_t refused_;             // releases refused by a full transmit queue
+    std::uint64_t skipped_;             // periods skipped, the scheduler was late by a period or more
+
+    std::int64_t minPeriodErrorNs_;
+    std::int64_t maxPeriodErrorNs_;
+    std::uint64_t meanAbsPeriodErrorNs_;
+
+    std::uint64_t maxLatenessNs_;       // release after the scheduled time
+};
+
+//==============================================================================
+
+//==============================================================================
+// Receive job of EDCMD_SET_RX_JOB for one CAN identifier of the open file.
+// Frames of the identifier which pass the filter are only returned by read()
+// when the job passes them as well; other identifiers are not affected.
+// Jobs belong to the open file, they are deleted when it is closed.
+
+struct CanRxJob
+{
+    enum EFlags
+    {
+        ERJF_CHANGE     = 0x01, // pass a frame only if the DLC or the masked data differs
+                                // from the frame passed before
+    };
+
+    // CAN identifier with CAN_EFF_FLAG / CAN_RTR_FLAG
+    std::uint32_t canId_;
+
+    std::uint32_t flags_;
+
+    // Minimal interval between two passed frames, 0 for no throttling.
+    // A change suppressed by the throttle is passed with the next copy after the interval
+    std::uint32_t throttleUs_;
+
+    // The job times out when no frame arrives for this time, 0 for no timeout.
+    // A timeout is reported as _NOTIFY_COND_OBAND (select() exception) and in
+    // CanRxJobStatus; the first frame after a timeout is always passed
+    std::uint32_t timeoutUs_;
+
+    // Data bits compared by ERJF_CHANGE
+    std::uint8_t dataMask_[CAN_MAX_DLEN];
+
+    static const std::uint32_t MAX_JOBS = 1024;
+};
+
+struct CanRxJobStatus
+{
+    std::uint32_t canId_;
+
+    // 1 while the frame is overdue
+    std::uint32_t timedOut_;
+
+    std::uint64_t received_;            // frames of the identifier
+    std::uint64_t passed_;              // frames returned to read()
+    std::uint64_t timeouts_;
+
+    // ClockCycles() of the last received frame, the job setup before the first one
+    std::uint64_t lastTimestamp_;
+};
+
+//==============================================================================
+
+//==============================================================================
+// ISO 15765-2 endpoint of EDCMD_SET_ISOTP, normal or normal fixed addressing.
+// The open file reads and writes whole PDUs of up to MAX_PDU bytes; the
+// driver segments, reassembles and answers flow control. A write returns
+// when the last consecutive frame is queued for transmission.
+
+struct CanIsoTpConfig
+{
+    enum EFlags
+    {
+        EITF_PADDING    = 0x01, // frames are filled up to 8 bytes with padByte_
+    };
+
+    // CAN identifiers with CAN_EFF_FLAG of the sent and the received frames
+    std::uint32_t txId_;
+    std::uint32_t rxId_;
+
+    std::uint32_t flags_;
+
+    // Flow control sent to the peer: consecutive frames per block (0 for all)
+    // and the minimal separation time in the ISO 15765-2 STmin encoding
+    std::uint8_t blockSize_;
+    std::uint8_t stMin_;
+
+    std::uint8_t padByte_;
+    std::uint8_t reserved_;
+
+    static const std::uint32_t MAX_PDU = 4095;
+};
+
+//==============================================================================
+
+//==============================================================================
+// Counters of EDCMD_GET_STATS since the driver start, the last ones since
+// the file was opened. The same values are readable as text from the
+// stats file of the channel, /dev/canN/stats.
+
+struct CanStats
+{
+    std::uint64_t rxFrames_;
+    std::uint64_t rxBytes_;
+    std::uint64_t txFrames_;
+    std::uint64_t txBytes_;
+
+    // Data overruns of the SJA1000 receive FIFO
+    std::uint64_t hardwareOverruns_;
+
+    // Frames and error events the driver receive rings had no room for
+    std::uint64_t ringDrops_;
+
+    // Frames the full message queue dropped for newer ones, counted once for all
+    // files; the frames a file lost this way are its overwritten_
+    std::uint64_t queueOverwrites_;
+
+    // Bus errors by the error code capture
+    std::uint64_t busErrors_;
+    std::uint64_t bitErrors_;
+    std::uint64_t formErrors_;
+    std::uint64_t stuffErrors_;
+    std::uint64_t otherErrors_;
+
+    std::uint64_t errorWarnings_;
+    std::uint64_t errorPassives_;
+    std::uint64_t busOffs_;
+    std::uint64_t arbitrationLosses_;
+
+    std::uint64_t interrupts_;
+    std::uint64_t pulses_;
+
+    // Maximal number of frames in the transmit queue
+    std::uint64_t txQueueHighWater_;
+
+    // Open file: frames returned, frames passed over by the filter or the
+    // receive jobs, frames lost to the queue overwrite
+    std::uint64_t delivered_;
+    std::uint64_t skipped_;
+    std::uint64_t overwritten_;
+};
+
+//==============================================================================
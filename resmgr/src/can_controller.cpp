@@ -9,6 +9,11 @@ CanController::CanController(std::unique_ptr<ChipMapperBase> chipMapper, ECanBau
  : inited_(false)
  , baudRate_(baudRate)
  , chipMapper_(std::move(chipMapper))
+ , interruptMode_(EIM_PULSE_CHAIN)
+ , receiveDrain_(ERD_MESSAGE_COUNT)
+ , transmitScheduling_(ETS_QUEUE)
+ , transmitQueueDepth_(DEFAULT_TRANSMIT_QUEUE_DEPTH)
+ , registerReads_(0)
 {
 }
 
@@ -23,6 +28,8 @@ void CanController::PutByte(const tPort8* byteAddr, std::uint8_t value)
 
 std::uint8_t CanController::GetByte(const tPort8* byteAddr)
 {
+    registerReads_.fetch_add(1, std::memory_order_relaxed);
+
     return chipMapper_->GetByte(byteAddr);
 }
 
@@ -37,11 +44,27 @@ void CanController::PutWord(const tPort16* byteAddr, std::uint16_t value)
 
 std::uint16_t CanController::GetWord(const tPort16* byteAddr)
 {
+    registerReads_.fetch_add(1, std::memory_order_relaxed);
+
     return chipMapper_->GetWord(byteAddr);
 }
 
 //------------------------------------------------------------------------------------------------
 
+void CanController::SetReceiveHandler(ReceiveHandler receiveHandler)
+{
+    receiveHandler_ = std::move(receiveHandler);
+}
+
+//------------------------------------------------------------------------------------------------
+
+void CanController::SetTransmitSpaceHandler(TransmitSpaceHandler transmitSpaceHandler)
+{
+    transmitSpaceHandler_ = std::move(transmitSpaceHandler);
+}
+
+//------------------------------------------------------------------------------------------------
+
 bool CanController::InitController()
 {
     interruptHandleTh_ = std::thread(&CanController::InterruptHandleTh, this);
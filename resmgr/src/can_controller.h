@@ -4,6 +4,9 @@
 #include <mqueue.h>
 #include <cstdint>
 #include <thread>
+#include <functional>
+#include <vector>
+#include <atomic>
 
 #include "non_copyable.h"
 
@@ -11,7 +14,9 @@
 #include "chip_mapper.h"
 
 #include "unit_cthread.h"
+#include "channel_stats.h"
 #include "../common/include/can.h"
+#include "../common/include/canrm.h"
 
 #include <iostream>
 
@@ -33,6 +38,45 @@ enum ECanBaudRate
  
 //------------------------------------------------------------------------------------------------
 
+enum EInterruptMode
+{
+    EIM_PULSE_CHAIN = 0,    // chip is serviced in the interrupt thread, buffers in the controller thread
+    EIM_SINGLE_HOP  = 1,    // chip and buffers are serviced in the interrupt thread
+};
+
+//------------------------------------------------------------------------------------------------
+
+enum EReceiveDrain
+{
+    ERD_MESSAGE_COUNT = 0,  // the receive FIFO message counter is read once per receive interrupt
+    ERD_STATUS_POLL   = 1,  // the status register is read after every frame
+};
+
+//------------------------------------------------------------------------------------------------
+
+enum ETransmitScheduling
+{
+    ETS_QUEUE   = 0,    // the frame in the transmit buffer is sent before the queued ones
+    ETS_PREEMPT = 1,    // a lower priority frame in the transmit buffer is aborted and queued again
+};
+
+//------------------------------------------------------------------------------------------------
+// Frames which the controller fetches itself whenever the transmit buffer is free.
+// Front and Pop are called with the transmit path locked.
+
+class TransmitSource
+{
+public:
+    virtual ~TransmitSource() = default;
+
+    // The next frame or nullptr, valid until Pop
+    virtual const can_frame* Front() = 0;
+
+    virtual void Pop() = 0;
+};
+
+//------------------------------------------------------------------------------------------------
+
 
 class CanController : NonCopyable
 {
@@ -47,10 +91,62 @@ public:
     
     virtual bool WriteMessage(const can_frame& canFrame) =0;
 
-    virtual bool ReadMessage(can_frame& canFrame) =0;
+    // Returns the number of frames accepted for transmission
+    virtual std::size_t WriteMessages(const can_frame* canFrames, std::size_t count) =0;
+
+    virtual bool ReadMessage(CanTimedFrame& canFrame) =0;
 
     virtual void InterruptServiceRoutine() = 0;
 
+    // Receive frames in the controller interrupt handling thread instead of ReadMessage.
+    // Must be set before InitController
+    typedef std::function<void(const CanTimedFrame& canFrame)> ReceiveHandler;
+
+    void SetReceiveHandler(ReceiveHandler receiveHandler);
+
+    // Must be set before InitController
+    void SetInterruptMode(EInterruptMode interruptMode) { interruptMode_ = interruptMode; }
+
+    // Must be set before InitController
+    void SetReceiveDrain(EReceiveDrain receiveDrain) { receiveDrain_ = receiveDrain; }
+
+    // Must be set before InitController
+    void SetTransmitScheduling(ETransmitScheduling transmitScheduling) { transmitScheduling_ = transmitScheduling; }
+
+    static const std::size_t DEFAULT_TRANSMIT_QUEUE_DEPTH = 256;
+
+    // Maximal number of frames waiting for transmission, WriteMessages accepts
+    // no more. Must be set before InitController
+    void SetTransmitQueueDepth(std::size_t depth) { transmitQueueDepth_ = depth; }
+
+    // Called in the controller thread when the transmit queue has room again
+    // after WriteMessages or TransmitQueueSpace found it full.
+    // Must be set before InitController
+    typedef std::function<void()> TransmitSpaceHandler;
+
+    void SetTransmitSpaceHandler(TransmitSpaceHandler transmitSpaceHandler);
+
+    // Number of frames WriteMessages would accept now,
+    // zero arms the transmit space handler
+    virtual std::size_t TransmitQueueSpace() = 0;
+
+    virtual void ReportTimings() const {}
+
+    // Frames which do not match any of the filters may be rejected by the chip.
+    // The filters use the can_filter semantic including CAN_EFF_FLAG and CAN_RTR_FLAG,
+    // an empty list means that no frame is needed.
+    virtual void SetAcceptanceFilter(const std::vector<can_filter>& /*filters*/) {}
+
+    // The source must stay valid until it is removed
+    virtual void AddTransmitSource(TransmitSource* /*source*/) {}
+    virtual void RemoveTransmitSource(TransmitSource* /*source*/) {}
+
+    // Start a transmission from the sources if the transmit buffer is free
+    virtual void KickTransmit() {}
+
+    // Counters of the channel, the message queue readers add theirs
+    ChannelStats& Stats() { return stats_; }
+
 protected:
 
     std::uint64_t GetNsec() const;
@@ -73,6 +169,23 @@ protected:
     
     std::unique_ptr<ChipMapperBase> chipMapper_;
 
+    ReceiveHandler receiveHandler_;
+
+    EInterruptMode interruptMode_;
+
+    EReceiveDrain receiveDrain_;
+
+    ETransmitScheduling transmitScheduling_;
+
+    std::size_t transmitQueueDepth_;
+
+    TransmitSpaceHandler transmitSpaceHandler_;
+
+    // Chip register reads, each one is an uncached bus access
+    std::atomic<std::uint64_t> registerReads_;
+
+    ChannelStats stats_;
+
 private:
     
     std::thread interruptHandleTh_;
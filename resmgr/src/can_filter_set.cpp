@@ -0,0 +1,301 @@
+#include <algorithm>
+
+#include "can_filter_set.h"
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    const canid_t FLAGS_MASK = CAN_EFF_FLAG | CAN_RTR_FLAG;
+
+    // Prefix masks (high identifier bits only) select one identifier range
+    bool IsPrefixMask(std::uint32_t mask)
+    {
+        const std::uint32_t low = ~mask & CAN_EFF_MASK;
+
+        return 0 == (low & (low + 1));
+    }
+}
+
+//------------------------------------------------------------------------------
+
+CanFilterSet::CanFilterSet(const CanFilterRule* rules, std::uint32_t count)
+ : rules_(rules, rules + count)
+ , errorMask_(0)
+{
+    for(const auto& rule: rules_)
+    {
+        if(CanFilterRule::ET_ERROR == rule.type_)
+        {
+            errorMask_ |= rule.mask_ & CAN_ERR_MASK;
+            continue;
+        }
+
+        CompileSff(rule);
+        CompileEff(rule, false);
+        CompileEff(rule, true);
+    }
+
+    Merge(effRanges_[0]);
+    Merge(effRanges_[1]);
+}
+
+//------------------------------------------------------------------------------
+
+bool CanFilterSet::Match(const CanFilterRule& rule, canid_t canId)
+{
+    switch(rule.type_)
+    {
+    case CanFilterRule::ET_MASK:
+    {
+        const canid_t mask = rule.mask_ & ~CAN_ERR_FLAG;
+        return (canId & mask) == (rule.id_ & mask);
+    }
+
+    case CanFilterRule::ET_INV_MASK:
+    {
+        const canid_t mask = rule.mask_ & ~CAN_ERR_FLAG;
+        return (canId & mask) != (rule.id_ & mask);
+    }
+
+    case CanFilterRule::ET_RANGE:
+    {
+        const canid_t flagsMask = rule.mask_ & FLAGS_MASK;
+        const canid_t arbitration = canId & CAN_EFF_MASK;
+
+        return ((canId & flagsMask) == (rule.id_ & flagsMask)) &&
+               (arbitration >= (rule.id_ & CAN_EFF_MASK)) && (arbitration <= (rule.upper_ & CAN_EFF_MASK));
+    }
+
+    default:
+        return false;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CanFilterSet::CompileSff(const CanFilterRule& rule)
+{
+    for(canid_t id = 0; id <= CAN_SFF_MASK; ++id)
+    {
+        if(Match(rule, id))
+        {
+            sff_[0].set(id);
+        }
+
+        if(Match(rule, id | CAN_RTR_FLAG))
+        {
+            sff_[1].set(id);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CanFilterSet::CompileEff(const CanFilterRule& rule, bool rtr)
+{
+    const canid_t flags = CAN_EFF_FLAG | (rtr ? CAN_RTR_FLAG : 0);
+
+    std::vector<Range>& ranges = effRanges_[rtr];
+
+    switch(rule.type_)
+    {
+    case CanFilterRule::ET_MASK:
+    case CanFilterRule::ET_INV_MASK:
+    {
+        const bool inverse = (CanFilterRule::ET_INV_MASK == rule.type_);
+        const canid_t flagsMask = rule.mask_ & FLAGS_MASK;
+        const bool flagsMatch = ((flags & flagsMask) == (rule.id_ & flagsMask));
+
+        const std::uint32_t mask = rule.mask_ & CAN_EFF_MASK;
+        const std::uint32_t lower = rule.id_ & mask;
+        const std::uint32_t upper = lower | (~mask & CAN_EFF_MASK);
+
+        if(!flagsMatch)
+        {
+            // the identifier does not matter any more
+            if(inverse)
+            {
+                ranges.push_back(Range{ 0, CAN_EFF_MASK });
+            }
+        }
+        else if(!IsPrefixMask(mask))
+        {
+            effRules_[rtr].push_back(rule);
+        }
+        else if(!inverse)
+        {
+            ranges.push_back(Range{ lower, upper });
+        }
+        else
+        {
+            if(lower > 0)
+            {
+                ranges.push_back(Range{ 0, lower - 1 });
+            }
+
+            if(upper < CAN_EFF_MASK)
+            {
+                ranges.push_back(Range{ upper + 1, CAN_EFF_MASK });
+            }
+        }
+        break;
+    }
+
+    case CanFilterRule::ET_RANGE:
+    {
+        const canid_t flagsMask = rule.mask_ & FLAGS_MASK;
+        const std::uint32_t lower = rule.id_ & CAN_EFF_MASK;
+        const std::uint32_t upper = rule.upper_ & CAN_EFF_MASK;
+
+        if(((flags & flagsMask) == (rule.id_ & flagsMask)) && (lower <= upper))
+        {
+            ranges.push_back(Range{ lower, upper });
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CanFilterSet::Merge(std::vector<Range>& ranges)
+{
+    if(ranges.empty())
+    {
+        return;
+    }
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range& lhs, const Range& rhs) { return lhs.lower_ < rhs.lower_; });
+
+    std::size_t last = 0;
+
+    for(std::size_t i = 1; i < ranges.size(); ++i)
+    {
+        if(ranges[i].lower_ <= ranges[last].upper_ + 1)
+        {
+            ranges[last].upper_ = std::max(ranges[last].upper_, ranges[i].upper_);
+        }
+        else
+        {
+            ranges[++last] = ranges[i];
+        }
+    }
+
+    ranges.resize(last + 1);
+}
+
+//------------------------------------------------------------------------------
+
+bool CanFilterSet::Find(const std::vector<Range>& ranges, std::uint32_t id)
+{
+    // first range which starts after the identifier
+    auto range = std::upper_bound(ranges.begin(), ranges.end(), id,
+                                  [](std::uint32_t value, const Range& element) { return value < element.lower_; });
+
+    if(range == ranges.begin())
+    {
+        return false;
+    }
+
+    --range;
+
+    return id <= range->upper_;
+}
+
+//------------------------------------------------------------------------------
+
+bool CanFilterSet::Accept(const can_frame& canFrame) const
+{
+    const canid_t canId = canFrame.can_id;
+
+    if(canId & CAN_ERR_FLAG)
+    {
+        return 0 != (canId & errorMask_ & CAN_ERR_MASK);
+    }
+
+    const bool rtr = (0 != (canId & CAN_RTR_FLAG));
+
+    if(0 == (canId & CAN_EFF_FLAG))
+    {
+        return sff_[rtr].test(canId & CAN_SFF_MASK);
+    }
+
+    if(Find(effRanges_[rtr], canId & CAN_EFF_MASK))
+    {
+        return true;
+    }
+
+    for(const auto& rule: effRules_[rtr])
+    {
+        if(Match(rule, canId))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+
+void CanFilterSet::GetCover(std::vector<can_filter>& cover) const
+{
+    for(const auto& rule: rules_)
+    {
+        switch(rule.type_)
+        {
+        case CanFilterRule::ET_MASK:
+            // error frames are not subject to acceptance filtering
+            if(0 == (rule.id_ & rule.mask_ & CAN_ERR_FLAG))
+            {
+                cover.push_back(can_filter{ rule.id_, rule.mask_ & (CAN_EFF_MASK | FLAGS_MASK) });
+            }
+            break;
+
+        case CanFilterRule::ET_INV_MASK:
+            if(0 != (rule.mask_ & (CAN_EFF_MASK | FLAGS_MASK)))
+            {
+                cover.push_back(can_filter{ 0, 0 });
+            }
+            break;
+
+        case CanFilterRule::ET_RANGE:
+            if((rule.id_ & CAN_EFF_MASK) <= (rule.upper_ & CAN_EFF_MASK))
+            {
+                const canid_t flagsMask = rule.mask_ & FLAGS_MASK;
+
+                can_filter filter = RangeCover(rule.id_ & CAN_EFF_MASK, rule.upper_ & CAN_EFF_MASK);
+
+                filter.can_id |= rule.id_ & flagsMask;
+                filter.can_mask |= flagsMask;
+
+                cover.push_back(filter);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+can_filter CanFilterSet::RangeCover(std::uint32_t lower, std::uint32_t upper)
+{
+    // all identifier bits below the highest differing one are free
+    std::uint32_t low = 0;
+
+    for(std::uint32_t diff = lower ^ upper; 0 != diff; diff >>= 1)
+    {
+        low = (low << 1) | 1;
+    }
+
+    return can_filter{ lower & ~low, CAN_EFF_MASK & ~low };
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+#include <canrm.h>
+#include <can.h>
+
+#include "non_copyable.h"
+
+//------------------------------------------------------------------------------
+// Compiled list of CanFilterRule.
+//
+// Standard frames are looked up in a 2048 bit map per RTR state, extended
+// frames in sorted disjoint identifier ranges. Extended mask rules which can
+// not be expressed as ranges are kept and evaluated one by one.
+//------------------------------------------------------------------------------
+
+class CanFilterSet : NonCopyable
+{
+public:
+
+    CanFilterSet(const CanFilterRule* rules, std::uint32_t count);
+
+    bool Accept(const can_frame& canFrame) const;
+
+    bool AcceptsErrors() const { return 0 != errorMask_; }
+
+    const std::vector<CanFilterRule>& GetRules() const { return rules_; }
+
+    static bool Match(const CanFilterRule& rule, canid_t canId);
+
+    // Mask filters which pass at least every accepted data or remote frame
+    void GetCover(std::vector<can_filter>& cover) const;
+
+    // Identifier prefix mask filter covering the range
+    static can_filter RangeCover(std::uint32_t lower, std::uint32_t upper);
+
+private:
+
+    struct Range
+    {
+        std::uint32_t lower_;
+        std::uint32_t upper_;
+    };
+
+    void CompileSff(const CanFilterRule& rule);
+    void CompileEff(const CanFilterRule& rule, bool rtr);
+
+    static void Merge(std::vector<Range>& ranges);
+
+    static bool Find(const std::vector<Range>& ranges, std::uint32_t id);
+
+    std::vector<CanFilterRule> rules_;
+
+    // index 0 for data frames, 1 for remote frames
+    std::bitset<CAN_SFF_MASK + 1> sff_[2];
+    std::vector<Range> effRanges_[2];
+    std::vector<CanFilterRule> effRules_[2];
+
+    can_err_mask_t errorMask_;
+};
+
+//------------------------------------------------------------------------------
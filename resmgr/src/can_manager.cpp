@@ -1,5 +1,12 @@
 #include <devctl.h>
+#include <algorithm>
 #include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/syspage.h>
+#include <time.h>
 #include "log.h"
 #include "can_manager.h"
 
@@ -7,33 +14,34 @@
 
 //----------------------------------------------------------------------
 
-uint32_t CanManager::queueSize_;
-uint32_t CanManager::queueBottom_;
-uint32_t CanManager::queueHead_;
-
-std::mutex CanManager::queueMutex_;
-
-can_frame* CanManager::canMessageQueue_ = 0;
-
-std::shared_ptr<CanController> CanManager::canController_;
-
-std::vector<CanManager::DelayElement> CanManager::delayedQueue_;
-
-iofunc_notify_t CanManager::notify_[3];
-
-//----------------------------------------------------------------------
-
-CanManager::CanManager(std::shared_ptr<CanController> canController, uint32_t nQueueSize)
- : terminate_(false)
+CanManager::CanManager(std::shared_ptr<CanController> canController, std::shared_ptr<CyclicScheduler> cyclicScheduler,
+                       uint32_t nQueueSize, EReceiveMode receiveMode, bool hardwareFilter, const std::string& shmName)
+ : canController_(canController)
+ , canMessageQueue_(0)
+ , timestampQueue_(0)
+ , queueSize_(0)
+ , queueBottom_(0)
+ , queueHead_(0)
+ , cyclicScheduler_(cyclicScheduler)
+ , transmitDoorbell_(-1)
+ , transmitSpaceCoid_(-1)
+ , transmitSpacePulse_(-1)
+ , shmSize_(0)
+ , shmHeader_(0)
+ , shmSequence_(0)
+ , terminate_(false)
  , filling_(true)
+ , receiveMode_(receiveMode)
+ , publishTiming_("publish")
+ , receiveTimeoutPulse_(-1)
+ , receiveTimerValid_(false)
+ , receiveTimerDeadline_(0)
+ , hardwareFilter_(hardwareFilter)
+ , receivedFrames_(0)
+ , unwantedFrames_(0)
 {
     IOFUNC_NOTIFY_INIT(notify_);
 
-    canController_ = canController;
-
-    queueBottom_ = 0;
-    queueHead_ = 0;
-
     if(nQueueSize > 24) 
     {
         throw std::runtime_error("Error buffer size");
@@ -43,16 +51,56 @@ CanManager::CanManager(std::shared_ptr<CanController> canController, uint32_t nQ
 
     LOG(info) << "Message queue Size: " << queueSize_ + 1;
 
-    canMessageQueue_ = new can_frame[queueSize_ + 1];
+    if(shmName.empty())
+    {
+        canMessageQueue_ = new can_frame[queueSize_ + 1];
+        timestampQueue_ = new uint64_t[queueSize_ + 1];
+    }
+    else
+    {
+        CreateSharedQueue(shmName);
+    }
+
+    writeBuffer_.resize(MAX_WRITE_FRAMES);
+
+    if(ERM_DIRECT == receiveMode_)
+    {
+        LOG(info) << "Frames are published by the controller thread";
+
+        canController_->SetReceiveHandler([this](const CanTimedFrame& timedFrame) { PublishMessage(timedFrame); });
+    }
 
+    // writers blocked by a full transmit queue are served in the dispatch thread
+    canController_->SetTransmitSpaceHandler([this]()
+    {
+        if(-1 != transmitSpaceCoid_)
+        {
+            MsgSendPulse(transmitSpaceCoid_, SIGEV_PULSE_PRIO_INHERIT, transmitSpacePulse_, 0);
+        }
+    });
     
+    // the receive path feeds it as soon as the controller runs, its thread starts with the first endpoint
+    isoTpEngine_.reset(new IsoTpEngine([this](const can_frame& canFrame)
+    {
+        return 1 == canController_->WriteMessages(&canFrame, 1);
+    }));
+
     if(canController_->InitController() == false) 
     {
         throw std::runtime_error("Controller initialization Error");
     }
 
-    // Starting Data Receive Thread
-    dataReceiveThread_ = std::thread(&CanManager::DataReceiveThread, this);
+    if(ERM_RECEIVE_THREAD == receiveMode_)
+    {
+        // Starting Data Receive Thread
+        dataReceiveThread_ = std::thread(&CanManager::DataReceiveThread, this);
+    }
+
+    // registered last, the destructor which removes it again runs for a constructed manager only
+    cyclicScheduler_->AddChannel(this, [this](const can_frame& canFrame)
+    {
+        return 1 == canController_->WriteMessages(&canFrame, 1);
+    });
 }
 
 //----------------------------------------------------------------------
@@ -61,27 +109,252 @@ CanManager::~CanManager()
 {
     terminate_ = true;
 
-    canController_.reset();
+    // stops releasing cyclic frames to the controller, the scheduler thread keeps serving the other channels
+    cyclicScheduler_->RemoveChannel(this);
 
-    LOG(info) << "Data receive thread stopped";
+    // unblocks ReadMessage in the data receive thread
+    canController_->CloseController();
 
     if(dataReceiveThread_.joinable())
     {
     	dataReceiveThread_.join();
     }
 
-    if (0 != canMessageQueue_)
+    LOG(info) << "Data receive thread stopped";
+
+    isoTpEngine_.reset();
+
+    canController_->ReportTimings();
+    publishTiming_.Report();
+
+    if(hardwareFilter_)
+    {
+        LOG(info) << "Hardware filter passed frames: " << receivedFrames_
+                  << " not requested by any client: " << unwantedFrames_;
+    }
+
+    canController_.reset();
+
+    if(receiveTimerValid_)
+    {
+        timer_delete(receiveTimer_);
+    }
+
+    if(-1 != transmitSpaceCoid_)
+    {
+        ConnectDetach(transmitSpaceCoid_);
+    }
+
+    if (0 != shmHeader_)
+    {
+        munmap(shmHeader_, shmSize_);
+        shm_unlink(shmName_.c_str());
+
+        shmHeader_ = 0;
+        shmSequence_ = 0;
+    }
+    else if (0 != canMessageQueue_)
     {
         delete[] canMessageQueue_;
+        delete[] timestampQueue_;
+    }
+}
+
+//----------------------------------------------------------------------
+
+bool CanManager::Attach(dispatch_t* dpp, const std::string& path, unsigned resourceFlag)
+{
+    /* initialize functions for handling messages */
+    iofunc_func_init( _RESMGR_CONNECT_NFUNCS, &connectFuncs_,
+                      _RESMGR_IO_NFUNCS, &ioFuncs_ );
+
+    /* initialize attribute structure */
+    iofunc_attr_init( &attr_.defaultAttr_, S_IFNAM | 0666, 0, 0 );
+    attr_.defaultAttr_.inode = 1;
+    attr_.defaultAttr_.nbytes = 0;
+    attr_.manager_ = this;
+
+    ioFuncs_.read = io_read;
+    ioFuncs_.write = io_write;
+    connectFuncs_.open = io_open;
+    ioFuncs_.notify = io_notify;
+    ioFuncs_.devctl = io_devctl;
+    ioFuncs_.close_dup = io_close_dup;
+    ioFuncs_.close_ocb = io_close_ocb;
+    ioFuncs_.unblock = io_unblock;
+    ioFuncs_.lseek = io_lseek;
+
+    mount_ = {};
+    mountFuncs_ = {};
+
+    mountFuncs_.nfuncs = _IOFUNC_NFUNCS;
+    mountFuncs_.ocb_calloc = ocb_calloc;
+    mountFuncs_.ocb_free = ocb_free;
+
+    attr_.defaultAttr_.mount = &mount_;
+    attr_.defaultAttr_.mount->funcs = &mountFuncs_;
+
+    resmgr_attr_t resmgr_attr = {};
+
+    /* initialize resource manager attributes */
+    resmgr_attr.nparts_max = 1;
+    resmgr_attr.msg_max_size = 2048;
+
+    if(resmgr_attach(dpp, &resmgr_attr, path.c_str(), _FTYPE_ANY, resourceFlag,
+                     &connectFuncs_, &ioFuncs_, &attr_) == -1)
+    {
+        LOG(error) << "Unable to attach name: " << path;
+        return false;
+    }
+
+    AttachStats(dpp, path + "/stats", resourceFlag);
+
+    // doorbell of the shared memory transmit rings
+    transmitDoorbell_ = pulse_attach(dpp, MSG_FLAG_ALLOC_PULSE, 0, TransmitDoorbell, this);
+
+    if(-1 == transmitDoorbell_)
+    {
+        LOG(error) << "Unable to attach the transmit doorbell pulse of " << path;
+    }
+
+    // without the transmit space pulse writers get EAGAIN instead of blocking
+    transmitSpacePulse_ = pulse_attach(dpp, MSG_FLAG_ALLOC_PULSE, 0, TransmitSpace, this);
+
+    if(-1 != transmitSpacePulse_)
+    {
+        transmitSpaceCoid_ = message_connect(dpp, MSG_FLAG_SIDE_CHANNEL);
     }
+
+    if(-1 == transmitSpaceCoid_)
+    {
+        LOG(error) << "Unable to attach the transmit space pulse of " << path;
+    }
+
+    // the receive timeout pulse shares the side channel connection
+    receiveTimeoutPulse_ = pulse_attach(dpp, MSG_FLAG_ALLOC_PULSE, 0, ReceiveTimeout, this);
+
+    if((-1 != receiveTimeoutPulse_) && (-1 != transmitSpaceCoid_))
+    {
+        struct sigevent event;
+
+        SIGEV_PULSE_INIT(&event, transmitSpaceCoid_, SIGEV_PULSE_PRIO_INHERIT, receiveTimeoutPulse_, 0);
+
+        receiveTimerValid_ = (-1 != timer_create(CLOCK_MONOTONIC, &event, &receiveTimer_));
+    }
+
+    if(!receiveTimerValid_)
+    {
+        LOG(error) << "Unable to create the receive timeout timer of " << path;
+    }
+
+    LOG(info) << "Resource manager is registered as: " << path;
+
+    return true;
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::AttachStats(dispatch_t* dpp, const std::string& path, unsigned resourceFlag)
+{
+    iofunc_func_init( _RESMGR_CONNECT_NFUNCS, &statsConnectFuncs_,
+                      _RESMGR_IO_NFUNCS, &statsIoFuncs_ );
+
+    iofunc_attr_init( &statsAttr_.defaultAttr_, S_IFREG | 0444, 0, 0 );
+    statsAttr_.defaultAttr_.inode = 2;
+    statsAttr_.defaultAttr_.nbytes = 0;
+    statsAttr_.manager_ = this;
+
+    statsIoFuncs_.read = io_read_stats;
+
+    // the stats files are no clients of the message queue
+    statsMount_ = {};
+    statsMountFuncs_ = {};
+
+    statsMountFuncs_.nfuncs = _IOFUNC_NFUNCS;
+    statsMountFuncs_.ocb_calloc = stats_ocb_calloc;
+    statsMountFuncs_.ocb_free = stats_ocb_free;
+
+    statsAttr_.defaultAttr_.mount = &statsMount_;
+    statsAttr_.defaultAttr_.mount->funcs = &statsMountFuncs_;
+
+    resmgr_attr_t resmgr_attr = {};
+
+    resmgr_attr.nparts_max = 1;
+    resmgr_attr.msg_max_size = 2048;
+
+    if(resmgr_attach(dpp, &resmgr_attr, path.c_str(), _FTYPE_ANY, resourceFlag,
+                     &statsConnectFuncs_, &statsIoFuncs_, &statsAttr_) == -1)
+    {
+        LOG(error) << "Unable to attach name: " << path;
+    }
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::CreateSharedQueue(const std::string& shmName)
+{
+    const uint32_t CACHE_LINE = 64;
+
+    const uint32_t slotCount = queueSize_ + 1;
+    const uint32_t sequenceOffset = (sizeof(CanShmHeader) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+    const uint32_t frameOffset = (sequenceOffset + slotCount * sizeof(uint32_t) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+    const uint32_t timestampOffset = frameOffset + slotCount * sizeof(can_frame);
+
+    shmName_ = shmName;
+    shmSize_ = timestampOffset + slotCount * sizeof(uint64_t);
+
+    if(shmName_.size() >= sizeof(CanShmInfo::name_))
+    {
+        throw std::runtime_error("Shared memory name is too long");
+    }
+
+    // clients get read access only
+    const int fd = shm_open(shmName_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0444);
+
+    if(-1 == fd)
+    {
+        throw std::runtime_error("Shared memory open error");
+    }
+
+    void* memory = MAP_FAILED;
+
+    if(-1 != ftruncate(fd, shmSize_))
+    {
+        memory = mmap(0, shmSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);
+
+    if(MAP_FAILED == memory)
+    {
+        shm_unlink(shmName_.c_str());
+
+        throw std::runtime_error("Shared memory map error");
+    }
+
+    memset(memory, 0, shmSize_);
+
+    uint8_t* base = static_cast<uint8_t*>(memory);
+
+    shmHeader_ = static_cast<CanShmHeader*>(memory);
+    shmSequence_ = reinterpret_cast<std::atomic<uint32_t>*>(base + sequenceOffset);
+    canMessageQueue_ = reinterpret_cast<can_frame*>(base + frameOffset);
+    timestampQueue_ = reinterpret_cast<uint64_t*>(base + timestampOffset);
+
+    shmHeader_->slotCount_ = slotCount;
+    shmHeader_->sequenceOffset_ = sequenceOffset;
+    shmHeader_->frameOffset_ = frameOffset;
+    shmHeader_->timestampOffset_ = timestampOffset;
+    shmHeader_->head_.store(0, std::memory_order_relaxed);
+    shmHeader_->magic_ = CanShmHeader::MAGIC;
+
+    LOG(info) << "Message queue is shared as " << shmName_;
 }
 
 //----------------------------------------------------------------------
 
 void* CanManager::DataReceiveThread()
 {
-    bool erase = false;
-    
     pthread_setschedprio(pthread_self(), 30);
 
     while(1)
@@ -91,89 +364,157 @@ void* CanManager::DataReceiveThread()
             return 0;
         }
 
-        if(canController_->ReadMessage(canMessageQueue_[queueHead_ & queueSize_]))
+        CanTimedFrame timedFrame;
+
+        if(canController_->ReadMessage(timedFrame))
         {
-            std::lock_guard<std::mutex> lock(queueMutex_);
+            PublishMessage(timedFrame);
+        }
+    }
+
+    return 0;
+}
 
-            DelayedQueueIterator tdqi = delayedQueue_.begin();
+//----------------------------------------------------------------------
 
-            while(tdqi != delayedQueue_.end()) 
-            {
+void CanManager::PublishMessage(const CanTimedFrame& timedFrame)
+{
+    const uint64_t startCycles = ClockCycles();
 
-                erase = false;
+    // flow control is answered before the frame is queued
+    isoTpEngine_->Receive(timedFrame.frame_);
 
-                //check Data pointer equivalence
-                if(queueHead_ == tdqi->ocb_->defaultOCB_.offset) 
-                {
+    std::lock_guard<std::mutex> lock(queueMutex_);
 
-                    //check acceptance filter
-                    const bool bAccept = CheckFilter(canMessageQueue_[queueHead_ & queueSize_], tdqi->ocb_->canMessageFilter_);
+    const uint32_t slot = queueHead_ & queueSize_;
 
-                    if(bAccept == true) 
-                    {
+    can_frame& queueFrame = canMessageQueue_[slot];
 
-                        switch (tdqi->type_) 
-                        {
-                            case DelayElement::ET_REPLY:
-                                //send delayed data
-                                MsgReply(tdqi->rcvId_, sizeof(can_frame), &canMessageQueue_[queueHead_ & queueSize_], sizeof(can_frame));
-                                erase = true;
+    if(0 != shmSequence_)
+    {
+        // odd sequence while the slot is written
+        shmSequence_[queueHead_ & queueSize_].store(2 * queueHead_ + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
 
-                                break;
-                            case DelayElement::ET_NOTIFY:
+    queueFrame = timedFrame.frame_;
+    timestampQueue_[queueHead_ & queueSize_] = timedFrame.timestamp_;
 
-                                if(SIGEV_NONE != tdqi->ocb_->notifyEvent_.ev32.sigev_notify) 
-                                {
+    if(0 != shmSequence_)
+    {
+        shmSequence_[queueHead_ & queueSize_].store(2 * queueHead_ + 2, std::memory_order_release);
+    }
 
-                                    tdqi->ocb_->notifyEvent_.ev32.sigev_value.sival_int |= _NOTIFY_COND_INPUT;
+    // judged once here, read and notify only look at the verdict of the slot
+    if(!receiveJobOcbs_.empty())
+    {
+        uint64_t nextDeadline = NO_DEADLINE;
 
-                                    MsgDeliverEvent(tdqi->rcvId_, &tdqi->ocb_->notifyEvent_.ev);
-                                    tdqi->ocb_->notifyEvent_.ev32.sigev_notify = SIGEV_NONE;
+        for(const auto ocb: receiveJobOcbs_)
+        {
+            ocb->receiveJobs_->Publish(slot, timedFrame, nextDeadline);
+        }
 
-                                }
-                                erase = true;
-                                break;
-                            default:
-                                break;
-                        }
-                    }
+        ArmReceiveTimer(nextDeadline);
+    }
 
-                    if((DelayElement::ET_REPLY == tdqi->type_) || (false == erase)) 
-                    {
-                        //advance the offset by the number of messages returned to the client.
-                        ++(tdqi->ocb_->defaultOCB_.offset);
-                    }
-                }
+    // error frames are made by the controller, not by the acceptance filter
+    if(hardwareFilter_ && (0 == (queueFrame.can_id & CAN_ERR_FLAG)))
+    {
+        ++receivedFrames_;
 
-                //delete or advise delayed pointer
-                if(erase) 
+        if(std::none_of(acceptanceFilter_.begin(), acceptanceFilter_.end(), [&](const can_filter& filter)
+            { return ((queueFrame.can_id ^ filter.can_id) & filter.can_mask) == 0; }))
+        {
+            ++unwantedFrames_;
+        }
+    }
+
+    // visit only the delayed requests which may accept the frame
+    delayedQueue_.ForEachCandidate(queueFrame.can_id & CAN_EFF_MASK, [&](const DelayElement& element)
+    {
+        //check acceptance filter
+        if(!Accepted(slot, element.ocb_)) 
+        {
+            return false;
+        }
+
+        switch (element.type_) 
+        {
+            case DelayElement::ET_REPLY:
+                //send delayed data
+                if(ECFF_TIMED_FRAME == element.ocb_->frameFormat_)
                 {
-                    tdqi = delayedQueue_.erase(tdqi);
-                } 
-                else 
+                    MsgReply(element.rcvId_, sizeof(CanTimedFrame), &timedFrame, sizeof(CanTimedFrame));
+                }
+                else
                 {
-                    ++tdqi;
+                    MsgReply(element.rcvId_, sizeof(can_frame), &queueFrame, sizeof(can_frame));
                 }
-            }
 
-            if(queueSize_ < ++queueHead_) 
-            {
-                filling_ = false;
-            }
+                // the frames published while the reader waited were not accepted
+                ClampReaderOffset(element.ocb_);
+                ChannelStats::Add(element.ocb_->skipped_, queueHead_ - element.ocb_->defaultOCB_.offset);
+                ChannelStats::Add(element.ocb_->delivered_);
 
-            if(!filling_)
-            {
-                ++queueBottom_;
-            }
+                //advance the offset by the number of messages returned to the client.
+                element.ocb_->defaultOCB_.offset = queueHead_ + 1;
+
+                return true;
+
+            case DelayElement::ET_NOTIFY:
+
+                if(SIGEV_NONE != element.ocb_->notifyEvent_.ev32.sigev_notify) 
+                {
+
+                    element.ocb_->notifyEvent_.ev32.sigev_value.sival_int |= _NOTIFY_COND_INPUT;
+
+                    MsgDeliverEvent(element.rcvId_, &element.ocb_->notifyEvent_.ev);
+                    element.ocb_->notifyEvent_.ev32.sigev_notify = SIGEV_NONE;
+
+                }
+
+                //the frame is not consumed, next read starts from it
+                element.ocb_->defaultOCB_.offset = queueHead_;
+
+                return true;
+
+            default:
+                return false;
         }
+    });
+
+    if(queueSize_ < ++queueHead_) 
+    {
+        filling_ = false;
     }
 
-    return 0;
+    // the oldest frame leaves the full queue, once per channel whatever the readers
+    if(!filling_)
+    {
+        ++queueBottom_;
+
+        ChannelStats::Add(canController_->Stats().queueOverwrites_);
+    }
+
+    if(0 != shmHeader_)
+    {
+        shmHeader_->head_.store(queueHead_, std::memory_order_release);
+    }
+
+    publishTiming_.Add(ClockCycles() - startCycles);
 }
 
 //----------------------------------------------------------------------
 
 int CanManager::io_read (resmgr_context_t *ctp, io_read_t *msg, RESMGR_OCB_T *ocb)
+{
+    return ocb->manager_->Read(ctp, msg, ocb);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::Read(resmgr_context_t *ctp, io_read_t *msg, RESMGR_OCB_T *ocb)
 {
     int         status;
     int         nBlock = 0;
@@ -184,45 +525,96 @@ int CanManager::io_read (resmgr_context_t *ctp, io_read_t *msg, RESMGR_OCB_T *oc
     if ((msg->i.xtype & _IO_XTYPE_MASK) != _IO_XTYPE_NONE)
         return (ENOSYS);
 
+    if(ocb->isoTp_)
+        return ReadPdu(ctp, msg, ocb, 0 != nBlock);
+
     /*
      *  On all reads (first and subsequent), calculate
-     *  how many bytes we can return to the client,
-     *  based upon the number of bytes available (nleft)
+     *  how many frames we can return to the client,
+     *  based upon the number of frames available
      *  and the client's buffer size
      */
 
-    if(sizeof(can_frame) != msg->i.nbytes)
+    const bool timed = (ECFF_TIMED_FRAME == ocb->frameFormat_);
+    const uint32_t elementSize = timed ? sizeof(CanTimedFrame) : sizeof(can_frame);
+
+    if((0 == msg->i.nbytes) || (0 != (msg->i.nbytes % elementSize)))
         return (EINVAL);
 
+    const uint32_t maxFrames = timed ? std::min<uint32_t>(msg->i.nbytes / elementSize, MAX_TIMED_FRAMES) :
+                                       msg->i.nbytes / elementSize;
+
     std::unique_lock<std::mutex> lock(queueMutex_);
     //check data pointer maybe we miss some messages
 
-    if((ocb->defaultOCB_.offset > queueHead_) || (ocb->defaultOCB_.offset < queueBottom_))
-    {
-        ocb->defaultOCB_.offset = queueBottom_;
-    }
+    ClampReaderOffset(ocb);
 
-    //try to find new message
-    while(ocb->defaultOCB_.offset != queueHead_)
+    //collect accepted messages, adjacent queue elements share one reply part,
+    //timed frames are assembled from the frame and the timestamp queue
+    iov_t replyParts[MAX_REPLY_PARTS];
+    CanTimedFrame timedFrames[MAX_TIMED_FRAMES];
+    uint32_t nParts = 0;
+    uint32_t nFrames = 0;
+    uint32_t nSkipped = 0;
+    uint32_t lastIndex = 0;
+
+    while((ocb->defaultOCB_.offset != queueHead_) && (nFrames < maxFrames))
     {
-        if(CheckFilter(canMessageQueue_[ocb->defaultOCB_.offset & queueSize_], ocb->canMessageFilter_)) 
-        {
+        const uint32_t index = ocb->defaultOCB_.offset & queueSize_;
 
-            MsgReply(ctp->rcvid, sizeof(can_frame), &canMessageQueue_[ocb->defaultOCB_.offset & queueSize_], sizeof(can_frame));
+        if(Accepted(index, ocb)) 
+        {
+            if(timed)
+            {
+                timedFrames[nFrames].frame_ = canMessageQueue_[index];
+                timedFrames[nFrames].timestamp_ = timestampQueue_[index];
+            }
+            else if((0 != nParts) && (lastIndex + 1 == index))
+            {
+                replyParts[nParts - 1].iov_len += sizeof(can_frame);
+            }
+            else
+            {
+                if(MAX_REPLY_PARTS == nParts)
+                {
+                    break;
+                }
 
-            //advance the offset by the number of messages returned to the client.
-            ++ocb->defaultOCB_.offset;
+                SETIOV(&replyParts[nParts], &canMessageQueue_[index], sizeof(can_frame));
+                ++nParts;
+            }
 
-            lock.unlock();
+            lastIndex = index;
+            ++nFrames;
+        }
+        else
+        {
+            ++nSkipped;
+        }
+        //advance the offset by the number of messages returned to the client.
+        ++ocb->defaultOCB_.offset;
+    }
 
-            /* mark the access time as invalid (we just accessed it) */
-            if (msg->i.nbytes > 0)
-                ocb->defaultOCB_.attr->flags |= IOFUNC_ATTR_ATIME | IOFUNC_ATTR_DIRTY_TIME;
+    ChannelStats::Add(ocb->delivered_, nFrames);
+    ChannelStats::Add(ocb->skipped_, nSkipped);
 
-            return (_RESMGR_NOREPLY);
+    if(0 != nFrames)
+    {
+        if(timed)
+        {
+            MsgReply(ctp->rcvid, nFrames * sizeof(CanTimedFrame), timedFrames, nFrames * sizeof(CanTimedFrame));
         }
-        //advance the offset
-        ++ocb->defaultOCB_.offset;
+        else
+        {
+            MsgReplyv(ctp->rcvid, nFrames * sizeof(can_frame), replyParts, nParts);
+        }
+
+        lock.unlock();
+
+        /* mark the access time as invalid (we just accessed it) */
+        ocb->defaultOCB_.attr->defaultAttr_.flags |= IOFUNC_ATTR_ATIME | IOFUNC_ATTR_DIRTY_TIME;
+
+        return (_RESMGR_NOREPLY);
     }
 
     //haven't new message, check O_NONBLOCK
@@ -234,7 +626,7 @@ int CanManager::io_read (resmgr_context_t *ctp, io_read_t *msg, RESMGR_OCB_T *oc
     else 
     {
         //push to queue for wait new data
-        delayedQueue_.push_back(DelayElement(DelayElement::ET_REPLY, ctp->rcvid, ocb));
+        delayedQueue_.Push(DelayElement(DelayElement::ET_REPLY, ctp->rcvid, ocb), DelayFilter(ocb));
     }
 
     return (_RESMGR_NOREPLY);
@@ -243,6 +635,13 @@ int CanManager::io_read (resmgr_context_t *ctp, io_read_t *msg, RESMGR_OCB_T *oc
 //----------------------------------------------------------------------
 
 int CanManager::io_open (resmgr_context_t *ctp, io_open_t *msg, RESMGR_HANDLE_T *handle, void *extra)
+{
+    return handle->manager_->Open(ctp, msg, handle, extra);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::Open(resmgr_context_t *ctp, io_open_t *msg, RESMGR_HANDLE_T *handle, void *extra)
 {
     //call default open function
     int nRetval = iofunc_open_default(ctp, msg, handle, extra);
@@ -264,6 +663,13 @@ int CanManager::io_open (resmgr_context_t *ctp, io_open_t *msg, RESMGR_HANDLE_T
         }
     }
 
+    // a reader is unfiltered until the client sets its filter, the open mode
+    // is known only after iofunc_open_default attached the OCB
+    if((EOK == nRetval) && (0 != ocb))
+    {
+        UpdateAcceptanceFilter();
+    }
+
     return (_RESMGR_ERRNO(nRetval)); //obsolete
 }
 
@@ -271,8 +677,13 @@ int CanManager::io_open (resmgr_context_t *ctp, io_open_t *msg, RESMGR_HANDLE_T
 
 int CanManager::io_write(resmgr_context_t *ctp, io_write_t *msg, RESMGR_OCB_T *ocb)
 {
-    can_frame canFrame;
+    return ocb->manager_->Write(ctp, msg, ocb);
+}
+
+//----------------------------------------------------------------------
 
+int CanManager::Write(resmgr_context_t *ctp, io_write_t *msg, RESMGR_OCB_T *ocb)
+{
     // verify that the device is opened for write
     if(0 == (ocb->defaultOCB_.ioflag & 0x02)) 
     {
@@ -282,26 +693,54 @@ int CanManager::io_write(resmgr_context_t *ctp, io_write_t *msg, RESMGR_OCB_T *o
     if ((msg->i.xtype & _IO_XTYPE_MASK) != _IO_XTYPE_NONE)
         return (ENOSYS);
 
-    if(sizeof(can_frame) != msg->i.nbytes)
+    if(ocb->isoTp_)
+        return WritePdu(ctp, msg, ocb);
+
+    if((0 == msg->i.nbytes) || (0 != (msg->i.nbytes % sizeof(can_frame))))
         return (EINVAL);
 
-    // read the data from the client
-    if(resmgr_msgread(ctp, &canFrame, sizeof(can_frame), sizeof(msg->i)) == -1)
+    // frames above the limit are not accepted, the client resubmits them
+    const uint32_t nFrames = std::min<uint32_t>(msg->i.nbytes / sizeof(can_frame), MAX_WRITE_FRAMES);
+
+    std::size_t nAccepted = 0;
+
+    // blocked writers keep their order
+    if(transmitWaiters_.empty())
     {
-        return (errno);
+        // read the data from the client
+        if(resmgr_msgread(ctp, writeBuffer_.data(), nFrames * sizeof(can_frame), sizeof(msg->i)) == -1)
+        {
+            return (errno);
+        }
+
+        // Put data to the send buffer
+        nAccepted = canController_->WriteMessages(writeBuffer_.data(), nFrames);
     }
 
-    // Put data to the send buffer
-    canController_->WriteMessage(canFrame);
+    // the transmit queue is full
+    if(0 == nAccepted)
+    {
+        const bool nonBlock = (0 != (ocb->defaultOCB_.ioflag & O_NONBLOCK)) || (0 != (msg->i.xtype & _IO_XFLAG_NONBLOCK));
+
+        if(nonBlock || (-1 == transmitSpaceCoid_))
+        {
+            return (EAGAIN);
+        }
+
+        // replied by ServeTransmitWaiters
+        transmitWaiters_.push_back(DelayElement(DelayElement::ET_WRITE, ctp->rcvid, ocb, msg->i.nbytes));
+
+        return (_RESMGR_NOREPLY);
+    }
 
     // set up the number of bytes for the client's "write"
     // function to return
-    _IO_SET_WRITE_NBYTES (ctp, sizeof(can_frame));
+    _IO_SET_WRITE_NBYTES (ctp, nAccepted * sizeof(can_frame));
 
     /* mark the access time as invalid (we just accessed it) */
 
     if (msg->i.nbytes > 0)
-        ocb->defaultOCB_.attr->flags |= IOFUNC_ATTR_ATIME | IOFUNC_ATTR_DIRTY_TIME;
+        ocb->defaultOCB_.attr->defaultAttr_.flags |= IOFUNC_ATTR_ATIME | IOFUNC_ATTR_DIRTY_TIME;
 
     // tell the resource manager library to do the reply, and that it was okay
     return (EOK);
@@ -310,6 +749,13 @@ int CanManager::io_write(resmgr_context_t *ctp, io_write_t *msg, RESMGR_OCB_T *o
 //----------------------------------------------------------------------
 
 int CanManager::io_notify(resmgr_context_t *ctp, io_notify_t *msg, RESMGR_OCB_T *ocb)
+{
+    return ocb->manager_->Notify(ctp, msg, ocb);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::Notify(resmgr_context_t *ctp, io_notify_t *msg, RESMGR_OCB_T *ocb)
 {
     int trig = 0;
 
@@ -318,20 +764,40 @@ int CanManager::io_notify(resmgr_context_t *ctp, io_notify_t *msg, RESMGR_OCB_T
      * satisfied.
     */
 
-    trig = _NOTIFY_COND_OUTPUT;         /* clients can always give us data */
+    if(ocb->isoTp_)
+    {
+        ocb->notifyEvent_.ev32 = msg->i.event;
+
+        trig = isoTpEngine_->Notify(ocb, ctp->rcvid, msg->i.flags, _NOTIFY_ACTION_POLLARM == msg->i.action,
+                                    ocb->notifyEvent_.ev);
 
-    std::lock_guard<std::mutex> lock(queueMutex_);
+        msg->o.flags = trig & msg->i.flags;
 
-    //advance message pointer if out of range
-    if((ocb->defaultOCB_.offset > queueHead_) || (ocb->defaultOCB_.offset < queueBottom_))
-    {
-        ocb->defaultOCB_.offset = queueBottom_;
+        return (EOK);
     }
 
-    //check presence of new message in buffer
-    while(ocb->defaultOCB_.offset != queueHead_)
+    /* clients can give us data while the transmit queue has room */
+    if((_NOTIFY_COND_OUTPUT & msg->i.flags) && transmitWaiters_.empty() &&
+       (0 != canController_->TransmitQueueSpace()))
     {
-        if(CheckFilter(canMessageQueue_[ocb->defaultOCB_.offset & queueSize_], ocb->canMessageFilter_)) 
+        trig = _NOTIFY_COND_OUTPUT;
+    }
+
+    std::lock_guard<std::mutex> lock(queueMutex_);
+
+    /* a receive job misses its frame */
+    if((_NOTIFY_COND_OBAND & msg->i.flags) && (0 != ocb->receiveJobs_) && ocb->receiveJobs_->TimedOut())
+    {
+        trig |= _NOTIFY_COND_OBAND;
+    }
+
+    //advance message pointer if out of range
+    ClampReaderOffset(ocb);
+
+    //check presence of new message in buffer
+    while(ocb->defaultOCB_.offset != queueHead_)
+    {
+        if(Accepted(ocb->defaultOCB_.offset & queueSize_, ocb)) 
         {
             //we have new data in buffer
             trig |= _NOTIFY_COND_INPUT;      /* we have some data available */
@@ -339,21 +805,37 @@ int CanManager::io_notify(resmgr_context_t *ctp, io_notify_t *msg, RESMGR_OCB_T
             break;
         }
         ++ocb->defaultOCB_.offset;
+        ChannelStats::Add(ocb->skipped_);
     }
 
 
     //check notify request and put it to queue
-    if((_NOTIFY_ACTION_POLLARM == msg->i.action) && (_NOTIFY_COND_INPUT & msg->i.flags)) 
+    if((_NOTIFY_ACTION_POLLARM == msg->i.action) &&
+       ((_NOTIFY_COND_INPUT | _NOTIFY_COND_OUTPUT | _NOTIFY_COND_OBAND) & msg->i.flags)) 
     {
         msg->o.flags = trig & msg->i.flags;
 
         if(0 == msg->o.flags) 
         {
+            ocb->notifyEvent_.ev32 = msg->i.event;
 
             //push to queue for wait new data
-            ocb->notifyEvent_.ev32 = msg->i.event;
+            if(_NOTIFY_COND_INPUT & msg->i.flags)
+            {
+                delayedQueue_.Push(DelayElement(DelayElement::ET_NOTIFY, ctp->rcvid, ocb), DelayFilter(ocb));
+            }
 
-            delayedQueue_.push_back(DelayElement(DelayElement::ET_NOTIFY, ctp->rcvid, ocb));
+            //wait for transmit queue space
+            if(_NOTIFY_COND_OUTPUT & msg->i.flags)
+            {
+                transmitWaiters_.push_back(DelayElement(DelayElement::ET_NOTIFY_OUTPUT, ctp->rcvid, ocb));
+            }
+
+            //wait for a receive job timeout
+            if((_NOTIFY_COND_OBAND & msg->i.flags) && (0 != ocb->receiveJobs_))
+            {
+                ocb->receiveJobs_->ArmNotify(ctp->rcvid);
+            }
         }
     }
 
@@ -371,23 +853,32 @@ int CanManager::io_close_dup(resmgr_context_t *ctp, io_close_t *msg, RESMGR_OCB_
 
 int CanManager::io_close_ocb (resmgr_context_t *ctp, void *msg, RESMGR_OCB_T *ocb)
 {
+    return ocb->manager_->CloseOcb(ctp, msg, ocb);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::CloseOcb(resmgr_context_t *ctp, void *msg, RESMGR_OCB_T *ocb)
+{
+    RemoveTransmitWaiters(ocb, 0);
+
+    cyclicScheduler_->DeleteJobs(ocb);
+
+    isoTpEngine_->DeleteEndpoint(ocb);
+
     {
         std::lock_guard<std::mutex> lock(queueMutex_);
 
-        DelayedQueueIterator tdqi = delayedQueue_.begin();
-
-        while(tdqi != delayedQueue_.end()) 
+        delayedQueue_.Remove([ocb](const DelayElement& element)
         {
-            if(ocb == tdqi->ocb_) 
-            {
-                MsgReply(tdqi->rcvId_, EOK, NULL, 0);
-                tdqi = delayedQueue_.erase(tdqi);
-            }
-            else 
+            if(ocb != element.ocb_)
             {
-                ++tdqi;
+                return false;
             }
-        }
+
+            MsgReply(element.rcvId_, EOK, NULL, 0);
+            return true;
+        });
     }
     return iofunc_close_ocb_default(ctp, msg, &(ocb->defaultOCB_));
 }
@@ -395,6 +886,13 @@ int CanManager::io_close_ocb (resmgr_context_t *ctp, void *msg, RESMGR_OCB_T *oc
 //----------------------------------------------------------------------
 
 int CanManager::io_devctl(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb)
+{
+    return ocb->manager_->Devctl(ctp, msg, ocb);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::Devctl(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb)
 {
     int32_t nRetVal = iofunc_devctl_default(ctp, msg, &(ocb->defaultOCB_));
 
@@ -416,9 +914,122 @@ int CanManager::io_devctl(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T
 
         data = (uint32_t*)(_DEVCTL_DATA(msg->i));
 
-        memcpy(&ocb->canMessageFilter_, data, sizeof(CanMessageFilter));
+        {
+            CanMessageFilter filter;
+
+            memcpy(&filter, data, sizeof(CanMessageFilter));
+
+            if((filter.type_ != CanMessageFilter::ET_DISABLED) &&
+               (filter.type_ != CanMessageFilter::ET_AMASK) &&
+               (filter.type_ != CanMessageFilter::ET_RANGE))
+            {
+                return EINVAL;
+            }
+
+            // frame identifiers do not exceed CAN_EFF_MASK
+            if((CanMessageFilter::ET_RANGE == filter.type_) && (filter.upper_ > CAN_EFF_MASK))
+            {
+                filter.upper_ = CAN_EFF_MASK;
+            }
+
+            std::lock_guard<std::mutex> lock(queueMutex_);
+
+            ocb->canMessageFilter_ = filter;
+
+            delete ocb->filterSet_;
+            ocb->filterSet_ = 0;
+
+            ReindexDelayed(ocb);
+        }
+
+        UpdateAcceptanceFilter();
+
+        break;
+
+    case EDCMD_SET_FILTERS :
+
+        return SetFilters(ctp, msg, ocb);
+
+    case EDCMD_GET_RX_SHM :
+
+        return GetSharedQueue(ctp, msg);
+
+    case EDCMD_ATTACH_TX_SHM :
+
+        return AttachTransmitRing(ctp, msg, ocb);
+
+    case EDCMD_SET_CYCLIC_TX :
+
+        return SetCyclicTransmission(ctp, msg, ocb);
+
+    case EDCMD_DEL_CYCLIC_TX :
+
+        if(sizeof(uint32_t) != msg->i.nbytes) 
+        {
+            return EINVAL;
+        }
+
+        data = (uint32_t*)(_DEVCTL_DATA(msg->i));
+
+        return cyclicScheduler_->DeleteJob(ocb, *data);
+
+    case EDCMD_GET_CYCLIC_STATS :
+
+        return GetCyclicStats(ctp, msg, ocb);
+
+    case EDCMD_SET_RX_JOB :
+
+        return SetReceiveJob(ctp, msg, ocb);
+
+    case EDCMD_GET_STATS :
+
+        return GetStats(ctp, msg, ocb);
+
+    case EDCMD_DEL_RX_JOB :
+
+        if(sizeof(uint32_t) != msg->i.nbytes) 
+        {
+            return EINVAL;
+        }
+
+        data = (uint32_t*)(_DEVCTL_DATA(msg->i));
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+
+            return (0 == ocb->receiveJobs_) ? ESRCH : ocb->receiveJobs_->DeleteJob(*data);
+        }
+
+    case EDCMD_GET_RX_JOB_STATUS :
+
+        return GetReceiveJobStatus(ctp, msg, ocb);
+
+    case EDCMD_SET_ISOTP :
+
+        return SetIsoTp(ctp, msg, ocb);
+
+    case EDCMD_SET_FRAME_FORMAT :
+
+        if(sizeof(uint32_t) != msg->i.nbytes) 
+        {
+            return EINVAL;
+        }
+
+        data = (uint32_t*)(_DEVCTL_DATA(msg->i));
+
+        if((ECFF_FRAME != *data) && (ECFF_TIMED_FRAME != *data))
+        {
+            return EINVAL;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+
+            ocb->frameFormat_ = *data;
+        }
 
         break;
+
     default :
         return ENOSYS;
     }
@@ -435,70 +1046,986 @@ int CanManager::io_devctl(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T
 
 //----------------------------------------------------------------------
 
-IOFUNC_OCB_T* CanManager::ocb_calloc (resmgr_context_t */*ctp*/, IOFUNC_ATTR_T */*device*/)
+int CanManager::SetFilters(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb)
 {
-    IOFUNC_OCB_T *ocb;
+    if(sizeof(CanFilterSetHeader) > msg->i.nbytes) 
+    {
+        return EINVAL;
+    }
 
-    ocb = (IOFUNC_OCB_T*)(calloc (1, sizeof(IOFUNC_OCB_T)));
+    CanFilterSetHeader header;
 
-    if (0 == ocb) 
+    if(resmgr_msgread(ctp, &header, sizeof(header), sizeof(msg->i)) == -1)
     {
-        return 0;
+        return errno;
     }
 
-    ocb->notifyEvent_.ev32.sigev_notify = SIGEV_NONE;
+    if((header.count_ > CanFilterSetHeader::MAX_RULES) ||
+       (sizeof(header) + header.count_ * sizeof(CanFilterRule) != msg->i.nbytes))
+    {
+        return EINVAL;
+    }
 
-    return ocb;
+    // the rules may exceed the receive buffer, read them from the client
+    std::vector<CanFilterRule> rules(header.count_);
+
+    if((0 != header.count_) &&
+       (resmgr_msgread(ctp, rules.data(), rules.size() * sizeof(CanFilterRule), sizeof(msg->i) + sizeof(header)) == -1))
+    {
+        return errno;
+    }
+
+    CanFilterSet* filterSet = new CanFilterSet(rules.data(), rules.size());
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+
+        std::swap(ocb->filterSet_, filterSet);
+
+        ReindexDelayed(ocb);
+    }
+
+    delete filterSet;
+
+    UpdateAcceptanceFilter();
+
+    return (EOK);
 }
 
 //----------------------------------------------------------------------
 
-void CanManager::ocb_free (IOFUNC_OCB_T *ocb)
+int CanManager::SetReceiveJob(resmgr_context_t */*ctp*/, io_devctl_t *msg, RESMGR_OCB_T *ocb)
 {
-    free (ocb);
+    if(sizeof(CanRxJob) != msg->i.nbytes) 
+    {
+        return EINVAL;
+    }
+
+    const CanRxJob* job = (const CanRxJob*)(_DEVCTL_DATA(msg->i));
+
+    std::lock_guard<std::mutex> lock(queueMutex_);
+
+    if(0 == ocb->receiveJobs_)
+    {
+        ocb->receiveJobs_ = new ReceiveJobSet(queueSize_ + 1);
+        receiveJobOcbs_.push_back(ocb);
+    }
+
+    uint64_t nextDeadline = NO_DEADLINE;
+
+    const int status = ocb->receiveJobs_->SetJob(*job, ClockCycles(), nextDeadline);
+
+    ArmReceiveTimer(nextDeadline);
+
+    return status;
 }
 
 //----------------------------------------------------------------------
 
-bool CanManager::CheckFilter(const can_frame& canFrame, const CanMessageFilter& filter)
+int CanManager::GetReceiveJobStatus(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb)
 {
-    const uint32_t nArb = canFrame.can_id & CAN_EFF_MASK;
+    if(sizeof(CanRxJobStatus) != msg->i.nbytes) 
+    {
+        return EINVAL;
+    }
 
-    switch (filter.type_) {
-    case CanMessageFilter::ET_AMASK:
-        if(( nArb & filter.acceptanceMask_) ==
-            (filter.acceptancePattern_ & filter.acceptanceMask_)) 
+    const uint32_t canId = ((const CanRxJobStatus*)(_DEVCTL_DATA(msg->i)))->canId_;
+
+    CanRxJobStatus status;
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+
+        if(0 == ocb->receiveJobs_)
         {
+            return ESRCH;
+        }
 
-            return true;
+        const int result = ocb->receiveJobs_->GetStatus(canId, status);
+
+        if(EOK != result)
+        {
+            return result;
         }
-        break;
+    }
 
-    case CanMessageFilter::ET_RANGE:
-        if(( nArb >= filter.lower_) && (nArb <= filter.upper_)) 
+    *(CanRxJobStatus*)(_DEVCTL_DATA(msg->o)) = status;
+
+    memset(&msg->o, 0, sizeof(msg->o));
+    msg->o.nbytes = sizeof(CanRxJobStatus);
+
+    return (_RESMGR_PTR(ctp, &msg->o, sizeof(msg->o) + sizeof(CanRxJobStatus)));
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::ReceiveTimeout(message_context_t */*ctp*/, int /*code*/, unsigned /*flags*/, void *handle)
+{
+    static_cast<CanManager*>(handle)->CheckReceiveTimeouts();
+
+    return 0;
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::CheckReceiveTimeouts()
+{
+    std::lock_guard<std::mutex> lock(queueMutex_);
+
+    const uint64_t now = ClockCycles();
+
+    uint64_t nextDeadline = NO_DEADLINE;
+
+    // the timer has expired, a later one is programmed below
+    receiveTimerDeadline_ = 0;
+
+    for(const auto ocb: receiveJobOcbs_)
+    {
+        int rcvId;
+
+        if(ocb->receiveJobs_->CheckTimeouts(now, nextDeadline) && ocb->receiveJobs_->TakeNotify(rcvId) &&
+           (SIGEV_NONE != ocb->notifyEvent_.ev32.sigev_notify))
         {
+            ocb->notifyEvent_.ev32.sigev_value.sival_int |= _NOTIFY_COND_OBAND;
 
-            return true;
+            MsgDeliverEvent(rcvId, &ocb->notifyEvent_.ev);
+            ocb->notifyEvent_.ev32.sigev_notify = SIGEV_NONE;
         }
+    }
 
-        break;
-    default:
-        return true;
-        break;
+    ArmReceiveTimer(nextDeadline);
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::ArmReceiveTimer(uint64_t deadline)
+{
+    if((NO_DEADLINE == deadline) || !receiveTimerValid_)
+    {
+        return;
     }
 
-    return false;
+    if((0 != receiveTimerDeadline_) && (receiveTimerDeadline_ <= deadline))
+    {
+        return;
+    }
+
+    receiveTimerDeadline_ = deadline;
+
+    const uint64_t cyclesPerSec = SYSPAGE_ENTRY(qtime)->cycles_per_sec;
+    const uint64_t now = ClockCycles();
+    const uint64_t delay = (deadline > now) ? deadline - now : 0;
+
+    struct itimerspec timerSpec = {};
+
+    // a zero expiry would disarm the timer
+    nsec2timespec(&timerSpec.it_value, std::max<uint64_t>(1, (delay / cyclesPerSec) * 1000000000ULL +
+                                                             (delay % cyclesPerSec) * 1000000000ULL / cyclesPerSec));
+
+    timer_settime(receiveTimer_, 0, &timerSpec, 0);
 }
 
 //----------------------------------------------------------------------
 
-int CanManager::io_unblock (resmgr_context_t *ctp, io_pulse_t *msg, RESMGR_OCB_T *ocb)
+int CanManager::GetSharedQueue(resmgr_context_t *ctp, io_devctl_t *msg)
 {
-    //unblock read return -1
+    if(0 == shmHeader_)
+    {
+        return ENOSYS;
+    }
 
-    MsgReply(ctp->rcvid, -1 , 0, 0);
+    if(sizeof(CanShmInfo) > msg->i.nbytes)
+    {
+        return EINVAL;
+    }
 
-    return iofunc_unblock_default(ctp, msg, &ocb->defaultOCB_);
+    CanShmInfo* info = (CanShmInfo*)(_DEVCTL_DATA(msg->o));
+
+    memset(info, 0, sizeof(CanShmInfo));
+    strncpy(info->name_, shmName_.c_str(), sizeof(info->name_) - 1);
+    info->size_ = shmSize_;
+
+    memset(&msg->o, 0, sizeof(msg->o));
+    msg->o.nbytes = sizeof(CanShmInfo);
+
+    return (_RESMGR_PTR(ctp, &msg->o, sizeof(msg->o) + sizeof(CanShmInfo)));
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::AttachTransmitRing(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb)
+{
+    // verify that the device is opened for write
+    if(0 == (ocb->defaultOCB_.ioflag & 0x02)) 
+    {
+        return EBADF;
+    }
+
+    if((sizeof(CanShmTxAttach) != msg->i.nbytes) || (-1 == transmitDoorbell_))
+    {
+        return EINVAL;
+    }
+
+    CanShmTxAttach* attach = (CanShmTxAttach*)(_DEVCTL_DATA(msg->i));
+
+    // the ring belongs to the user of the client, not to the driver
+    struct _client_info* info = 0;
+
+    if(EOK != iofunc_client_info_ext(ctp, 0, &info, 0))
+    {
+        return EPERM;
+    }
+
+    SharedTransmitRing* transmitRing = 0;
+
+    try
+    {
+        transmitRing = new SharedTransmitRing(attach->slotCount_, info->cred.euid, info->cred.egid);
+    }
+    catch (const std::exception& e)
+    {
+        LOG(error) << e.what() << ": " << attach->slotCount_ << " slots";
+
+        iofunc_client_info_ext_free(&info);
+
+        return EINVAL;
+    }
+
+    iofunc_client_info_ext_free(&info);
+
+    if(0 != ocb->transmitRing_)
+    {
+        canController_->RemoveTransmitSource(ocb->transmitRing_);
+        delete ocb->transmitRing_;
+    }
+
+    ocb->transmitRing_ = transmitRing;
+
+    canController_->AddTransmitSource(transmitRing);
+
+    attach = (CanShmTxAttach*)(_DEVCTL_DATA(msg->o));
+
+    memset(attach, 0, sizeof(CanShmTxAttach));
+    strncpy(attach->name_, transmitRing->Name().c_str(), sizeof(attach->name_) - 1);
+    attach->size_ = transmitRing->Size();
+    attach->doorbell_ = transmitDoorbell_;
+
+    memset(&msg->o, 0, sizeof(msg->o));
+    msg->o.nbytes = sizeof(CanShmTxAttach);
+
+    return (_RESMGR_PTR(ctp, &msg->o, sizeof(msg->o) + sizeof(CanShmTxAttach)));
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::SetCyclicTransmission(resmgr_context_t */*ctp*/, io_devctl_t *msg, RESMGR_OCB_T *ocb)
+{
+    // verify that the device is opened for write
+    if(0 == (ocb->defaultOCB_.ioflag & 0x02)) 
+    {
+        return EBADF;
+    }
+
+    if(sizeof(CanCyclicJob) != msg->i.nbytes) 
+    {
+        return EINVAL;
+    }
+
+    const CanCyclicJob* job = (const CanCyclicJob*)(_DEVCTL_DATA(msg->i));
+
+    return cyclicScheduler_->SetJob(this, ocb, *job);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::GetCyclicStats(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb)
+{
+    if(sizeof(CanCyclicStats) != msg->i.nbytes) 
+    {
+        return EINVAL;
+    }
+
+    const uint32_t jobId = ((const CanCyclicStats*)(_DEVCTL_DATA(msg->i)))->jobId_;
+
+    CanCyclicStats stats;
+
+    const int status = cyclicScheduler_->GetStats(ocb, jobId, stats);
+
+    if(EOK != status)
+    {
+        return status;
+    }
+
+    *(CanCyclicStats*)(_DEVCTL_DATA(msg->o)) = stats;
+
+    memset(&msg->o, 0, sizeof(msg->o));
+    msg->o.nbytes = sizeof(CanCyclicStats);
+
+    return (_RESMGR_PTR(ctp, &msg->o, sizeof(msg->o) + sizeof(CanCyclicStats)));
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::SampleStats(CanStats& stats, const RESMGR_OCB_T* ocb)
+{
+    canController_->Stats().Sample(stats);
+
+    stats.delivered_ = ocb->delivered_.load(std::memory_order_relaxed);
+    stats.skipped_ = ocb->skipped_.load(std::memory_order_relaxed);
+    stats.overwritten_ = ocb->overwritten_.load(std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::GetStats(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb)
+{
+    if(sizeof(CanStats) != msg->i.nbytes) 
+    {
+        return EINVAL;
+    }
+
+    CanStats stats;
+
+    SampleStats(stats, ocb);
+
+    memset(&msg->o, 0, sizeof(msg->o));
+    msg->o.nbytes = sizeof(CanStats);
+
+    *(CanStats*)(_DEVCTL_DATA(msg->o)) = stats;
+
+    return (_RESMGR_PTR(ctp, &msg->o, sizeof(msg->o) + sizeof(CanStats)));
+}
+
+//----------------------------------------------------------------------
+
+std::string CanManager::StatsText()
+{
+    CanStats stats = {};
+
+    canController_->Stats().Sample(stats);
+
+    const struct
+    {
+        const char* name_;
+        uint64_t value_;
+    } counters[] =
+    {
+        { "rx frames",              stats.rxFrames_ },
+        { "rx bytes",               stats.rxBytes_ },
+        { "tx frames",              stats.txFrames_ },
+        { "tx bytes",               stats.txBytes_ },
+        { "hardware overruns",      stats.hardwareOverruns_ },
+        { "ring drops",             stats.ringDrops_ },
+        { "queue overwrites",       stats.queueOverwrites_ },
+        { "bus errors",             stats.busErrors_ },
+        { "bit errors",             stats.bitErrors_ },
+        { "form errors",            stats.formErrors_ },
+        { "stuff errors",           stats.stuffErrors_ },
+        { "other errors",           stats.otherErrors_ },
+        { "error warnings",         stats.errorWarnings_ },
+        { "error passives",         stats.errorPassives_ },
+        { "bus offs",               stats.busOffs_ },
+        { "arbitration losses",     stats.arbitrationLosses_ },
+        { "interrupts",             stats.interrupts_ },
+        { "pulses",                 stats.pulses_ },
+        { "tx queue high water",    stats.txQueueHighWater_ },
+    };
+
+    std::ostringstream os;
+
+    for(const auto& counter: counters)
+    {
+        os << std::left << std::setw(24) << (std::string(counter.name_) + ":") << counter.value_ << "\n";
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+
+    for(const auto ocb: statsOcbs_)
+    {
+        os << "file of pid " << ocb->pid_
+           << ": delivered " << ocb->delivered_.load(std::memory_order_relaxed)
+           << " skipped " << ocb->skipped_.load(std::memory_order_relaxed)
+           << " overwritten " << ocb->overwritten_.load(std::memory_order_relaxed) << "\n";
+    }
+
+    return os.str();
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::io_read_stats (resmgr_context_t *ctp, io_read_t *msg, RESMGR_OCB_T *ocb)
+{
+    return ocb->manager_->ReadStats(ctp, msg, ocb);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::ReadStats(resmgr_context_t *ctp, io_read_t *msg, RESMGR_OCB_T *ocb)
+{
+    int status;
+
+    if ((status = iofunc_read_verify (ctp, msg, &(ocb->defaultOCB_), 0)) != EOK)
+        return (status);
+
+    if ((msg->i.xtype & _IO_XTYPE_MASK) != _IO_XTYPE_NONE)
+        return (ENOSYS);
+
+    // a read from the start samples the counters again
+    if((0 == ocb->statsText_) || (0 == ocb->defaultOCB_.offset))
+    {
+        if(0 == ocb->statsText_)
+        {
+            ocb->statsText_ = new std::string();
+        }
+
+        *ocb->statsText_ = StatsText();
+    }
+
+    const std::string& text = *ocb->statsText_;
+
+    const size_t offset = std::min<size_t>(ocb->defaultOCB_.offset, text.size());
+    const size_t nbytes = std::min<size_t>(msg->i.nbytes, text.size() - offset);
+
+    ocb->defaultOCB_.offset += nbytes;
+
+    _IO_SET_READ_NBYTES(ctp, nbytes);
+
+    SETIOV(ctp->iov, text.data() + offset, nbytes);
+
+    return (_RESMGR_NPARTS(1));
+}
+
+//----------------------------------------------------------------------
+
+IOFUNC_OCB_T* CanManager::stats_ocb_calloc (resmgr_context_t */*ctp*/, IOFUNC_ATTR_T *device)
+{
+    IOFUNC_OCB_T *ocb;
+
+    ocb = (IOFUNC_OCB_T*)(calloc (1, sizeof(IOFUNC_OCB_T)));
+
+    if (0 == ocb) 
+    {
+        return 0;
+    }
+
+    ocb->manager_ = device->manager_;
+
+    return ocb;
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::stats_ocb_free (IOFUNC_OCB_T *ocb)
+{
+    delete ocb->statsText_;
+
+    free (ocb);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::SetIsoTp(resmgr_context_t */*ctp*/, io_devctl_t *msg, RESMGR_OCB_T *ocb)
+{
+    // verify that the device is opened for write, the endpoint sends flow control
+    if(0 == (ocb->defaultOCB_.ioflag & 0x02)) 
+    {
+        return EBADF;
+    }
+
+    if(sizeof(CanIsoTpConfig) != msg->i.nbytes) 
+    {
+        return EINVAL;
+    }
+
+    const CanIsoTpConfig* config = (const CanIsoTpConfig*)(_DEVCTL_DATA(msg->i));
+
+    const int status = isoTpEngine_->SetEndpoint(ocb, *config);
+
+    if(EOK != status)
+    {
+        return status;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+
+        ocb->isoTpConfig_ = *config;
+        ocb->isoTp_ = true;
+
+        // waiting frame reads end, the file reads PDUs from now on
+        delayedQueue_.Remove([ocb](const DelayElement& element)
+        {
+            if(ocb != element.ocb_)
+            {
+                return false;
+            }
+
+            MsgReply(element.rcvId_, EOK, NULL, 0);
+            return true;
+        });
+    }
+
+    UpdateAcceptanceFilter();
+
+    return (EOK);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::ReadPdu(resmgr_context_t *ctp, io_read_t *msg, RESMGR_OCB_T *ocb, bool nonBlock)
+{
+    if(0 == msg->i.nbytes)
+        return (EINVAL);
+
+    const int status = isoTpEngine_->Read(ocb, ctp->rcvid, msg->i.nbytes, nonBlock);
+
+    if(EOK != status)
+        return (status);
+
+    /* mark the access time as invalid (we just accessed it) */
+    ocb->defaultOCB_.attr->defaultAttr_.flags |= IOFUNC_ATTR_ATIME | IOFUNC_ATTR_DIRTY_TIME;
+
+    return (_RESMGR_NOREPLY);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::WritePdu(resmgr_context_t *ctp, io_write_t *msg, RESMGR_OCB_T *ocb)
+{
+    if((0 == msg->i.nbytes) || (msg->i.nbytes > CanIsoTpConfig::MAX_PDU))
+        return (EINVAL);
+
+    // the PDU may exceed the receive buffer, read it from the client
+    std::vector<uint8_t> pdu(msg->i.nbytes);
+
+    if(resmgr_msgread(ctp, pdu.data(), pdu.size(), sizeof(msg->i)) == -1)
+    {
+        return (errno);
+    }
+
+    const bool nonBlock = (0 != (ocb->defaultOCB_.ioflag & O_NONBLOCK)) || (0 != (msg->i.xtype & _IO_XFLAG_NONBLOCK));
+
+    const int status = isoTpEngine_->Write(ocb, ctp->rcvid, pdu, nonBlock);
+
+    if(EOK != status)
+        return (status);
+
+    ocb->defaultOCB_.attr->defaultAttr_.flags |= IOFUNC_ATTR_MTIME | IOFUNC_ATTR_DIRTY_TIME;
+
+    return (_RESMGR_NOREPLY);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::TransmitDoorbell(message_context_t */*ctp*/, int /*code*/, unsigned /*flags*/, void *handle)
+{
+    static_cast<CanManager*>(handle)->canController_->KickTransmit();
+
+    return 0;
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::TransmitSpace(message_context_t */*ctp*/, int /*code*/, unsigned /*flags*/, void *handle)
+{
+    static_cast<CanManager*>(handle)->ServeTransmitWaiters();
+
+    return 0;
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::ServeTransmitWaiters()
+{
+    while(!transmitWaiters_.empty())
+    {
+        const DelayElement element = transmitWaiters_.front();
+
+        if(DelayElement::ET_WRITE == element.type_)
+        {
+            const uint32_t nFrames = std::min<uint32_t>(element.nbytes_ / sizeof(can_frame), MAX_WRITE_FRAMES);
+
+            if(MsgRead(element.rcvId_, writeBuffer_.data(), nFrames * sizeof(can_frame), sizeof(struct _io_write)) == -1)
+            {
+                MsgError(element.rcvId_, errno);
+            }
+            else
+            {
+                const std::size_t nAccepted = canController_->WriteMessages(writeBuffer_.data(), nFrames);
+
+                if(0 == nAccepted)
+                {
+                    // full again, WriteMessages armed the space handler
+                    return;
+                }
+
+                MsgReply(element.rcvId_, nAccepted * sizeof(can_frame), NULL, 0);
+            }
+        }
+        else
+        {
+            if(0 == canController_->TransmitQueueSpace())
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(queueMutex_);
+
+            if(SIGEV_NONE != element.ocb_->notifyEvent_.ev32.sigev_notify) 
+            {
+                element.ocb_->notifyEvent_.ev32.sigev_value.sival_int |= _NOTIFY_COND_OUTPUT;
+
+                MsgDeliverEvent(element.rcvId_, &element.ocb_->notifyEvent_.ev);
+                element.ocb_->notifyEvent_.ev32.sigev_notify = SIGEV_NONE;
+            }
+        }
+
+        transmitWaiters_.pop_front();
+    }
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::RemoveTransmitWaiters(const RESMGR_OCB_T *ocb, int rcvId)
+{
+    for(auto element = transmitWaiters_.begin(); element != transmitWaiters_.end(); )
+    {
+        if((0 != ocb) ? (ocb == element->ocb_) : (rcvId == element->rcvId_))
+        {
+            // the unblocked client gets the reply of io_unblock
+            if((0 != ocb) && (DelayElement::ET_WRITE == element->type_))
+            {
+                MsgError(element->rcvId_, EBADF);
+            }
+
+            element = transmitWaiters_.erase(element);
+        }
+        else
+        {
+            ++element;
+        }
+    }
+}
+
+//----------------------------------------------------------------------
+
+IOFUNC_OCB_T* CanManager::ocb_calloc (resmgr_context_t *ctp, IOFUNC_ATTR_T *device)
+{
+    IOFUNC_OCB_T *ocb;
+
+    ocb = (IOFUNC_OCB_T*)(calloc (1, sizeof(IOFUNC_OCB_T)));
+
+    if (0 == ocb) 
+    {
+        return 0;
+    }
+
+    ocb->notifyEvent_.ev32.sigev_notify = SIGEV_NONE;
+    ocb->pid_ = ctp->info.pid;
+
+    ocb->manager_ = device->manager_;
+    ocb->manager_->AddOcb(ocb);
+
+    return ocb;
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::AddOcb(RESMGR_OCB_T *ocb)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+
+        openOcbs_.insert(ocb);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+
+        statsOcbs_.push_back(ocb);
+    }
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::ocb_free (IOFUNC_OCB_T *ocb)
+{
+    ocb->manager_->RemoveOcb(ocb);
+
+    free (ocb);
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::RemoveOcb(RESMGR_OCB_T *ocb)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+
+        openOcbs_.erase(ocb);
+
+        receiveJobOcbs_.erase(std::remove(receiveJobOcbs_.begin(), receiveJobOcbs_.end(), ocb), receiveJobOcbs_.end());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+
+        statsOcbs_.erase(std::remove(statsOcbs_.begin(), statsOcbs_.end(), ocb), statsOcbs_.end());
+    }
+
+    delete ocb->filterSet_;
+    delete ocb->receiveJobs_;
+
+    if(0 != ocb->transmitRing_)
+    {
+        canController_->RemoveTransmitSource(ocb->transmitRing_);
+        delete ocb->transmitRing_;
+    }
+
+    UpdateAcceptanceFilter();
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::UpdateAcceptanceFilter()
+{
+    if(!hardwareFilter_)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> acceptanceLock(acceptanceMutex_);
+
+    std::vector<can_filter> filters;
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+
+        bool readers = false;
+
+        for(const auto ocb: openOcbs_)
+        {
+            // files opened for write only do not take frames
+            if(0 == (ocb->defaultOCB_.ioflag & _IO_FLAG_RD))
+            {
+                continue;
+            }
+
+            readers = true;
+
+            if(ocb->isoTp_)
+            {
+                const canid_t rxId = ocb->isoTpConfig_.rxId_;
+
+                filters.push_back(can_filter{ rxId & (CAN_EFF_FLAG | CAN_EFF_MASK),
+                                              CAN_EFF_FLAG | ((rxId & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK) });
+                continue;
+            }
+
+            if(0 != ocb->filterSet_)
+            {
+                ocb->filterSet_->GetCover(filters);
+                continue;
+            }
+
+            const CanMessageFilter& filter = ocb->canMessageFilter_;
+
+            switch(filter.type_)
+            {
+            case CanMessageFilter::ET_AMASK:
+                filters.push_back(can_filter{ filter.acceptancePattern_ & filter.acceptanceMask_,
+                                              filter.acceptanceMask_ & CAN_EFF_MASK });
+                break;
+
+            case CanMessageFilter::ET_RANGE:
+                if(filter.lower_ <= filter.upper_)
+                {
+                    filters.push_back(CanFilterSet::RangeCover(filter.lower_ & CAN_EFF_MASK, filter.upper_ & CAN_EFF_MASK));
+                }
+                break;
+
+            default:
+                filters.push_back(can_filter{ 0, 0 });
+                break;
+            }
+        }
+
+        // without readers the queue keeps all frames for the next one
+        if(!readers)
+        {
+            filters.push_back(can_filter{ 0, 0 });
+        }
+
+        acceptanceFilter_ = filters;
+    }
+
+    canController_->SetAcceptanceFilter(filters);
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::ClampReaderOffset(RESMGR_OCB_T* ocb)
+{
+    if(ocb->defaultOCB_.offset < queueBottom_)
+    {
+        // the queue has overwritten the frames the reader did not take yet
+        const uint64_t overwritten = queueBottom_ - ocb->defaultOCB_.offset;
+
+        ChannelStats::Add(ocb->overwritten_, overwritten);
+
+        ocb->defaultOCB_.offset = queueBottom_;
+    }
+    else if(ocb->defaultOCB_.offset > queueHead_)
+    {
+        ocb->defaultOCB_.offset = queueBottom_;
+    }
+}
+
+//----------------------------------------------------------------------
+
+const CanMessageFilter* CanManager::DelayFilter(const RESMGR_OCB_T* ocb)
+{
+    return (0 != ocb->filterSet_) ? 0 : &ocb->canMessageFilter_;
+}
+
+//----------------------------------------------------------------------
+
+void CanManager::ReindexDelayed(RESMGR_OCB_T* ocb)
+{
+    std::vector<DelayElement> waiting;
+
+    delayedQueue_.Remove([ocb, &waiting](const DelayElement& element)
+    {
+        if(ocb != element.ocb_)
+        {
+            return false;
+        }
+
+        waiting.push_back(element);
+        return true;
+    });
+
+    for(const auto& element: waiting)
+    {
+        delayedQueue_.Push(element, DelayFilter(ocb));
+    }
+}
+
+//----------------------------------------------------------------------
+
+bool CanManager::Accepted(uint32_t slot, const RESMGR_OCB_T* ocb) const
+{
+    if((0 != ocb->receiveJobs_) && ocb->receiveJobs_->Suppressed(slot))
+    {
+        return false;
+    }
+
+    return CheckFilter(canMessageQueue_[slot], ocb);
+}
+
+//----------------------------------------------------------------------
+
+bool CanManager::CheckFilter(const can_frame& canFrame, const RESMGR_OCB_T* ocb)
+{
+    if(0 != ocb->filterSet_)
+    {
+        return ocb->filterSet_->Accept(canFrame);
+    }
+
+    // error frames are selected by an ET_ERROR rule of a filter set only
+    if(canFrame.can_id & CAN_ERR_FLAG)
+    {
+        return false;
+    }
+
+    return CheckFilter(canFrame, ocb->canMessageFilter_);
+}
+
+//----------------------------------------------------------------------
+
+bool CanManager::CheckFilter(const can_frame& canFrame, const CanMessageFilter& filter)
+{
+    const uint32_t nArb = canFrame.can_id & CAN_EFF_MASK;
+
+    switch (filter.type_) {
+    case CanMessageFilter::ET_AMASK:
+        if(( nArb & filter.acceptanceMask_) ==
+            (filter.acceptancePattern_ & filter.acceptanceMask_)) 
+        {
+
+            return true;
+        }
+        break;
+
+    case CanMessageFilter::ET_RANGE:
+        if(( nArb >= filter.lower_) && (nArb <= filter.upper_)) 
+        {
+
+            return true;
+        }
+
+        break;
+    default:
+        return true;
+        break;
+    }
+
+    return false;
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::io_unblock (resmgr_context_t *ctp, io_pulse_t *msg, RESMGR_OCB_T *ocb)
+{
+    //a blocked write leaves the transmit waiters
+    ocb->manager_->RemoveTransmitWaiters(0, ctp->rcvid);
+
+    //as well as blocked ISO-TP transfers
+    ocb->manager_->isoTpEngine_->Unblock(ctp->rcvid);
+
+    //unblock read return -1
+
+    MsgReply(ctp->rcvid, -1 , 0, 0);
+
+    return iofunc_unblock_default(ctp, msg, &ocb->defaultOCB_);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::io_lseek (resmgr_context_t *ctp, io_lseek_t *msg, RESMGR_OCB_T *ocb)
+{
+    return ocb->manager_->Lseek(ctp, msg, ocb);
+}
+
+//----------------------------------------------------------------------
+
+int CanManager::Lseek(resmgr_context_t *ctp, io_lseek_t *msg, RESMGR_OCB_T *ocb)
+{
+    // the offset is the number of the next frame, shared memory readers
+    // set it before they wait with select or ionotify
+    std::lock_guard<std::mutex> lock(queueMutex_);
+
+    switch(msg->i.whence)
+    {
+    case SEEK_SET:
+        ocb->defaultOCB_.offset = msg->i.offset;
+        break;
+
+    case SEEK_CUR:
+        ocb->defaultOCB_.offset += msg->i.offset;
+        break;
+
+    case SEEK_END:
+        ocb->defaultOCB_.offset = queueHead_ + msg->i.offset;
+        break;
+
+    default:
+        return EINVAL;
+    }
+
+    msg->o = ocb->defaultOCB_.offset;
+
+    return (_RESMGR_PTR(ctp, &msg->o, sizeof(msg->o)));
 }
 
 //----------------------------------------------------------------------
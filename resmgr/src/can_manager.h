@@ -7,43 +7,47 @@
 
 #pragma once
 
-#define IOFUNC_OCB_T struct CanExtendedOCB
-
 #include <thread>
 #include <mutex>
+#include <deque>
 
-#include <sys/iofunc.h>
-#include <sys/dispatch.h>
 #include <sys/procmgr.h>
 
+#include <set>
+#include <string>
 #include <vector>
 
-#include <canrm.h>
+#include <can_ocb.h>
+#include <delayed_queue.h>
 #include <can_controller.h>
+#include <cyclic_scheduler.h>
+#include <isotp_engine.h>
+#include <stage_timing.h>
 
 #include <can.h>
+#include <can_shm.h>
 
-struct CanExtendedOCB
+class CanManager
 {
-    iofunc_ocb_t defaultOCB_;
-
-    CanMessageFilter canMessageFilter_;
+public:
 
-    union
+    // Thread which puts received frames to the message queue
+    enum EReceiveMode
     {
-        struct sigevent ev;
-        struct __sigevent32 ev32;
-        struct __sigevent64 ev64;
-    } notifyEvent_;
-
-};
+        ERM_RECEIVE_THREAD,     // dedicated data receive thread
+        ERM_DIRECT              // controller interrupt handling thread
+    };
 
-class CanManager
-{
-public:
-    CanManager(std::shared_ptr<CanController> canController, uint32_t nQueueSize = 3);
+    // The cyclic scheduler is shared by the channels, its thread serves all of them
+    CanManager(std::shared_ptr<CanController> canController, std::shared_ptr<CyclicScheduler> cyclicScheduler,
+               uint32_t nQueueSize = 3,
+               EReceiveMode receiveMode = ERM_RECEIVE_THREAD, bool hardwareFilter = false,
+               const std::string& shmName = std::string());
     virtual ~CanManager();
 
+    // Register the channel path in the dispatch loop shared by all channels
+    bool Attach(dispatch_t* dpp, const std::string& path, unsigned resourceFlag);
+
     static int io_read  (resmgr_context_t *ctp, io_read_t   *msg, RESMGR_OCB_T *ocb);
     static int io_open  (resmgr_context_t *ctp, io_open_t   *msg, RESMGR_HANDLE_T *handle, void *extra);
     static int io_write (resmgr_context_t *ctp, io_write_t  *msg, RESMGR_OCB_T *ocb);
@@ -52,55 +56,215 @@ public:
     static int io_close_dup (resmgr_context_t *ctp, io_close_t *msg, RESMGR_OCB_T *ocb);
     static int io_close_ocb (resmgr_context_t *ctp, void *msg, RESMGR_OCB_T *ocb);
     static int io_unblock (resmgr_context_t *ctp, io_pulse_t *msg, RESMGR_OCB_T *ocb);
+    static int io_lseek (resmgr_context_t *ctp, io_lseek_t *msg, RESMGR_OCB_T *ocb);
 
     static IOFUNC_OCB_T* ocb_calloc (resmgr_context_t *ctp, IOFUNC_ATTR_T *device);
     static void ocb_free (IOFUNC_OCB_T *ocb);
 
+    // Stats file of the channel
+    static int io_read_stats (resmgr_context_t *ctp, io_read_t *msg, RESMGR_OCB_T *ocb);
+
+    static IOFUNC_OCB_T* stats_ocb_calloc (resmgr_context_t *ctp, IOFUNC_ATTR_T *device);
+    static void stats_ocb_free (IOFUNC_OCB_T *ocb);
+
+    // Pulse sent by clients of transmit rings when the controller is idle,
+    // the handle is the manager of the ring
+    static int TransmitDoorbell(message_context_t *ctp, int code, unsigned flags, void *handle);
+
+    // Pulse of the controller thread when the full transmit queue has room again
+    static int TransmitSpace(message_context_t *ctp, int code, unsigned flags, void *handle);
+
+    // Pulse of the receive timeout timer
+    static int ReceiveTimeout(message_context_t *ctp, int code, unsigned flags, void *handle);
+
 private:
 
-    static iofunc_notify_t notify_[3];  /* notification list used by iofunc_notify*() */
+    // Maximal number of separate queue regions in one read reply
+    static const uint32_t MAX_REPLY_PARTS = 16;
+
+    // Maximal number of timed frames in one read reply, they are copied
+    static const uint32_t MAX_TIMED_FRAMES = 64;
+
+    // Maximal number of frames taken from one write request
+    static const uint32_t MAX_WRITE_FRAMES = 1024;
+
+    // Receive timer deadline while no receive job has a timeout pending
+    static const uint64_t NO_DEADLINE = ~0ULL;
+
+    // Handlers of the io functions above for the channel of this manager
+    int Read  (resmgr_context_t *ctp, io_read_t   *msg, RESMGR_OCB_T *ocb);
+    int Open  (resmgr_context_t *ctp, io_open_t   *msg, RESMGR_HANDLE_T *handle, void *extra);
+    int Write (resmgr_context_t *ctp, io_write_t  *msg, RESMGR_OCB_T *ocb);
+    int Notify(resmgr_context_t *ctp, io_notify_t *msg, RESMGR_OCB_T *ocb);
+    int Devctl(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb);
+    int CloseOcb(resmgr_context_t *ctp, void *msg, RESMGR_OCB_T *ocb);
+    int Lseek (resmgr_context_t *ctp, io_lseek_t *msg, RESMGR_OCB_T *ocb);
+
+    void AddOcb(RESMGR_OCB_T *ocb);
+    void RemoveOcb(RESMGR_OCB_T *ocb);
+
+    // Retry blocked writes and deliver output notifications in arrival order
+    // while the transmit queue accepts frames
+    void ServeTransmitWaiters();
+
+    // Drop the waiting writes and notifications of the OCB or of one client
+    void RemoveTransmitWaiters(const RESMGR_OCB_T *ocb, int rcvId);
+
+    resmgr_connect_funcs_t connectFuncs_;
+    resmgr_io_funcs_t ioFuncs_;
+    iofunc_mount_t mount_;
+    iofunc_funcs_t mountFuncs_;
+    CanDeviceAttr attr_;
+
+    // Read only text file with the counters of the channel and of the open files
+    void AttachStats(dispatch_t* dpp, const std::string& path, unsigned resourceFlag);
+
+    int ReadStats(resmgr_context_t *ctp, io_read_t *msg, RESMGR_OCB_T *ocb);
+
+    std::string StatsText();
+
+    resmgr_connect_funcs_t statsConnectFuncs_;
+    resmgr_io_funcs_t statsIoFuncs_;
+    iofunc_mount_t statsMount_;
+    iofunc_funcs_t statsMountFuncs_;
+    CanDeviceAttr statsAttr_;
+
+    // Channel counters and the ones of the open file
+    void SampleStats(CanStats& stats, const RESMGR_OCB_T* ocb);
+
+    int GetStats(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb);
+
+    // Open files listed by the stats file, protected by statsMutex_ so that
+    // sampling does not wait for the message queue
+    std::mutex statsMutex_;
+    std::vector<RESMGR_OCB_T*> statsOcbs_;
+
+    std::vector<can_frame> writeBuffer_;
+
+    iofunc_notify_t notify_[3];  /* notification list used by iofunc_notify*() */
+
+    std::shared_ptr<CanController> canController_;
+
+    can_frame* canMessageQueue_;
 
-    static std::shared_ptr<CanController> canController_;
+    // Receive timestamps of the queued frames
+    uint64_t* timestampQueue_;
 
-    static can_frame* canMessageQueue_;
+    uint32_t queueSize_;
 
-    static uint32_t queueSize_;
+    uint32_t queueBottom_;
+    uint32_t queueHead_;
 
-    static uint32_t queueBottom_;
-    static uint32_t queueHead_;
+    std::mutex queueMutex_;
 
-    static std::mutex queueMutex_;
+    // Message queue placed in shared memory, readable by the clients
+    void CreateSharedQueue(const std::string& shmName);
+
+    int GetSharedQueue(resmgr_context_t *ctp, io_devctl_t *msg);
+
+    int AttachTransmitRing(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb);
+
+    int SetCyclicTransmission(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb);
+    int GetCyclicStats(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb);
+
+    // Cyclic transmissions of the open files, fed to the controller transmit queue
+    std::shared_ptr<CyclicScheduler> cyclicScheduler_;
+
+    int SetIsoTp(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb);
+
+    // Read and Write of ISO-TP endpoints
+    int ReadPdu (resmgr_context_t *ctp, io_read_t  *msg, RESMGR_OCB_T *ocb, bool nonBlock);
+    int WritePdu(resmgr_context_t *ctp, io_write_t *msg, RESMGR_OCB_T *ocb);
+
+    // ISO-TP endpoints of the open files, served from the receive path
+    std::unique_ptr<IsoTpEngine> isoTpEngine_;
+
+    int transmitDoorbell_;
+
+    // Side channel connection of the dispatch loop pulses, pulse code of the transmit space pulse
+    int transmitSpaceCoid_;
+    int transmitSpacePulse_;
+
+    // Writes and output notifications waiting for transmit queue space,
+    // used by the dispatch thread only
+    std::deque<DelayElement> transmitWaiters_;
+
+    std::string shmName_;
+    std::size_t shmSize_;
+    CanShmHeader* shmHeader_;
+    std::atomic<uint32_t>* shmSequence_;
 
     bool terminate_;
     bool filling_;
 
+    EReceiveMode receiveMode_;
+
     // Receive Data Thread
     std::thread dataReceiveThread_;
     void* DataReceiveThread();
 
-    // Queue for delayed data request
-    struct DelayElement 
-    {
-        enum EType
-        {
-            ET_UNDEFINED,
-            ET_REPLY,
-            ET_NOTIFY
-        } type_;
-
-        int rcvId_;
-        RESMGR_OCB_T *ocb_;
-
-        DelayElement(EType type, int rcvId, RESMGR_OCB_T *ocb)
-         : type_(type)
-         , rcvId_(rcvId)
-         , ocb_(ocb)
-         {}
-    };
+    // Put the frame to the message queue and serve delayed requests
+    void PublishMessage(const CanTimedFrame& timedFrame);
+
+    StageTiming publishTiming_;
 
     static bool CheckFilter(const can_frame& canFrame, const CanMessageFilter& filter);
+    static bool CheckFilter(const can_frame& canFrame, const RESMGR_OCB_T* ocb);
+
+    // Move a reader offset outside the message queue to its bottom and count the
+    // frames the file lost to the overwrite, queueMutex_ must be locked
+    void ClampReaderOffset(RESMGR_OCB_T* ocb);
 
-    static std::vector<DelayElement> delayedQueue_;
-    typedef std::vector<DelayElement>::iterator DelayedQueueIterator;
+    // The filter and the receive jobs of the OCB pass the frame of the queue slot
+    bool Accepted(uint32_t slot, const RESMGR_OCB_T* ocb) const;
+
+    // Filter indexing a delayed request of the OCB, rule sets are checked for every frame
+    static const CanMessageFilter* DelayFilter(const RESMGR_OCB_T* ocb);
+
+    // Index the delayed requests of the OCB by its new filter, queueMutex_ must be locked
+    void ReindexDelayed(RESMGR_OCB_T* ocb);
+
+    int SetFilters(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb);
+
+    int SetReceiveJob(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb);
+    int GetReceiveJobStatus(resmgr_context_t *ctp, io_devctl_t *msg, RESMGR_OCB_T *ocb);
+
+    // Mark the overdue receive jobs and notify their clients, dispatch thread
+    void CheckReceiveTimeouts();
+
+    // Program the receive timer if the deadline is before the programmed one,
+    // queueMutex_ must be locked
+    void ArmReceiveTimer(uint64_t deadline);
+
+    // Open files with receive jobs, protected by queueMutex_
+    std::vector<RESMGR_OCB_T*> receiveJobOcbs_;
+
+    // One shot timer of the earliest receive job timeout, sends the receive timeout pulse
+    int receiveTimeoutPulse_;
+    timer_t receiveTimer_;
+    bool receiveTimerValid_;
+
+    // Programmed timer expiry in ClockCycles(), 0 while idle, protected by queueMutex_
+    uint64_t receiveTimerDeadline_;
+
+    // Program the controller acceptance filter with the union of the open file filters
+    void UpdateAcceptanceFilter();
+
+    bool hardwareFilter_;
+
+    std::set<RESMGR_OCB_T*> openOcbs_;
+
+    // serializes the acceptance filter updates
+    std::mutex acceptanceMutex_;
+
+    // union of the client filters, protected by queueMutex_
+    std::vector<can_filter> acceptanceFilter_;
+
+    // frames passed by the hardware filter which no client filter accepts
+    uint64_t receivedFrames_;
+    uint64_t unwantedFrames_;
+
+    // Queue for delayed data request
+    DelayedQueue<DelayElement> delayedQueue_;
 };
 
@@ -0,0 +1,106 @@
+#pragma once
+
+#define IOFUNC_OCB_T struct CanExtendedOCB
+#define IOFUNC_ATTR_T struct CanDeviceAttr
+
+#include <sys/iofunc.h>
+#include <sys/dispatch.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <canrm.h>
+
+#include "can_filter_set.h"
+#include "receive_job_set.h"
+#include "shared_transmit_ring.h"
+
+//------------------------------------------------------------------------------
+
+class CanManager;
+
+// Attributes of one registered channel path
+struct CanDeviceAttr
+{
+    iofunc_attr_t defaultAttr_;
+
+    CanManager* manager_;
+};
+
+//------------------------------------------------------------------------------
+
+struct CanExtendedOCB
+{
+    iofunc_ocb_t defaultOCB_;
+
+    // Manager of the channel the file is opened on
+    CanManager* manager_;
+
+    CanMessageFilter canMessageFilter_;
+
+    // Rules of EDCMD_SET_FILTERS, replace canMessageFilter_ if set
+    CanFilterSet* filterSet_;
+
+    // Receive jobs of EDCMD_SET_RX_JOB, narrow the filter for their identifiers
+    ReceiveJobSet* receiveJobs_;
+
+    // ISO-TP endpoint of EDCMD_SET_ISOTP, read and write transfer PDUs
+    bool isoTp_;
+    CanIsoTpConfig isoTpConfig_;
+
+    // ECanFrameFormat of read
+    std::uint32_t frameFormat_;
+
+    // Transmit ring of EDCMD_ATTACH_TX_SHM, drained by the controller
+    SharedTransmitRing* transmitRing_;
+
+    // Counters of EDCMD_GET_STATS, written under the queue lock and sampled without it
+    std::atomic<std::uint64_t> delivered_;
+    std::atomic<std::uint64_t> skipped_;
+    std::atomic<std::uint64_t> overwritten_;
+
+    // Client which opened the file
+    pid_t pid_;
+
+    // Text of a stats file, taken again by a read from offset 0
+    std::string* statsText_;
+
+    union
+    {
+        struct sigevent ev;
+        struct __sigevent32 ev32;
+        struct __sigevent64 ev64;
+    } notifyEvent_;
+
+};
+
+//------------------------------------------------------------------------------
+
+// Delayed data request
+struct DelayElement 
+{
+    enum EType
+    {
+        ET_UNDEFINED,
+        ET_REPLY,
+        ET_NOTIFY,
+        ET_WRITE,           // write blocked by a full transmit queue
+        ET_NOTIFY_OUTPUT    // output notification armed on a full transmit queue
+    } type_;
+
+    int rcvId_;
+    RESMGR_OCB_T *ocb_;
+
+    // Size of the blocked write
+    std::uint32_t nbytes_;
+
+    DelayElement(EType type, int rcvId, RESMGR_OCB_T *ocb, std::uint32_t nbytes = 0)
+     : type_(type)
+     , rcvId_(rcvId)
+     , ocb_(ocb)
+     , nbytes_(nbytes)
+     {}
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <canrm.h>
+
+#include "non_copyable.h"
+
+//------------------------------------------------------------------------------------------------
+// Counters of one channel. Each group is written by one path and owns its cache lines, so the
+// interrupt, the controller thread and the writers do not share lines. Increments and samples
+// are relaxed atomics, Sample() takes no lock and may be called from any thread.
+//------------------------------------------------------------------------------------------------
+
+class ChannelStats : NonCopyable
+{
+public:
+
+    typedef std::atomic<std::uint64_t> Counter;
+
+    ChannelStats()
+     : interrupts_(0)
+     , rxFrames_(0)
+     , rxBytes_(0)
+     , txFrames_(0)
+     , txBytes_(0)
+     , hardwareOverruns_(0)
+     , ringDrops_(0)
+     , busErrors_(0)
+     , bitErrors_(0)
+     , formErrors_(0)
+     , stuffErrors_(0)
+     , otherErrors_(0)
+     , errorWarnings_(0)
+     , errorPassives_(0)
+     , arbitrationLosses_(0)
+     , pulses_(0)
+     , busOffs_(0)
+     , txQueueHighWater_(0)
+     , queueOverwrites_(0)
+    { }
+
+    static inline void Add(Counter& counter, std::uint64_t value = 1)
+    {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // The writers of the counter are serialized
+    static inline void Max(Counter& counter, std::uint64_t value)
+    {
+        if(value > counter.load(std::memory_order_relaxed))
+        {
+            counter.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    // Fills the channel counters, the ones of the open file are left alone
+    void Sample(CanStats& stats) const
+    {
+        stats.rxFrames_ = rxFrames_.load(std::memory_order_relaxed);
+        stats.rxBytes_ = rxBytes_.load(std::memory_order_relaxed);
+        stats.txFrames_ = txFrames_.load(std::memory_order_relaxed);
+        stats.txBytes_ = txBytes_.load(std::memory_order_relaxed);
+        stats.hardwareOverruns_ = hardwareOverruns_.load(std::memory_order_relaxed);
+        stats.ringDrops_ = ringDrops_.load(std::memory_order_relaxed);
+        stats.queueOverwrites_ = queueOverwrites_.load(std::memory_order_relaxed);
+        stats.busErrors_ = busErrors_.load(std::memory_order_relaxed);
+        stats.bitErrors_ = bitErrors_.load(std::memory_order_relaxed);
+        stats.formErrors_ = formErrors_.load(std::memory_order_relaxed);
+        stats.stuffErrors_ = stuffErrors_.load(std::memory_order_relaxed);
+        stats.otherErrors_ = otherErrors_.load(std::memory_order_relaxed);
+        stats.errorWarnings_ = errorWarnings_.load(std::memory_order_relaxed);
+        stats.errorPassives_ = errorPassives_.load(std::memory_order_relaxed);
+        stats.busOffs_ = busOffs_.load(std::memory_order_relaxed);
+        stats.arbitrationLosses_ = arbitrationLosses_.load(std::memory_order_relaxed);
+        stats.interrupts_ = interrupts_.load(std::memory_order_relaxed);
+        stats.pulses_ = pulses_.load(std::memory_order_relaxed);
+        stats.txQueueHighWater_ = txQueueHighWater_.load(std::memory_order_relaxed);
+    }
+
+    // Interrupt handling thread
+    alignas(64) Counter interrupts_;
+    Counter rxFrames_;
+    Counter rxBytes_;
+    Counter txFrames_;
+    Counter txBytes_;
+    Counter hardwareOverruns_;
+    Counter ringDrops_;
+    Counter busErrors_;
+    Counter bitErrors_;
+    Counter formErrors_;
+    Counter stuffErrors_;
+    Counter otherErrors_;
+    Counter errorWarnings_;
+    Counter errorPassives_;
+    Counter arbitrationLosses_;
+
+    // Controller thread and the consumer of the error events
+    alignas(64) Counter pulses_;
+    Counter busOffs_;
+
+    // Transmit path, under the controller transmit lock
+    alignas(64) Counter txQueueHighWater_;
+
+    // Publisher of the message queue, under the queue lock
+    alignas(64) Counter queueOverwrites_;
+};
+
+//------------------------------------------------------------------------------------------------
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #include "non_copyable.h"
@@ -19,4 +20,27 @@ public:
 
     virtual void PutWord(const tPort16* byteAddr, std::uint16_t value) const = 0;
     virtual std::uint16_t GetWord(const tPort16* byteAddr) const = 0;
+
+    // Consecutive 8 bit registers starting at byteAddr, the mapper applies
+    // its address stride. The default transfers byte by byte.
+    virtual void PutBlock(const tPort8* byteAddr, const std::uint8_t* data, std::size_t count) const
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            PutByte(byteAddr + i, data[i]);
+        }
+    }
+
+    virtual void GetBlock(const tPort8* byteAddr, std::uint8_t* data, std::size_t count) const
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            data[i] = GetByte(byteAddr + i);
+        }
+    }
+
+    // Mapped chip memory for direct register access, nullptr if the
+    // registers are reachable through this interface only
+    virtual volatile std::uint8_t* DirectBase() const { return nullptr; }
+    virtual std::uint8_t Shift() const { return 0; }
 };
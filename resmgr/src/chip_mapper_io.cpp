@@ -65,3 +65,28 @@ std::uint16_t ChipMapperIO::GetWord(const tPort16* byteAddr) const
 
 //------------------------------------------------------------------------------------------------
 
+
+void ChipMapperIO::PutBlock(const tPort8* byteAddr, const std::uint8_t* data, std::size_t count) const
+{
+    // consecutive ports, out8s would write a single port repeatedly
+    const uintptr_t port = baseAddr_ + (size_t)byteAddr;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        out8(port + i, data[i]);
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+void ChipMapperIO::GetBlock(const tPort8* byteAddr, std::uint8_t* data, std::size_t count) const
+{
+    const uintptr_t port = baseAddr_ + (size_t)byteAddr;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        data[i] = in8(port + i);
+    }
+}
+
+//------------------------------------------------------------------------------------------------
@@ -17,6 +17,9 @@ public:
     virtual void PutWord(const tPort16* byteAddr, std::uint16_t value) const;   
     virtual std::uint16_t GetWord(const tPort16* byteAddr) const;
 
+    virtual void PutBlock(const tPort8* byteAddr, const std::uint8_t* data, std::size_t count) const;
+    virtual void GetBlock(const tPort8* byteAddr, std::uint8_t* data, std::size_t count) const;
+
 private:
 
     volatile uintptr_t baseAddr_;
@@ -87,3 +87,32 @@ std::uint16_t ChipMapperMemory::GetWord(const tPort16* byteAddr) const
 }
 
 //------------------------------------------------------------------------------------------------
+
+void ChipMapperMemory::PutBlock(const tPort8* byteAddr, const std::uint8_t* data, std::size_t count) const
+{
+    // the registers are 1 << shift_ bytes apart
+    const std::size_t stride = std::size_t(1) << shift_;
+
+    tPort8* ptReg = (tPort8*)(baseAddr_ + ((std::uint64_t)byteAddr << shift_));
+
+    for (std::size_t i = 0; i < count; ++i, ptReg += stride)
+    {
+        *ptReg = data[i];
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+void ChipMapperMemory::GetBlock(const tPort8* byteAddr, std::uint8_t* data, std::size_t count) const
+{
+    const std::size_t stride = std::size_t(1) << shift_;
+
+    const tPort8* ptReg = (tPort8*)(baseAddr_ + ((std::uint64_t)byteAddr << shift_));
+
+    for (std::size_t i = 0; i < count; ++i, ptReg += stride)
+    {
+        data[i] = *ptReg;
+    }
+}
+
+//------------------------------------------------------------------------------------------------
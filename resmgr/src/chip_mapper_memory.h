@@ -17,6 +17,12 @@ public:
     virtual void PutWord(const tPort16* byteAddr, std::uint16_t value) const;   
     virtual std::uint16_t GetWord(const tPort16* byteAddr) const;
 
+    virtual void PutBlock(const tPort8* byteAddr, const std::uint8_t* data, std::size_t count) const;
+    virtual void GetBlock(const tPort8* byteAddr, std::uint8_t* data, std::size_t count) const;
+
+    virtual volatile std::uint8_t* DirectBase() const { return baseAddr_; }
+    virtual std::uint8_t Shift() const { return shift_; }
+
 private:
 
     volatile std::uint8_t* baseAddr_;
@@ -4,6 +4,7 @@
 #include <iostream>
 
 #include <sys/mman.h>
+#include <algorithm>
 #include <chrono>
 
 #include "can_controller.h"
@@ -15,28 +16,107 @@
 
 //------------------------------------------------------------------------------
 
-std::shared_ptr<CanController>ControllerFactory::CreateController(const unsigned bitRate)
+constexpr std::uint16_t ControllerFactory::PCAN_ICR_MASK[];
+
+namespace
+{
+
+// PCI server access of the probe
+class QnxPciEnumerator : public PciEnumerator
+{
+public:
+
+    virtual bool Find(unsigned index, std::uint16_t vendorId, std::uint16_t deviceId, std::uint32_t& bdf)
+    {
+        bdf = pci_device_find(index, vendorId, deviceId, PCI_CCODE_ANY);
+
+        return bdf != PCI_BDF_NONE;
+    }
+
+    virtual bool ReadSubsystemId(std::uint32_t bdf, std::uint16_t& ssid)
+    {
+        pci_ssid_t pciSsid = 0;
+
+        const pci_err_t err = pci_device_read_ssid(bdf, &pciSsid);
+
+        if (err != PCI_ERR_OK)
+        {
+            LOG(error) << "Can't read subsystem id, one channel is used. err code: " << pci_strerror(err);
+            return false;
+        }
+
+        ssid = pciSsid;
+
+        return true;
+    }
+};
+
+}
+
+//------------------------------------------------------------------------------
+
+std::vector<std::shared_ptr<CanController>> ControllerFactory::CreateControllers(const unsigned bitRate,
+                                                                                 const EInterruptMode interruptMode,
+                                                                                 const EReceiveDrain receiveDrain)
 {
     // Enable I/O privileges
     ThreadCtl(_NTO_TCTL_IO, 0);
 
-	if (PCIAttachDevice(VENDOR_PEAK_CAN, DEVICE_MINI_PCEe) == false)
-	{
-		throw std::runtime_error("Could not attach PCI device");
-	}
+    QnxPciEnumerator enumerator;
+    PcanProbe probe(enumerator);
 
-	if (PCIGetPCANPorts() == false)
-	{
-		throw std::runtime_error("Incorrect PCI PCAN device ports config");
-	}
+    // every PEAK card of the system, by model and PCI enumeration order
+    const std::vector<PcanDevice> devices = probe.FindDevices();
 
-	PCIInitPCAN();
+    for (const auto model: probe.UnsupportedModels())
+    {
+        LOG(error) << model->name_ << " clock " << std::dec << model->clockHz_ << " Hz is not supported";
+    }
 
-	auto chipMapper = std::make_unique<ChipMapperMemory>(chipAddr_, chipSize_, PCAN_SHIFT);
-    
-    LOG(info) << " Base address: " << std:: hex << chipAddr_ << std::dec
-              << " Irq: " << irq_
-			  << " Bitrate: " << bitRate << " kbit/s";
+    for (const auto& device: devices)
+    {
+        LOG(info) << "Found " << device.model_->name_ << " bdf: " << std::hex << device.bdf_;
+
+        cards_.emplace_back();
+
+        Card& card = cards_.back();
+
+        card.device_ = device;
+
+        if (PCIAttachDevice(card) == false)
+        {
+            throw std::runtime_error("Could not attach PCI device");
+        }
+
+        if (PCIGetPCANPorts(card) == false)
+        {
+            throw std::runtime_error("Incorrect PCI PCAN device ports config");
+        }
+
+        card.channelCount_ = PcanProbe::ChannelCount(device, card.chipSize_);
+
+        LOG(info) << "Subsystem id: " << std::hex << device.ssid_ << std::dec << " channels: " << card.channelCount_;
+
+        for (unsigned channel = 0; channel < card.channelCount_; ++channel)
+        {
+            card.icrMask_ |= PCAN_ICR_MASK[channel];
+        }
+
+        PCIInitPCAN(card);
+
+        LOG(info) << device.model_->name_ << " " << device.index_
+                  << " Base address: " << std:: hex << card.chipAddr_ << std::dec
+                  << " Irq: " << card.irq_
+                  << " Channels: " << card.channelCount_
+                  << " Bitrate: " << bitRate << " kbit/s";
+    }
+
+    if (cards_.empty())
+    {
+        LOG(error) << "Can't find CAN controller, VendorID: " << std::hex << PcanProbe::VENDOR_PEAK_CAN;
+
+        throw std::runtime_error("Could not attach PCI device");
+    }
 
     ECanBaudRate eCanBaudRate = ECBR_NONE;
         
@@ -83,14 +163,44 @@ std::shared_ptr<CanController>ControllerFactory::CreateController(const unsigned
     }
 
 
-    interruptID_ = InterruptAttachEvent(irq_, &interruptSignal_,
-                                          _NTO_INTR_FLAGS_PROCESS | _NTO_INTR_FLAGS_TRK_MSK);
+    std::vector<std::shared_ptr<CanController>> controllers;
+
+    for (auto& card: cards_)
+    {
+        // each chip has its own register window in the chip BAR
+        for (unsigned channel = 0; channel < card.channelCount_; ++channel)
+        {
+            const PcanModel& model = *card.device_.model_;
+
+            auto chipMapper = std::make_unique<ChipMapperMemory>(card.chipAddr_ + channel * model.channelSize_,
+                                                                 model.channelSize_, model.shift_);
+
+            auto controller = std::make_shared<SJA1000CanController>(std::move(chipMapper), eCanBaudRate);
+
+            controller->SetInterruptMode(interruptMode);
+            controller->SetReceiveDrain(receiveDrain);
+
+            card.channels_.push_back(Channel{ controller, PCAN_ICR_MASK[channel] });
+            controllers.push_back(controller);
+        }
+    }
+
+    // the channels are complete before the first interrupt is serviced,
+    // the pulse value tells the interrupt thread which card raised it
+    for (std::size_t index = 0; index < cards_.size(); ++index)
+    {
+        Card& card = cards_[index];
+
+        SIGEV_PULSE_INIT(&card.interruptSignal_, interruptChannel_.coid,
+                         SIGEV_PULSE_PRIO_INHERIT, INTERRUPT_PULSE, index);
+
+        card.interruptID_ = InterruptAttachEvent(card.irq_, &card.interruptSignal_,
+                                                 _NTO_INTR_FLAGS_PROCESS | _NTO_INTR_FLAGS_TRK_MSK);
+    }
 
     interruptHandleTh_ = std::thread(&ControllerFactory::InterruptHandleTh, this);
 
-	canController_ = std::make_shared<SJA1000CanController>(std::move(chipMapper), eCanBaudRate);
-        
-    return canController_;
+    return controllers;
 }
 
 //------------------------------------------------------------------------------
@@ -120,7 +230,11 @@ void ControllerFactory::InterruptHandleTh()
 
         if(nGetPulseRes)
         {
-            InterruptServiceRoutine();
+            // no pulse for a while, poll all cards
+            for (auto& card: cards_)
+            {
+                InterruptServiceRoutine(card);
+            }
             continue;
         }
 
@@ -131,10 +245,16 @@ void ControllerFactory::InterruptHandleTh()
                 return;
 
             case INTERRUPT_PULSE:
-                InterruptServiceRoutine();
+            {
+                Card& card = cards_[incomePulse.value.sival_int];
+
+                InterruptServiceRoutine(card);
+
+                InterruptUnmask(card.irq_, card.interruptID_);
+                break;
+            }
 
             default:
-                InterruptUnmask(irq_, interruptID_);
                 break;
         }
 
@@ -144,44 +264,35 @@ void ControllerFactory::InterruptHandleTh()
 
 //------------------------------------------------------------------------------
 
-void ControllerFactory::InterruptServiceRoutine()
+void ControllerFactory::InterruptServiceRoutine(Card& card)
 {
-    if (configAddr_ != 0)
+    if (card.configAddr_ != 0)
     {
-        std::uint16_t interruptMask = *(std::uint16_t*)(configAddr_ + PCAN_ICR);
+        // the channels share the interrupt, one ICR read serves all pending chips
+        std::uint16_t interruptMask = *(std::uint16_t*)(card.configAddr_ + PCAN_ICR) & card.icrMask_;
 
-        while ((interruptMask & PCAN_ICR_MASK) != 0)
+        while (interruptMask != 0)
         {
-            *(std::uint16_t*)(configAddr_ + PCAN_ICR) = PCAN_ICR_MASK;
+            *(std::uint16_t*)(card.configAddr_ + PCAN_ICR) = interruptMask;
 
-            canController_->InterruptServiceRoutine();
+            for (const auto& channel: card.channels_)
+            {
+                if ((interruptMask & channel.icrMask_) != 0)
+                {
+                    channel.controller_->InterruptServiceRoutine();
+                }
+            }
 
-            interruptMask = *(std::uint16_t*)(configAddr_ + PCAN_ICR);
+            interruptMask = *(std::uint16_t*)(card.configAddr_ + PCAN_ICR) & card.icrMask_;
         }
     }
 }
 
 //------------------------------------------------------------------------------
 
-void ControllerFactory::DeleteController()
+void ControllerFactory::DeleteControllers()
 {
-    if (configAddr_ != 0)
-    {
-        PCIFreePCAN();
-
-        munmap_device_memory((void*)configAddr_, configSize_);
-
-        configAddr_ = 0;
-    }
-    
-    PCIDetachDevice();
-
-    chipAddr_ = 0;
-    configSize_ = 0;
-    chipSize_ = 0;
-
-    canController_.reset();
-
+    // the interrupt thread touches the cards until it is stopped
 	MsgSendPulse(interruptChannel_.coid, SIGEV_PULSE_PRIO_INHERIT, TERMINATE_PULSE, 0);
 
 	if(interruptHandleTh_.joinable())
@@ -189,84 +300,92 @@ void ControllerFactory::DeleteController()
 		interruptHandleTh_.join();
 	}
 
+    for (auto& card: cards_)
+    {
+        if (card.configAddr_ != 0)
+        {
+            PCIFreePCAN(card);
+
+            munmap_device_memory((void*)card.configAddr_, card.configSize_);
+
+            card.configAddr_ = 0;
+        }
+
+        if (card.interruptID_ != -1)
+        {
+            InterruptDetach(card.interruptID_);
+        }
+
+        PCIDetachDevice(card);
+    }
+
+    cards_.clear();
+
     LOG(info) << "Done";
 }
 
 //------------------------------------------------------------------------------
 
-bool ControllerFactory::PCIAttachDevice(const pci_vid_t nVendorID, const pci_did_t nDeviceID)
+bool ControllerFactory::PCIAttachDevice(Card& card)
 {
-    LOG(info) << "PCI VendorID: " << std::hex << nVendorID
-              << " DeviceID: " << nDeviceID;
-
     bool result = true;
 
-    bdf_ = pci_device_find(0, nVendorID, nDeviceID, PCI_CCODE_ANY);
+    LOG(info) << "Attach CAN pci device bdf: " << std::hex << card.device_.bdf_;
+
+    pci_err_t err;
 
-    if(bdf_ == PCI_BDF_NONE)
+    card.pci_dev_hdl_ = pci_device_attach(card.device_.bdf_, pci_attachFlags_EXCLUSIVE_OWNER, &err);
+
+    if(card.pci_dev_hdl_ == 0)
     {
-        LOG(error) << "Can't find CAN controller";
+        LOG(error) << "Can't attach CAN controller err code: " << pci_strerror(err);
         result = false;
     }
     else
     {
-        LOG(info) << "Found CAN pci device bdf: " << std::hex << bdf_;
-
-        pci_err_t err;
+        int_t msiCapId = pci_device_find_capid(card.device_.bdf_, 0x05);
 
-        pci_dev_hdl_ = pci_device_attach(bdf_, pci_attachFlags_EXCLUSIVE_OWNER, &err);
-
-        if(pci_dev_hdl_ == 0)
+        if(msiCapId != -1)
         {
-            LOG(error) << "Can't attach CAN controller err code: " << pci_strerror(err);
-            result = false;
-        }
-        else
-        {
-            int_t msiCapId = pci_device_find_capid(bdf_, 0x05);
+            pci_cap_t msiCap = nullptr;
+            pci_err_t err;
+            err = pci_device_read_cap(card.device_.bdf_, &msiCap, msiCapId);
 
-            if(msiCapId != -1)
+            if(err != PCI_ERR_OK)
             {
-                pci_cap_t msiCap = nullptr;
-                pci_err_t err;
-                err = pci_device_read_cap(bdf_, &msiCap, msiCapId);
-
-                if(err != PCI_ERR_OK)
-                {
-                    LOG(error) << "Can't read device capability err code: " << pci_strerror(err);
-                    result = false;
-                }
-                else
-                {
-                    uint_t irq_num = cap_msi_get_nirq(msiCap);
-
-                    LOG(info) << "available " << irq_num << " interrupt(s)";
-
-                    if(irq_num > 0)
-                    {
-                        err = cap_msi_set_nirq(pci_dev_hdl_, msiCap, 1);
+                LOG(error) << "Can't read device capability err code: " << pci_strerror(err);
+                result = false;
+            }
+            else
+            {
+                uint_t irq_num = cap_msi_get_nirq(msiCap);
 
-                        if(err != PCI_ERR_OK)
-                        {
-                            LOG(error) << "Can't reserv irq. err code: " << pci_strerror(err);
-                            result = false;
-                        }
-                    }
+                LOG(info) << "available " << irq_num << " interrupt(s)";
 
-                    err = pci_device_cfg_cap_enable(pci_dev_hdl_, pci_reqType_e_MANDATORY, msiCap);
+                if(irq_num > 0)
+                {
+                    err = cap_msi_set_nirq(card.pci_dev_hdl_, msiCap, 1);
 
                     if(err != PCI_ERR_OK)
                     {
-                        LOG(error) << "Can't enable msi irq. err code: " << pci_strerror(err);
+                        LOG(error) << "Can't reserv irq. err code: " << pci_strerror(err);
                         result = false;
                     }
                 }
 
-                if(msiCap)
+                err = pci_device_cfg_cap_enable(card.pci_dev_hdl_, pci_reqType_e_MANDATORY, msiCap);
+
+                if(err != PCI_ERR_OK)
                 {
-                    free(msiCap);
+                    LOG(error) << "Can't enable msi irq. err code: " << pci_strerror(err);
+                    result = false;
                 }
             }
+
+            if(msiCap)
+            {
+                free(msiCap);
+            }
         }
     }
 
@@ -277,13 +396,13 @@ bool ControllerFactory::PCIAttachDevice(const pci_vid_t nVendorID, const pci_did
 
 //------------------------------------------------------------------------------
 
-void ControllerFactory::PCIDetachDevice()
+void ControllerFactory::PCIDetachDevice(Card& card)
 {
-    if (pci_dev_hdl_ != 0)
+    if (card.pci_dev_hdl_ != 0)
     {
-        pci_device_detach(pci_dev_hdl_);
+        pci_device_detach(card.pci_dev_hdl_);
 
-        pci_dev_hdl_ = 0;
+        card.pci_dev_hdl_ = 0;
 
         LOG(info) << "Device was detached";
     }
@@ -291,68 +410,77 @@ void ControllerFactory::PCIDetachDevice()
 
 //------------------------------------------------------------------------------
 
-bool ControllerFactory::PCIGetPCANPorts()
+bool ControllerFactory::PCIGetPCANPorts(Card& card)
 {
     bool result = true;
 
-    pci_ba_t pciBa[2];
+    pci_ba_t pciBa[6];
     int_t baNum = NELEMENTS(pciBa);
     pci_irq_t pciIrq;
     pci_err_t err;
 
-    err = pci_device_read_ba(pci_dev_hdl_, &baNum, pciBa, pci_reqType_e_UNSPECIFIED);
+    err = pci_device_read_ba(card.pci_dev_hdl_, &baNum, pciBa, pci_reqType_e_UNSPECIFIED);
 
     if(err != PCI_ERR_OK )
     {
         LOG(error) << "Can't read base addr. err code: " << pci_strerror(err);
+        return false;
+    }
+
+    // the BARs of the model layout
+    std::vector<PcanBar> bars;
+
+    for(int_t i = 0; i < baNum; ++i)
+    {
+        bars.push_back(PcanBar{ std::uint8_t(pciBa[i].bar_num), pciBa[i].addr, pciBa[i].size,
+                                pciBa[i].type == pci_asType_e_MEM });
+    }
+
+    const PcanModel& model = *card.device_.model_;
+
+    PcanBar configBa;
+    PcanBar chipBa;
+
+    if(!PcanProbe::SelectBars(model, bars, configBa, chipBa))
+    {
+        LOG(error) << "BAR" << int(model.configBar_) << " or memory BAR" << int(model.chipBar_)
+                   << " of " << model.name_ << " is missing";
+        return false;
+    }
+
+    err = pci_device_read_irq(card.pci_dev_hdl_, nullptr, &pciIrq);
+    if(err != PCI_ERR_OK)
+    {
+        LOG(error) << "Can't get irq num. err code: " << pci_strerror(err);
         result = false;
     }
     else
     {
-        err = pci_device_read_irq(pci_dev_hdl_, nullptr, &pciIrq);
-        if(err != PCI_ERR_OK)
+        card.irq_ = pciIrq;
+        LOG(info) << "CtrlBaseAddress: " << std::hex << configBa.address_
+                  << " BaseAddressSize: " << configBa.size_;
+
+        card.configSize_ = configBa.size_;
+
+        card.configAddr_ = (std::uint8_t*)mmap_device_memory(
+                0,
+                card.configSize_,
+                PROT_READ | PROT_WRITE | PROT_NOCACHE,
+                0,
+                configBa.address_);
+
+        if (card.configAddr_ == MAP_FAILED)
         {
-            LOG(error) << "Can't get irq num. err code: " << pci_strerror(err);
+            LOG(error) << "Can't map device";
+            card.configAddr_ = 0;
             result = false;
         }
-        else
-        {
-            irq_ = pciIrq;
-            LOG(info) << "CtrlBaseAddress: " << std::hex << pciBa[0].addr
-                      << " BaseAddressSize: " << pciBa[0].size
-                      << " type: " << pciBa[0].type
-                      << " attr: " << pciBa[0].attr ;
-
-            configSize_ = pciBa[0].size;
-
-            configAddr_ = (std::uint8_t*)mmap_device_memory(
-                    0,
-                    configSize_,
-                    PROT_READ | PROT_WRITE | PROT_NOCACHE,
-                    0,
-                    pciBa[0].addr);
-
-            if (configAddr_ == MAP_FAILED)
-            {
-                LOG(error) << "Can't map device";
-                result = false;
-            }
 
-            LOG(info) << "ChipBaseAddress: " << std::hex << pciBa[1].addr
-                      << " BaseAddressSize: " << pciBa[1].size
-                      << " type: " << pciBa[1].type
-                      << " attr: " << pciBa[1].attr ;
+        LOG(info) << "ChipBaseAddress: " << std::hex << chipBa.address_
+                  << " BaseAddressSize: " << chipBa.size_;
 
-            if(pciBa[1].type != pci_asType_e_MEM)
-            {
-                LOG(error) << "device can't be attached as a memmory";
-            }
-            else
-            {
-                chipSize_ = pciBa[1].size;
-                chipAddr_ = pciBa[1].addr;
-            }
-        }
+        card.chipSize_ = chipBa.size_;
+        card.chipAddr_ = chipBa.address_;
     }
 
     LOG(info) << "Done: " << result;
@@ -363,11 +491,11 @@ bool ControllerFactory::PCIGetPCANPorts()
 
 //------------------------------------------------------------------------------
 
-void ControllerFactory::PCIInitPCAN()
+void ControllerFactory::PCIInitPCAN(Card& card)
 {
     pci_err_t err;
 
-    err = pci_device_write_cmd(pci_dev_hdl_, 0x0002, nullptr);
+    err = pci_device_write_cmd(card.pci_dev_hdl_, 0x0002, nullptr);
 
     if(err != PCI_ERR_OK )
     {
@@ -375,7 +503,7 @@ void ControllerFactory::PCIInitPCAN()
         throw std::runtime_error("Can't configure PCAN PCI device");
     }
 
-    err = pci_device_cfg_wr16(pci_dev_hdl_, 0x44, 0, nullptr);
+    err = pci_device_cfg_wr16(card.pci_dev_hdl_, 0x44, 0, nullptr);
 
 
     if(err != PCI_ERR_OK )
@@ -385,42 +513,45 @@ void ControllerFactory::PCIInitPCAN()
     }
 
     // Set GPIO control register 
-    *(std::uint16_t*)(configAddr_ + PCAN_GPIOICR + 2) = 0x0005;
+    *(std::uint16_t*)(card.configAddr_ + PCAN_GPIOICR + 2) = 0x0005;
 
     // Enable all channels
-    *(configAddr_ + PCAN_GPIOICR) = 0x00;
+    *(card.configAddr_ + PCAN_GPIOICR) = 0x00;
 
     // Toggle reset
-    *(configAddr_ + PCAN_MISC + 3) = 0x05;
+    *(card.configAddr_ + PCAN_MISC + 3) = 0x05;
 
     std::this_thread::sleep_for(std::chrono::milliseconds(5));
 
     // Leave parport mux mode
-    *(configAddr_ + PCAN_MISC + 3) = 0x04;
+    *(card.configAddr_ + PCAN_MISC + 3) = 0x04;
 
     // Enable PCAN interrupts
-    const std::uint16_t nInterruptMask = *(std::uint16_t*)(configAddr_ + PCAN_ICR + 2);
+    const std::uint16_t nInterruptMask = *(std::uint16_t*)(card.configAddr_ + PCAN_ICR + 2);
 
-    *(std::uint16_t*)(configAddr_ + PCAN_ICR + 2) = (nInterruptMask | PCAN_ICR_MASK);
+    *(std::uint16_t*)(card.configAddr_ + PCAN_ICR + 2) = (nInterruptMask | card.icrMask_);
 }
 
 //------------------------------------------------------------------------------
 
-void ControllerFactory::PCIFreePCAN()
+void ControllerFactory::PCIFreePCAN(Card& card)
 {
     // Disable PCAN interrupt
-    const std::uint16_t nInterruptMask = *(std::uint16_t*)(configAddr_ + PCAN_ICR + 2);
+    const std::uint16_t nInterruptMask = *(std::uint16_t*)(card.configAddr_ + PCAN_ICR + 2);
 
-    *(std::uint16_t*)(configAddr_ + PCAN_ICR + 2) = (nInterruptMask & ~PCAN_ICR_MASK);
+    *(std::uint16_t*)(card.configAddr_ + PCAN_ICR + 2) = (nInterruptMask & ~card.icrMask_);
 }
 
 //------------------------------------------------------------------------------
 
 void ControllerFactory::FinializeInterrupt()
 {
-    if (configAddr_ != 0)
+    for (const auto& card: cards_)
     {
-        *(std::uint16_t*)(configAddr_ + PCAN_ICR) = PCAN_ICR_MASK;
+        if (card.configAddr_ != 0)
+        {
+            *(std::uint16_t*)(card.configAddr_ + PCAN_ICR) = card.icrMask_;
+        }
     }
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include "non_copyable.h"
 
 extern "C"
@@ -14,6 +15,7 @@ extern "C"
 #include "unit_cthread.h"
 
 #include "can_controller.h"
+#include "pcan_probe.h"
 
 //------------------------------------------------------------------------------
 
@@ -34,40 +36,59 @@ public:
         return instance_;
     }
 
-    std::shared_ptr<CanController> CreateController(const unsigned bitRate);
-    void DeleteController(void);
+    // One controller per SJA1000 channel of every card, in card and channel order
+    std::vector<std::shared_ptr<CanController>> CreateControllers(const unsigned bitRate,
+                                                                  const EInterruptMode interruptMode = EIM_PULSE_CHAIN,
+                                                                  const EReceiveDrain receiveDrain = ERD_MESSAGE_COUNT);
+    void DeleteControllers(void);
 
     void FinializeInterrupt(void);
 
     ControllerFactory()
         : interruptChannel_(_NTO_CHF_FIXED_PRIORITY)
-        , interruptID_(-1)
-        , bdf_(0)
-        , configAddr_(0)
-        , configSize_(0)
-        , chipAddr_(0)
-        , chipSize_(0)
-        , pci_dev_hdl_(0)
-        , irq_(-1)
     {
-        SIGEV_PULSE_INIT(&interruptSignal_, interruptChannel_.coid,
-                SIGEV_PULSE_PRIO_INHERIT, INTERRUPT_PULSE, 0);
     }
 
 private:
 
-    bool PCIAttachDevice(const pci_vid_t nVendorID, const pci_did_t nDeviceID);
-    void PCIDetachDevice(void);
+    struct Channel
+    {
+        std::shared_ptr<CanController> controller_;
+        std::uint16_t icrMask_;
+    };
+
+    // One attached PCAN card with its own interrupt
+    struct Card
+    {
+        PcanDevice device_ = {};
+
+        volatile std::uint8_t* configAddr_ = 0;
+        std::uint64_t configSize_ = 0;
+
+        std::uint64_t chipAddr_ = 0;
+        std::uint64_t chipSize_ = 0;
+
+        pci_devhdl_t pci_dev_hdl_ = 0;
+
+        pci_irq_t irq_ = -1;
+
+        sigevent interruptSignal_;
+        int interruptID_ = -1;
+
+        // Number of SJA1000 chips and their ICR bits
+        unsigned channelCount_ = 0;
+        std::uint16_t icrMask_ = 0;
 
-    bool PCIGetPCANPorts(void);
+        std::vector<Channel> channels_;
+    };
+
+    bool PCIAttachDevice(Card& card);
+    void PCIDetachDevice(Card& card);
 
-    void PCIInitPCAN(void);
-    void PCIFreePCAN(void);
+    bool PCIGetPCANPorts(Card& card);
 
-    // Only Peak PCAN-miniPCIe SJA1000 PCI controller is supported
-    static const pci_vid_t VENDOR_PEAK_CAN  = 0x001C;
-//    static const std::uint16_t DEVICE_PCI       = 0x0001;
-    static const pci_did_t DEVICE_MINI_PCEe = 0x0008;
+    void PCIInitPCAN(Card& card);
+    void PCIFreePCAN(Card& card);
 
     // Interrupt control register
     static const std::uint8_t PCAN_ICR = 0x00;
@@ -78,38 +99,21 @@ private:
     // Miscellaneous register
     static const std::uint8_t PCAN_MISC = 0x1C;
     
-    // Interrupt mask (channel 0)
-    static const std::uint16_t PCAN_ICR_MASK = 0x0002;
-
-    // Mapping address shift 
-    const std::uint8_t PCAN_SHIFT = 2;
+    // Interrupt masks of the channels
+    static constexpr std::uint16_t PCAN_ICR_MASK[PcanProbe::MAX_CHANNELS] = { 0x0002, 0x0001, 0x0040, 0x0080 };
 
 //////
 
+    // One thread and one pulse channel serve the interrupts of all cards
     void InterruptHandleTh();
     std::thread interruptHandleTh_;
 
-    void InterruptServiceRoutine();
+    void InterruptServiceRoutine(Card& card);
 
-    sigevent interruptSignal_;
     CChannel interruptChannel_;
-    int interruptID_;
-
-    std::shared_ptr<CanController> canController_;
-
-//////
-
-    pci_bdf_t bdf_;
-
-    volatile std::uint8_t* configAddr_;
-    std::uint64_t configSize_;
-
-    std::uint64_t chipAddr_;
-    std::uint64_t chipSize_;
-
-    pci_devhdl_t pci_dev_hdl_;
 
-    pci_irq_t irq_;
+    // Not resized once the interrupt thread runs
+    std::vector<Card> cards_;
 };
 
 //------------------------------------------------------------------------------
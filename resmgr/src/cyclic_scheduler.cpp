@@ -0,0 +1,402 @@
+#include "cyclic_scheduler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <limits>
+
+#include <pthread.h>
+
+#include "log.h"
+
+//------------------------------------------------------------------------------
+
+CyclicScheduler::CyclicScheduler()
+ : scheduled_(0)
+ , currentTick_(0)
+ , terminate_(false)
+{
+    schedulerThread_ = std::thread(&CyclicScheduler::SchedulerThread, this);
+}
+
+//------------------------------------------------------------------------------
+
+CyclicScheduler::~CyclicScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        terminate_ = true;
+    }
+
+    cond_.notify_one();
+
+    if(schedulerThread_.joinable())
+    {
+        schedulerThread_.join();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+std::uint64_t CyclicScheduler::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//------------------------------------------------------------------------------
+
+void CyclicScheduler::AddChannel(const void* channel, Transmit transmit)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    channels_[channel] = std::move(transmit);
+}
+
+//------------------------------------------------------------------------------
+
+void CyclicScheduler::RemoveChannel(const void* channel)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for(auto job = jobs_.begin(); job != jobs_.end(); )
+    {
+        if(channel == job->second->channel_)
+        {
+            Unschedule(job->second.get());
+
+            job = jobs_.erase(job);
+        }
+        else
+        {
+            ++job;
+        }
+    }
+
+    channels_.erase(channel);
+}
+
+//------------------------------------------------------------------------------
+
+int CyclicScheduler::SetJob(const void* channel, const void* owner, const CanCyclicJob& job)
+{
+    if((job.periodUs_ < CanCyclicJob::MIN_PERIOD_US) || (job.frame_.len > CAN_MAX_DLEN))
+    {
+        return EINVAL;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    const auto transmit = channels_.find(channel);
+
+    if(transmit == channels_.end())
+    {
+        return ENODEV;
+    }
+
+    const std::uint64_t now = Now();
+
+    // the wheel does not advance while it is empty
+    if(0 == scheduled_)
+    {
+        currentTick_ = now / TICK_NS;
+    }
+
+    std::unique_ptr<Job>& entry = jobs_[JobKey(owner, job.jobId_)];
+
+    bool restart = true;
+
+    if(!entry)
+    {
+        if(jobs_.size() > MAX_JOBS)
+        {
+            jobs_.erase(JobKey(owner, job.jobId_));
+
+            return ENOSPC;
+        }
+
+        entry.reset(new Job());
+
+        entry->channel_ = channel;
+        entry->transmit_ = &transmit->second;
+        entry->slot_ = SLOTS;
+        entry->stats_.jobId_ = job.jobId_;
+        entry->stats_.minPeriodErrorNs_ = std::numeric_limits<std::int64_t>::max();
+        entry->stats_.maxPeriodErrorNs_ = std::numeric_limits<std::int64_t>::min();
+    }
+    else
+    {
+        restart = (SLOTS == entry->slot_) || (entry->job_.periodUs_ != job.periodUs_);
+    }
+
+    Job* updated = entry.get();
+
+    updated->job_ = job;
+    updated->stats_.remaining_ = job.count_;
+
+    if(restart)
+    {
+        Unschedule(updated);
+
+        // deadlines on tick boundaries are served without rounding
+        updated->deadline_ = ((now + job.phaseUs_ * 1000ULL + TICK_NS - 1) / TICK_NS) * TICK_NS;
+        updated->lastLatenessValid_ = false;
+
+        Schedule(updated);
+    }
+
+    lock.unlock();
+
+    cond_.notify_one();
+
+    return EOK;
+}
+
+//------------------------------------------------------------------------------
+
+int CyclicScheduler::DeleteJob(const void* owner, std::uint32_t jobId)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto job = jobs_.find(JobKey(owner, jobId));
+
+    if(job == jobs_.end())
+    {
+        return ESRCH;
+    }
+
+    Unschedule(job->second.get());
+
+    jobs_.erase(job);
+
+    return EOK;
+}
+
+//------------------------------------------------------------------------------
+
+void CyclicScheduler::DeleteJobs(const void* owner)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto job = jobs_.lower_bound(JobKey(owner, 0));
+
+    while((job != jobs_.end()) && (owner == job->first.first))
+    {
+        Unschedule(job->second.get());
+
+        job = jobs_.erase(job);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+int CyclicScheduler::GetStats(const void* owner, std::uint32_t jobId, CanCyclicStats& stats)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto job = jobs_.find(JobKey(owner, jobId));
+
+    if(job == jobs_.end())
+    {
+        return ESRCH;
+    }
+
+    const Job& found = *job->second;
+
+    stats = found.stats_;
+
+    if(0 == found.intervals_)
+    {
+        stats.minPeriodErrorNs_ = 0;
+        stats.maxPeriodErrorNs_ = 0;
+        stats.meanAbsPeriodErrorNs_ = 0;
+    }
+    else
+    {
+        stats.meanAbsPeriodErrorNs_ = found.absErrorSum_ / found.intervals_;
+    }
+
+    return EOK;
+}
+
+//------------------------------------------------------------------------------
+
+void CyclicScheduler::Schedule(Job* job)
+{
+    // the current tick has been served
+    const std::uint64_t tick = std::max<std::uint64_t>((job->deadline_ + TICK_NS - 1) / TICK_NS, currentTick_ + 1);
+
+    job->slot_ = tick % SLOTS;
+    job->tick_ = tick;
+    wheel_[job->slot_].push_back(job);
+
+    ++scheduled_;
+}
+
+//------------------------------------------------------------------------------
+
+void CyclicScheduler::Unschedule(Job* job)
+{
+    if(SLOTS == job->slot_)
+    {
+        return;
+    }
+
+    std::vector<Job*>& slot = wheel_[job->slot_];
+
+    slot.erase(std::remove(slot.begin(), slot.end(), job), slot.end());
+
+    job->slot_ = SLOTS;
+
+    --scheduled_;
+}
+
+//------------------------------------------------------------------------------
+
+std::uint64_t CyclicScheduler::NextTick() const
+{
+    std::uint64_t next = std::numeric_limits<std::uint64_t>::max();
+
+    // the jobs of a slot are due at its tick or whole wheel turns later,
+    // so no later slot holds an earlier tick than the one found
+    for(std::uint64_t tick = currentTick_ + 1; (tick <= currentTick_ + SLOTS) && (next > tick); ++tick)
+    {
+        for(const Job* job: wheel_[tick % SLOTS])
+        {
+            next = std::min(next, job->tick_);
+        }
+    }
+
+    return next;
+}
+
+//------------------------------------------------------------------------------
+
+void CyclicScheduler::ServeSlot(std::uint32_t slot, std::uint64_t now)
+{
+    std::vector<Job*>& jobs = wheel_[slot];
+
+    std::size_t count = jobs.size();
+
+    // released jobs are scheduled again behind the ones of this slot
+    for(std::size_t i = 0; i < count; )
+    {
+        Job* job = jobs[i];
+
+        if(job->deadline_ > now)
+        {
+            ++i;
+            continue;
+        }
+
+        jobs.erase(jobs.begin() + i);
+        --count;
+
+        job->slot_ = SLOTS;
+        --scheduled_;
+
+        Release(job, now);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void CyclicScheduler::Release(Job* job, std::uint64_t now)
+{
+    CanCyclicStats& stats = job->stats_;
+
+    if((*job->transmit_)(job->job_.frame_))
+    {
+        ++stats.released_;
+    }
+    else
+    {
+        ++stats.refused_;
+    }
+
+    const std::uint64_t lateness = now - job->deadline_;
+
+    stats.maxLatenessNs_ = std::max(stats.maxLatenessNs_, lateness);
+
+    // interval between two releases minus the interval between their deadlines
+    if(job->lastLatenessValid_)
+    {
+        const std::int64_t error = std::int64_t(lateness) - std::int64_t(job->lastLateness_);
+
+        stats.minPeriodErrorNs_ = std::min(stats.minPeriodErrorNs_, error);
+        stats.maxPeriodErrorNs_ = std::max(stats.maxPeriodErrorNs_, error);
+
+        job->absErrorSum_ += (error < 0) ? -error : error;
+        ++job->intervals_;
+    }
+
+    job->lastLateness_ = lateness;
+    job->lastLatenessValid_ = true;
+
+    if((0 != job->job_.count_) && (0 == --stats.remaining_))
+    {
+        return;
+    }
+
+    const std::uint64_t period = job->job_.periodUs_ * 1000ULL;
+
+    job->deadline_ += period;
+
+    while(job->deadline_ <= now)
+    {
+        job->deadline_ += period;
+        ++stats.skipped_;
+    }
+
+    Schedule(job);
+}
+
+//------------------------------------------------------------------------------
+
+void CyclicScheduler::SchedulerThread()
+{
+    pthread_setschedprio(pthread_self(), 30);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while(!terminate_)
+    {
+        if(0 == scheduled_)
+        {
+            cond_.wait(lock);
+            continue;
+        }
+
+        // no wake up on the ticks without a job
+        const std::uint64_t nextTick = NextTick();
+
+        cond_.wait_until(lock, std::chrono::steady_clock::time_point(
+                               std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                               std::chrono::nanoseconds(nextTick * TICK_NS))));
+
+        const std::uint64_t now = Now();
+        const std::uint64_t nowTick = now / TICK_NS;
+
+        // woken by a job change
+        if(terminate_ || (nowTick < nextTick))
+        {
+            continue;
+        }
+
+        // serve the ticks passed since the last pass, one wheel turn at most;
+        // a job added while the thread slept may sit before nextTick
+        const std::uint64_t firstTick = (nowTick - currentTick_ > SLOTS) ? nowTick - SLOTS + 1 : currentTick_ + 1;
+
+        for(std::uint64_t tick = firstTick; tick <= nowTick; ++tick)
+        {
+            ServeSlot(tick % SLOTS, now);
+        }
+
+        currentTick_ = nowTick;
+    }
+
+    LOG(info) << "Cyclic scheduler stopped";
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <canrm.h>
+
+#include "non_copyable.h"
+
+//------------------------------------------------------------------------------
+// Cyclic transmissions of all channels (EDCMD_SET_CYCLIC_TX).
+//
+// One scheduler is shared by the channel managers of the driver instance, so
+// one thread releases the frames of all jobs into the transmit queues of their
+// controllers. A channel registers its transmit function, a job belongs to the
+// channel it was set on and to its owner.
+//
+// Jobs are kept in a hashed timing wheel of TICK_NS slots: a job sits in the
+// slot of its next deadline and is released when the wheel reaches that tick. The thread sleeps until the earliest tick with a job, not every
+// tick. Deadlines advance by the period from the scheduled time, not
+// from the release time, so a late release does not shift the following ones.
+//------------------------------------------------------------------------------
+
+class CyclicScheduler : NonCopyable
+{
+public:
+
+    // Puts the frame to the transmit queue, false if the queue refused it
+    typedef std::function<bool(const can_frame& canFrame)> Transmit;
+
+    CyclicScheduler();
+
+    ~CyclicScheduler();
+
+    void AddChannel(const void* channel, Transmit transmit);
+
+    // Delete the jobs of the channel, its transmit function is not called afterwards
+    void RemoveChannel(const void* channel);
+
+    // Add the job of the owner on the channel or update the one with the same identifier.
+    // An update with the same period keeps the timing, the new frame goes out
+    // with the next release. Returns EOK or an errno value
+    int SetJob(const void* channel, const void* owner, const CanCyclicJob& job);
+
+    // Returns EOK or ESRCH
+    int DeleteJob(const void* owner, std::uint32_t jobId);
+
+    void DeleteJobs(const void* owner);
+
+    // Returns EOK or ESRCH
+    int GetStats(const void* owner, std::uint32_t jobId, CanCyclicStats& stats);
+
+private:
+
+    static const std::uint64_t TICK_NS = 1000000ULL;
+    static const std::uint32_t SLOTS = 1024;
+    static const std::size_t MAX_JOBS = 4096;
+
+    struct Job
+    {
+        CanCyclicJob job_;
+
+        // Channel of the job and its transmit function
+        const void* channel_;
+        const Transmit* transmit_;
+
+        // Scheduled time of the next release, ns of the steady clock
+        std::uint64_t deadline_;
+
+        // Lateness of the previous release, invalid before the first one
+        std::uint64_t lastLateness_;
+        bool lastLatenessValid_;
+
+        // Slot in the wheel, SLOTS while the job is finished
+        std::uint32_t slot_;
+
+        // Tick the slot is served for the job
+        std::uint64_t tick_;
+
+        CanCyclicStats stats_;
+        std::uint64_t absErrorSum_;
+        std::uint64_t intervals_;
+    };
+
+    typedef std::pair<const void*, std::uint32_t> JobKey;
+
+    static std::uint64_t Now();
+
+    void Schedule(Job* job);
+    void Unschedule(Job* job);
+
+    // Earliest tick of the scheduled jobs, scanned forward from the current
+    // tick; mutex_ must be locked and a job scheduled
+    std::uint64_t NextTick() const;
+
+    // Release the due jobs of the slot, mutex_ must be locked
+    void ServeSlot(std::uint32_t slot, std::uint64_t now);
+
+    void Release(Job* job, std::uint64_t now);
+
+    void SchedulerThread();
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    std::map<const void*, Transmit> channels_;
+
+    std::map<JobKey, std::unique_ptr<Job>> jobs_;
+
+    std::vector<Job*> wheel_[SLOTS];
+
+    // Number of scheduled jobs
+    std::size_t scheduled_;
+
+    // Last tick the wheel has been served for
+    std::uint64_t currentTick_;
+
+    bool terminate_;
+
+    std::thread schedulerThread_;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,514 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <can.h>
+#include <canrm.h>
+
+#include "non_copyable.h"
+
+//------------------------------------------------------------------------------
+// Delayed data requests indexed by the CAN identifier they wait for.
+//
+// A received frame visits only the requests which may accept it:
+//  - exact identifier filters (full mask, narrow range) are kept in a hash,
+//  - mask filters covering the 11 low identifier bits are kept in 2048
+//    buckets with a bitmap of the non-empty ones,
+//  - wide ranges are kept in a list of ranges,
+//  - everything else (no filter, disabled filter, sparse masks) is always
+//    visited.
+// The index returns candidates only, the caller still checks the filter.
+// A few waiting requests are cheaper to scan than to look up: up to
+// LINEAR_SCAN_SLOTS slots the frame visits all of them and the index is built
+// only when the queue grows beyond, from the filters kept in the slots.
+// References of served requests are dropped when their bucket is visited and
+// by a sweep of the whole index after SWEEP_RELEASES served requests.
+// The queue does not look into the element, so it runs on the host as well.
+//------------------------------------------------------------------------------
+
+template <typename Element>
+class DelayedQueue : NonCopyable
+{
+public:
+
+    DelayedQueue()
+     : size_(0)
+     , released_(0)
+     , sffBuckets_(SFF_BUCKETS)
+    { }
+
+    // The filter selects the index of the element, without one it is visited for every frame
+    void Push(const Element& element, const CanMessageFilter* filter);
+
+    // Visit candidates for the frame identifier (can_id & CAN_EFF_MASK). The handler
+    // is called as bool(const Element&) and returns true if the element has been served.
+    // It is a template argument, a std::function would allocate for every frame.
+    template <typename Handler>
+    void ForEachCandidate(std::uint32_t arbitration, Handler handler);
+
+    // Visit all elements, the ones the handler returns true for are removed
+    template <typename Handler>
+    void Remove(Handler handler);
+
+    bool Empty() const { return 0 == size_; }
+
+private:
+
+    static const std::uint32_t SFF_BUCKETS = 2048;
+
+    // Ranges up to this width are indexed by every identifier
+    static const std::uint32_t MAX_EXPANDED_RANGE = 32;
+
+    // Up to this number of slots a frame scans them instead of the index
+    static const std::uint32_t LINEAR_SCAN_SLOTS = 4;
+
+    // Served requests between sweeps of stale references, on top of the waiting ones
+    static const std::uint32_t SWEEP_RELEASES = 64;
+
+    struct Slot
+    {
+        Element element_;
+        CanMessageFilter filter_;
+        bool filtered_;
+        std::uint32_t generation_;
+        bool used_;
+
+        explicit Slot(const Element& element)
+         : element_(element)
+         , filtered_(false)
+         , generation_(0)
+         , used_(false)
+        {}
+    };
+
+    struct Reference
+    {
+        std::uint32_t slot_;
+        std::uint32_t generation_;
+    };
+
+    struct Range
+    {
+        std::uint32_t lower_;
+        std::uint32_t upper_;
+        Reference reference_;
+    };
+
+    typedef std::vector<Reference> Bucket;
+
+    std::uint32_t Allocate(const Element& element, const CanMessageFilter* filter);
+    void Release(std::uint32_t slot);
+
+    inline bool Indexed() const { return slots_.size() > LINEAR_SCAN_SLOTS; }
+
+    // Add the used slot to the index of its filter
+    void Index(std::uint32_t slot);
+
+    inline bool IsValid(const Reference& reference) const
+    {
+        return slots_[reference.slot_].used_ && (slots_[reference.slot_].generation_ == reference.generation_);
+    }
+
+    // Visit the bucket, drop served and stale references
+    template <typename Handler>
+    void Visit(Bucket& bucket, Handler& handler);
+
+    template <typename Handler>
+    void VisitIndex(std::uint32_t arbitration, Handler& handler);
+
+    void Prune(Bucket& bucket);
+
+    // Drop the stale references of the whole index
+    void Sweep();
+
+    std::vector<Slot> slots_;
+    std::vector<std::uint32_t> freeSlots_;
+    std::uint32_t size_;
+    std::uint32_t released_;
+
+    std::unordered_map<std::uint32_t, Bucket> exactIds_;
+
+    std::bitset<SFF_BUCKETS> sffBitmap_;
+    std::vector<Bucket> sffBuckets_;
+
+    std::vector<Range> ranges_;
+
+    Bucket unindexed_;
+};
+
+//------------------------------------------------------------------------------
+
+template <typename Element>
+std::uint32_t DelayedQueue<Element>::Allocate(const Element& element, const CanMessageFilter* filter)
+{
+    std::uint32_t slot;
+
+    if(freeSlots_.empty())
+    {
+        slot = slots_.size();
+        slots_.emplace_back(element);
+    }
+    else
+    {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+
+        slots_[slot].element_ = element;
+    }
+
+    slots_[slot].filtered_ = (0 != filter);
+
+    if(0 != filter)
+    {
+        slots_[slot].filter_ = *filter;
+    }
+
+    slots_[slot].used_ = true;
+
+    ++size_;
+
+    return slot;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename Element>
+void DelayedQueue<Element>::Release(std::uint32_t slot)
+{
+    slots_[slot].used_ = false;
+    ++slots_[slot].generation_;
+
+    freeSlots_.push_back(slot);
+
+    --size_;
+    ++released_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename Element>
+void DelayedQueue<Element>::Prune(Bucket& bucket)
+{
+    std::size_t kept = 0;
+
+    for(std::size_t i = 0; i < bucket.size(); ++i)
+    {
+        if(IsValid(bucket[i]))
+        {
+            bucket[kept++] = bucket[i];
+        }
+    }
+
+    bucket.resize(kept);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename Element>
+void DelayedQueue<Element>::Sweep()
+{
+    for(auto exact = exactIds_.begin(); exact != exactIds_.end(); )
+    {
+        Prune(exact->second);
+
+        if(exact->second.empty())
+        {
+            exact = exactIds_.erase(exact);
+        }
+        else
+        {
+            ++exact;
+        }
+    }
+
+    for(std::uint32_t index = 0; index < SFF_BUCKETS; ++index)
+    {
+        if(sffBitmap_.test(index))
+        {
+            Prune(sffBuckets_[index]);
+
+            if(sffBuckets_[index].empty())
+            {
+                sffBitmap_.reset(index);
+            }
+        }
+    }
+
+    std::size_t kept = 0;
+
+    for(std::size_t i = 0; i < ranges_.size(); ++i)
+    {
+        if(IsValid(ranges_[i].reference_))
+        {
+            ranges_[kept++] = ranges_[i];
+        }
+    }
+
+    ranges_.resize(kept);
+
+    Prune(unindexed_);
+
+    released_ = 0;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename Element>
+void DelayedQueue<Element>::Push(const Element& element, const CanMessageFilter* filter)
+{
+    const bool indexed = Indexed();
+    const std::uint32_t slot = Allocate(element, filter);
+
+    if(indexed)
+    {
+        Index(slot);
+    }
+    else if(Indexed())
+    {
+        // grown beyond the linear scan
+        for(std::uint32_t used = 0; used < slots_.size(); ++used)
+        {
+            if(slots_[used].used_)
+            {
+                Index(used);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename Element>
+void DelayedQueue<Element>::Index(std::uint32_t slot)
+{
+    const Reference reference = { slot, slots_[slot].generation_ };
+    const CanMessageFilter* filter = slots_[slot].filtered_ ? &slots_[slot].filter_ : 0;
+
+    const CanMessageFilter::EType filterType = (0 != filter) ? filter->type_ : CanMessageFilter::ET_DISABLED;
+
+    switch(filterType)
+    {
+    case CanMessageFilter::ET_AMASK:
+    {
+        const std::uint32_t mask = filter->acceptanceMask_ & CAN_EFF_MASK;
+
+        if(CAN_EFF_MASK == mask)
+        {
+            Bucket& bucket = exactIds_[filter->acceptancePattern_ & CAN_EFF_MASK];
+            Prune(bucket);
+            bucket.push_back(reference);
+        }
+        else if(CAN_SFF_MASK == (mask & CAN_SFF_MASK))
+        {
+            const std::uint32_t index = filter->acceptancePattern_ & CAN_SFF_MASK;
+
+            Prune(sffBuckets_[index]);
+            sffBuckets_[index].push_back(reference);
+            sffBitmap_.set(index);
+        }
+        else
+        {
+            Prune(unindexed_);
+            unindexed_.push_back(reference);
+        }
+        break;
+    }
+
+    case CanMessageFilter::ET_RANGE:
+    {
+        // frame identifiers do not exceed CAN_EFF_MASK
+        const std::uint32_t lower = filter->lower_;
+        const std::uint32_t upper = (filter->upper_ < CAN_EFF_MASK) ? filter->upper_ : CAN_EFF_MASK;
+
+        if((lower <= upper) && ((upper - lower) < MAX_EXPANDED_RANGE))
+        {
+            for(std::uint32_t offset = 0; offset <= upper - lower; ++offset)
+            {
+                Bucket& bucket = exactIds_[lower + offset];
+                Prune(bucket);
+                bucket.push_back(reference);
+            }
+        }
+        else
+        {
+            ranges_.push_back(Range{ lower, upper, reference });
+        }
+        break;
+    }
+
+    default:
+
+        Prune(unindexed_);
+        unindexed_.push_back(reference);
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename Element>
+template <typename Handler>
+void DelayedQueue<Element>::Visit(Bucket& bucket, Handler& handler)
+{
+    std::size_t kept = 0;
+
+    for(std::size_t i = 0; i < bucket.size(); ++i)
+    {
+        const Reference reference = bucket[i];
+
+        if(!IsValid(reference))
+        {
+            continue;
+        }
+
+        if(handler(slots_[reference.slot_].element_))
+        {
+            Release(reference.slot_);
+            continue;
+        }
+
+        bucket[kept++] = reference;
+    }
+
+    bucket.resize(kept);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename Element>
+template <typename Handler>
+void DelayedQueue<Element>::ForEachCandidate(std::uint32_t arbitration, Handler handler)
+{
+    if(0 == size_)
+    {
+        return;
+    }
+
+    if(!Indexed())
+    {
+        for(std::uint32_t slot = 0; slot < slots_.size(); ++slot)
+        {
+            if(slots_[slot].used_ && handler(slots_[slot].element_))
+            {
+                Release(slot);
+            }
+        }
+    }
+    else
+    {
+        VisitIndex(arbitration, handler);
+
+        if(released_ >= SWEEP_RELEASES + size_)
+        {
+            Sweep();
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename Element>
+template <typename Handler>
+void DelayedQueue<Element>::VisitIndex(std::uint32_t arbitration, Handler& handler)
+{
+    if(!exactIds_.empty())
+    {
+        auto exact = exactIds_.find(arbitration);
+
+        if(exact != exactIds_.end())
+        {
+            Visit(exact->second, handler);
+
+            if(exact->second.empty())
+            {
+                exactIds_.erase(exact);
+            }
+        }
+    }
+
+    const std::uint32_t index = arbitration & CAN_SFF_MASK;
+
+    if(sffBitmap_.test(index))
+    {
+        Visit(sffBuckets_[index], handler);
+
+        if(sffBuckets_[index].empty())
+        {
+            sffBitmap_.reset(index);
+        }
+    }
+
+    std::size_t kept = 0;
+
+    for(std::size_t i = 0; i < ranges_.size(); ++i)
+    {
+        const Range range = ranges_[i];
+
+        if(!IsValid(range.reference_))
+        {
+            continue;
+        }
+
+        if((arbitration >= range.lower_) && (arbitration <= range.upper_) &&
+           handler(slots_[range.reference_.slot_].element_))
+        {
+            Release(range.reference_.slot_);
+            continue;
+        }
+
+        ranges_[kept++] = range;
+    }
+
+    ranges_.resize(kept);
+
+    if(!unindexed_.empty())
+    {
+        Visit(unindexed_, handler);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename Element>
+template <typename Handler>
+void DelayedQueue<Element>::Remove(Handler handler)
+{
+    for(std::uint32_t slot = 0; slot < slots_.size(); ++slot)
+    {
+        if(slots_[slot].used_ && handler(slots_[slot].element_))
+        {
+            Release(slot);
+        }
+    }
+
+    if(0 == size_)
+    {
+        // back to the linear scan
+        slots_.clear();
+        freeSlots_.clear();
+        released_ = 0;
+
+        exactIds_.clear();
+
+        for(std::uint32_t index = 0; index < SFF_BUCKETS; ++index)
+        {
+            if(sffBitmap_.test(index))
+            {
+                sffBuckets_[index].clear();
+            }
+        }
+
+        sffBitmap_.reset();
+        ranges_.clear();
+        unindexed_.clear();
+    }
+    else if(Indexed() && (released_ >= SWEEP_RELEASES + size_))
+    {
+        Sweep();
+    }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,782 @@
+#include "isotp_engine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <pthread.h>
+#include <sys/iomsg.h>
+
+#include "log.h"
+
+//------------------------------------------------------------------------------
+
+const std::uint32_t IsoTpEngine::RESPONSE_TIMEOUT_MS;
+const std::uint32_t IsoTpEngine::RETRY_US;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+    // Identifier fields of an endpoint, remote and error frames never match
+    canid_t ReceiveKey(canid_t canId)
+    {
+        const canid_t idMask = (canId & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK;
+
+        return canId & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG | idMask);
+    }
+
+    bool ValidSeparationTime(std::uint8_t stMin)
+    {
+        return (stMin <= 0x7F) || ((stMin >= 0xF1) && (stMin <= 0xF9));
+    }
+}
+
+//------------------------------------------------------------------------------
+
+IsoTpEngine::IsoTpEngine(Transmit transmit)
+ : transmit_(std::move(transmit))
+ , endpointCount_(0)
+ , terminate_(false)
+{
+}
+
+//------------------------------------------------------------------------------
+
+IsoTpEngine::~IsoTpEngine()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        terminate_ = true;
+    }
+
+    cond_.notify_one();
+
+    if(flowControlThread_.joinable())
+    {
+        flowControlThread_.join();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+IsoTpEngine::Clock::duration IsoTpEngine::SeparationTime(std::uint8_t stMin)
+{
+    if(stMin <= 0x7F)
+    {
+        return std::chrono::milliseconds(stMin);
+    }
+
+    if((stMin >= 0xF1) && (stMin <= 0xF9))
+    {
+        return std::chrono::microseconds((stMin - 0xF0) * 100);
+    }
+
+    // reserved values are taken as the longest time
+    return std::chrono::milliseconds(0x7F);
+}
+
+//------------------------------------------------------------------------------
+
+int IsoTpEngine::SetEndpoint(const void* owner, const CanIsoTpConfig& config)
+{
+    if((config.txId_ & (CAN_RTR_FLAG | CAN_ERR_FLAG)) || (config.rxId_ & (CAN_RTR_FLAG | CAN_ERR_FLAG)) ||
+       (ReceiveKey(config.txId_) == ReceiveKey(config.rxId_)) || !ValidSeparationTime(config.stMin_))
+    {
+        return EINVAL;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // the thread is started by the first endpoint, channels without ISO-TP have none
+    if(!flowControlThread_.joinable())
+    {
+        try
+        {
+            flowControlThread_ = std::thread(&IsoTpEngine::FlowControlThread, this);
+        }
+        catch (const std::exception& e)
+        {
+            LOG(error) << "ISO-TP flow control thread: " << e.what();
+
+            return EAGAIN;
+        }
+    }
+
+    const canid_t rxKey = ReceiveKey(config.rxId_);
+
+    auto receiver = receivers_.find(rxKey);
+
+    std::unique_ptr<Endpoint>& entry = endpoints_[owner];
+
+    if((receiver != receivers_.end()) && (receiver->second != entry.get()))
+    {
+        if(!entry)
+        {
+            endpoints_.erase(owner);
+        }
+
+        return EADDRINUSE;
+    }
+
+    if(entry)
+    {
+        // running transfers are aborted by the new configuration
+        for(const auto& reader: entry->readers_)
+        {
+            MsgError(reader.rcvId_, ECANCELED);
+        }
+
+        for(const auto& writer: entry->writers_)
+        {
+            if(-1 != writer.rcvId_)
+            {
+                MsgError(writer.rcvId_, ECANCELED);
+            }
+        }
+
+        receivers_.erase(ReceiveKey(entry->config_.rxId_));
+    }
+    else
+    {
+        ++endpointCount_;
+    }
+
+    entry.reset(new Endpoint());
+
+    entry->config_ = config;
+    entry->receiving_ = false;
+    entry->txActive_ = false;
+    entry->notifyFlags_ = 0;
+
+    receivers_[rxKey] = entry.get();
+
+    return EOK;
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::DeleteEndpoint(const void* owner)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto found = endpoints_.find(owner);
+
+    if(found == endpoints_.end())
+    {
+        return;
+    }
+
+    Endpoint& endpoint = *found->second;
+
+    for(const auto& reader: endpoint.readers_)
+    {
+        MsgError(reader.rcvId_, EBADF);
+    }
+
+    for(const auto& writer: endpoint.writers_)
+    {
+        if(-1 != writer.rcvId_)
+        {
+            MsgError(writer.rcvId_, EBADF);
+        }
+    }
+
+    receivers_.erase(ReceiveKey(endpoint.config_.rxId_));
+    endpoints_.erase(found);
+
+    --endpointCount_;
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::Receive(const can_frame& canFrame)
+{
+    if(0 == endpointCount_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto receiver = receivers_.find(ReceiveKey(canFrame.can_id));
+
+        if((receiver == receivers_.end()) || (0 == canFrame.len))
+        {
+            return;
+        }
+
+        Endpoint& endpoint = *receiver->second;
+
+        switch(canFrame.data[0] & 0xF0)
+        {
+        case PCI_SINGLE:
+            ReceiveSingle(endpoint, canFrame);
+            break;
+
+        case PCI_FIRST:
+            ReceiveFirst(endpoint, canFrame);
+            break;
+
+        case PCI_CONSECUTIVE:
+            ReceiveConsecutive(endpoint, canFrame);
+            break;
+
+        case PCI_FLOW_CONTROL:
+            ReceiveFlowControl(endpoint, canFrame);
+            break;
+
+        default:
+            return;
+        }
+    }
+
+    // deadlines have moved
+    cond_.notify_one();
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::ReceiveSingle(Endpoint& endpoint, const can_frame& canFrame)
+{
+    const std::uint32_t length = canFrame.data[0] & 0x0F;
+
+    if((0 == length) || (length > 7) || (length + 1 > canFrame.len))
+    {
+        return;
+    }
+
+    // a single frame ends a running reception
+    endpoint.receiving_ = false;
+
+    std::vector<std::uint8_t> pdu(canFrame.data + 1, canFrame.data + 1 + length);
+
+    Deliver(endpoint, pdu);
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::ReceiveFirst(Endpoint& endpoint, const can_frame& canFrame)
+{
+    const std::uint32_t length = ((canFrame.data[0] & 0x0F) << 8) | canFrame.data[1];
+
+    if((CAN_MAX_DLEN != canFrame.len) || (length < 8))
+    {
+        return;
+    }
+
+    if((endpoint.received_.size() >= MAX_RECEIVED_PDUS) && endpoint.readers_.empty())
+    {
+        endpoint.receiving_ = false;
+
+        SendFlowControl(endpoint, FC_OVERFLOW);
+        return;
+    }
+
+    endpoint.receiving_ = true;
+    endpoint.rxPdu_.assign(canFrame.data + 2, canFrame.data + CAN_MAX_DLEN);
+    endpoint.rxPdu_.reserve(length);
+    endpoint.rxLength_ = length;
+    endpoint.rxSequence_ = 1;
+    endpoint.rxBlockLeft_ = endpoint.config_.blockSize_;
+    endpoint.rxDeadline_ = Clock::now() + std::chrono::milliseconds(RESPONSE_TIMEOUT_MS);
+
+    SendFlowControl(endpoint, FC_CONTINUE);
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::ReceiveConsecutive(Endpoint& endpoint, const can_frame& canFrame)
+{
+    if(!endpoint.receiving_)
+    {
+        return;
+    }
+
+    if((canFrame.data[0] & 0x0F) != endpoint.rxSequence_)
+    {
+        // a lost frame, the sender has to repeat the PDU
+        endpoint.receiving_ = false;
+        return;
+    }
+
+    const std::uint32_t count = std::min<std::uint32_t>(std::min<std::uint32_t>(canFrame.len, CAN_MAX_DLEN) - 1,
+                                                        endpoint.rxLength_ - endpoint.rxPdu_.size());
+
+    endpoint.rxPdu_.insert(endpoint.rxPdu_.end(), canFrame.data + 1, canFrame.data + 1 + count);
+    endpoint.rxSequence_ = (endpoint.rxSequence_ + 1) & 0x0F;
+
+    if(endpoint.rxPdu_.size() == endpoint.rxLength_)
+    {
+        endpoint.receiving_ = false;
+
+        Deliver(endpoint, endpoint.rxPdu_);
+        return;
+    }
+
+    endpoint.rxDeadline_ = Clock::now() + std::chrono::milliseconds(RESPONSE_TIMEOUT_MS);
+
+    if((0 != endpoint.config_.blockSize_) && (0 == --endpoint.rxBlockLeft_))
+    {
+        endpoint.rxBlockLeft_ = endpoint.config_.blockSize_;
+
+        SendFlowControl(endpoint, FC_CONTINUE);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::ReceiveFlowControl(Endpoint& endpoint, const can_frame& canFrame)
+{
+    if(!endpoint.txActive_ || !endpoint.txWaitFlowControl_ || (0 == endpoint.txOffset_) || (canFrame.len < 3))
+    {
+        return;
+    }
+
+    const Clock::time_point now = Clock::now();
+
+    switch(canFrame.data[0] & 0x0F)
+    {
+    case FC_CONTINUE:
+        endpoint.txWaitFlowControl_ = false;
+        endpoint.txBlockLeft_ = canFrame.data[1];
+        endpoint.txWaitFrames_ = 0;
+        endpoint.txSeparation_ = SeparationTime(canFrame.data[2]);
+        endpoint.txNext_ = now;
+
+        // without separation time the block is queued right here
+        SendFrames(endpoint, now);
+        break;
+
+    case FC_WAIT:
+        if(++endpoint.txWaitFrames_ > MAX_WAIT_FRAMES)
+        {
+            FinishTransfer(endpoint, ETIMEDOUT, now);
+        }
+        else
+        {
+            endpoint.txDeadline_ = now + std::chrono::milliseconds(RESPONSE_TIMEOUT_MS);
+        }
+        break;
+
+    case FC_OVERFLOW:
+        FinishTransfer(endpoint, EMSGSIZE, now);
+        break;
+
+    default:
+        FinishTransfer(endpoint, EPROTO, now);
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::Deliver(Endpoint& endpoint, std::vector<std::uint8_t>& pdu)
+{
+    if(!endpoint.readers_.empty())
+    {
+        const Request& reader = endpoint.readers_.front();
+
+        const std::uint32_t count = std::min<std::uint32_t>(reader.nbytes_, pdu.size());
+
+        MsgReply(reader.rcvId_, count, pdu.data(), count);
+
+        endpoint.readers_.pop_front();
+        return;
+    }
+
+    if(endpoint.received_.size() >= MAX_RECEIVED_PDUS)
+    {
+        return;
+    }
+
+    endpoint.received_.push_back(std::move(pdu));
+
+    DeliverNotify(endpoint, _NOTIFY_COND_INPUT);
+}
+
+//------------------------------------------------------------------------------
+
+bool IsoTpEngine::SendFrame(const Endpoint& endpoint, const std::uint8_t* data, std::uint32_t len)
+{
+    can_frame canFrame = {};
+
+    canFrame.can_id = endpoint.config_.txId_;
+    canFrame.len = len;
+
+    memcpy(canFrame.data, data, len);
+
+    if(endpoint.config_.flags_ & CanIsoTpConfig::EITF_PADDING)
+    {
+        memset(canFrame.data + len, endpoint.config_.padByte_, CAN_MAX_DLEN - len);
+        canFrame.len = CAN_MAX_DLEN;
+    }
+
+    return transmit_(canFrame);
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::SendFlowControl(Endpoint& endpoint, std::uint8_t status)
+{
+    const std::uint8_t data[3] = { std::uint8_t(PCI_FLOW_CONTROL | status),
+                                   endpoint.config_.blockSize_, endpoint.config_.stMin_ };
+
+    // a refused flow control lets the sender time out
+    SendFrame(endpoint, data, sizeof(data));
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::StartTransfer(Endpoint& endpoint, Clock::time_point now)
+{
+    endpoint.txActive_ = true;
+    endpoint.txWaitFlowControl_ = false;
+    endpoint.txOffset_ = 0;
+    endpoint.txNext_ = now;
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::SendFrames(Endpoint& endpoint, Clock::time_point now)
+{
+    while(endpoint.txActive_ && !endpoint.txWaitFlowControl_ && (endpoint.txNext_ <= now))
+    {
+        const std::vector<std::uint8_t>& pdu = endpoint.writers_.front().pdu_;
+
+        const bool first = (0 == endpoint.txOffset_);
+
+        std::uint8_t data[CAN_MAX_DLEN];
+        std::uint32_t header;
+        std::uint32_t count;
+
+        if(first && (pdu.size() <= 7))
+        {
+            data[0] = PCI_SINGLE | pdu.size();
+            header = 1;
+            count = pdu.size();
+        }
+        else if(first)
+        {
+            data[0] = PCI_FIRST | (pdu.size() >> 8);
+            data[1] = pdu.size() & 0xFF;
+            header = 2;
+            count = 6;
+        }
+        else
+        {
+            data[0] = PCI_CONSECUTIVE | endpoint.txSequence_;
+            header = 1;
+            count = std::min<std::uint32_t>(7, pdu.size() - endpoint.txOffset_);
+        }
+
+        memcpy(data + header, pdu.data() + endpoint.txOffset_, count);
+
+        if(!SendFrame(endpoint, data, header + count))
+        {
+            endpoint.txNext_ = now + std::chrono::microseconds(RETRY_US);
+            return;
+        }
+
+        endpoint.txOffset_ += count;
+
+        if(endpoint.txOffset_ == pdu.size())
+        {
+            FinishTransfer(endpoint, EOK, now);
+            return;
+        }
+
+        if(first)
+        {
+            endpoint.txSequence_ = 1;
+            endpoint.txWaitFlowControl_ = true;
+            endpoint.txWaitFrames_ = 0;
+            endpoint.txDeadline_ = now + std::chrono::milliseconds(RESPONSE_TIMEOUT_MS);
+            return;
+        }
+
+        endpoint.txSequence_ = (endpoint.txSequence_ + 1) & 0x0F;
+
+        if((0 != endpoint.txBlockLeft_) && (0 == --endpoint.txBlockLeft_))
+        {
+            endpoint.txWaitFlowControl_ = true;
+            endpoint.txDeadline_ = now + std::chrono::milliseconds(RESPONSE_TIMEOUT_MS);
+            return;
+        }
+
+        endpoint.txNext_ = now + endpoint.txSeparation_;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::FinishTransfer(Endpoint& endpoint, int status, Clock::time_point now)
+{
+    const Request& writer = endpoint.writers_.front();
+
+    if(-1 != writer.rcvId_)
+    {
+        if(EOK == status)
+        {
+            MsgReply(writer.rcvId_, writer.pdu_.size(), NULL, 0);
+        }
+        else
+        {
+            MsgError(writer.rcvId_, status);
+        }
+    }
+
+    endpoint.writers_.pop_front();
+    endpoint.txActive_ = false;
+
+    if(endpoint.writers_.empty())
+    {
+        DeliverNotify(endpoint, _NOTIFY_COND_OUTPUT);
+    }
+    else
+    {
+        // the flow control thread sends the first frame
+        StartTransfer(endpoint, now);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::DeliverNotify(Endpoint& endpoint, int condition)
+{
+    if(0 == (endpoint.notifyFlags_ & condition))
+    {
+        return;
+    }
+
+    endpoint.notifyEvent_.sigev_value.sival_int |= condition;
+
+    MsgDeliverEvent(endpoint.notifyRcvId_, &endpoint.notifyEvent_);
+
+    endpoint.notifyFlags_ = 0;
+}
+
+//------------------------------------------------------------------------------
+
+int IsoTpEngine::Read(const void* owner, int rcvId, std::uint32_t nbytes, bool nonBlock)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto found = endpoints_.find(owner);
+
+    if(found == endpoints_.end())
+    {
+        return EBADF;
+    }
+
+    Endpoint& endpoint = *found->second;
+
+    if(!endpoint.received_.empty())
+    {
+        const std::vector<std::uint8_t>& pdu = endpoint.received_.front();
+
+        const std::uint32_t count = std::min<std::uint32_t>(nbytes, pdu.size());
+
+        MsgReply(rcvId, count, pdu.data(), count);
+
+        endpoint.received_.pop_front();
+    }
+    else if(nonBlock)
+    {
+        MsgReply(rcvId, 0, 0, 0);
+    }
+    else
+    {
+        endpoint.readers_.push_back(Request{ rcvId, nbytes, std::vector<std::uint8_t>() });
+    }
+
+    return EOK;
+}
+
+//------------------------------------------------------------------------------
+
+int IsoTpEngine::Write(const void* owner, int rcvId, std::vector<std::uint8_t>& pdu, bool nonBlock)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto found = endpoints_.find(owner);
+
+        if(found == endpoints_.end())
+        {
+            return EBADF;
+        }
+
+        Endpoint& endpoint = *found->second;
+
+        if(nonBlock)
+        {
+            if(!endpoint.writers_.empty())
+            {
+                return EAGAIN;
+            }
+
+            // a nonblocking writer does not wait for the transfer and its result
+            MsgReply(rcvId, pdu.size(), NULL, 0);
+
+            rcvId = -1;
+        }
+
+        endpoint.writers_.push_back(Request{ rcvId, std::uint32_t(pdu.size()), std::move(pdu) });
+
+        if(!endpoint.txActive_)
+        {
+            const Clock::time_point now = Clock::now();
+
+            StartTransfer(endpoint, now);
+            SendFrames(endpoint, now);
+        }
+    }
+
+    cond_.notify_one();
+
+    return EOK;
+}
+
+//------------------------------------------------------------------------------
+
+int IsoTpEngine::Notify(const void* owner, int rcvId, int flags, bool arm, const struct sigevent& event)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto found = endpoints_.find(owner);
+
+    if(found == endpoints_.end())
+    {
+        return 0;
+    }
+
+    Endpoint& endpoint = *found->second;
+
+    int trig = 0;
+
+    if(!endpoint.received_.empty())
+    {
+        trig |= _NOTIFY_COND_INPUT;
+    }
+
+    if(endpoint.writers_.empty())
+    {
+        trig |= _NOTIFY_COND_OUTPUT;
+    }
+
+    flags &= _NOTIFY_COND_INPUT | _NOTIFY_COND_OUTPUT;
+
+    if(arm && (0 != flags) && (0 == (trig & flags)))
+    {
+        endpoint.notifyFlags_ = flags;
+        endpoint.notifyRcvId_ = rcvId;
+        endpoint.notifyEvent_ = event;
+    }
+
+    return trig;
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::Unblock(int rcvId)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for(auto& entry: endpoints_)
+    {
+        Endpoint& endpoint = *entry.second;
+
+        endpoint.readers_.erase(std::remove_if(endpoint.readers_.begin(), endpoint.readers_.end(),
+                                               [rcvId](const Request& reader) { return rcvId == reader.rcvId_; }),
+                                endpoint.readers_.end());
+
+        for(auto writer = endpoint.writers_.begin(); writer != endpoint.writers_.end(); )
+        {
+            if(rcvId != writer->rcvId_)
+            {
+                ++writer;
+            }
+            else if(endpoint.txActive_ && (writer == endpoint.writers_.begin()))
+            {
+                // the running transfer completes without a reply
+                writer->rcvId_ = -1;
+                ++writer;
+            }
+            else
+            {
+                writer = endpoint.writers_.erase(writer);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+IsoTpEngine::Clock::time_point IsoTpEngine::Serve(Clock::time_point now)
+{
+    Clock::time_point next = Clock::time_point::max();
+
+    for(auto& entry: endpoints_)
+    {
+        Endpoint& endpoint = *entry.second;
+
+        // N_Cr, the partial PDU is dropped
+        if(endpoint.receiving_ && (endpoint.rxDeadline_ <= now))
+        {
+            endpoint.receiving_ = false;
+        }
+
+        if(endpoint.txActive_)
+        {
+            // N_Bs
+            if(endpoint.txWaitFlowControl_ && (endpoint.txDeadline_ <= now))
+            {
+                FinishTransfer(endpoint, ETIMEDOUT, now);
+            }
+
+            SendFrames(endpoint, now);
+        }
+
+        if(endpoint.receiving_)
+        {
+            next = std::min(next, endpoint.rxDeadline_);
+        }
+
+        if(endpoint.txActive_)
+        {
+            next = std::min(next, endpoint.txWaitFlowControl_ ? endpoint.txDeadline_ : endpoint.txNext_);
+        }
+    }
+
+    return next;
+}
+
+//------------------------------------------------------------------------------
+
+void IsoTpEngine::FlowControlThread()
+{
+    pthread_setschedprio(pthread_self(), 30);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while(!terminate_)
+    {
+        const Clock::time_point next = Serve(Clock::now());
+
+        if(Clock::time_point::max() == next)
+        {
+            cond_.wait(lock);
+        }
+        else
+        {
+            cond_.wait_until(lock, next);
+        }
+    }
+
+    LOG(info) << "ISO-TP flow control thread stopped";
+}
+
+//------------------------------------------------------------------------------
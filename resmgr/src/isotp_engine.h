@@ -0,0 +1,185 @@
+#pragma once
+
+#include <sys/neutrino.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <canrm.h>
+
+#include "non_copyable.h"
+
+//------------------------------------------------------------------------------
+// ISO-TP endpoints of one channel (EDCMD_SET_ISOTP).
+//
+// Received frames of the endpoint identifiers are reassembled and answered
+// with flow control in the receive path, before they reach the message queue.
+// Consecutive frames are put to the controller transmit queue in the flow
+// control thread or, without separation time, right in the receive path.
+// The thread also serves the N_Bs and N_Cr timeouts, it is started with the
+// first endpoint. Clients are replied directly, like the delayed requests of
+// the manager.
+//------------------------------------------------------------------------------
+
+class IsoTpEngine : NonCopyable
+{
+public:
+
+    // Puts the frame to the transmit queue, false if the queue refused it
+    typedef std::function<bool(const can_frame& canFrame)> Transmit;
+
+    explicit IsoTpEngine(Transmit transmit);
+
+    ~IsoTpEngine();
+
+    // Make the owner an endpoint or reconfigure it, running transfers are
+    // aborted. Returns EOK or an errno value
+    int SetEndpoint(const void* owner, const CanIsoTpConfig& config);
+
+    // Pending requests of the owner get EBADF
+    void DeleteEndpoint(const void* owner);
+
+    // Frame of the receive path
+    void Receive(const can_frame& canFrame);
+
+    // Reply the next PDU, queue the reader or return an errno value.
+    // A PDU longer than nbytes is truncated
+    int Read(const void* owner, int rcvId, std::uint32_t nbytes, bool nonBlock);
+
+    // Start or queue the transfer of the PDU, or return an errno value.
+    // The client is replied when the last frame is queued for transmission
+    int Write(const void* owner, int rcvId, std::vector<std::uint8_t>& pdu, bool nonBlock);
+
+    // Conditions of _NOTIFY_COND_INPUT / _NOTIFY_COND_OUTPUT which are satisfied;
+    // with arm the ones which are not are delivered later with the event
+    int Notify(const void* owner, int rcvId, int flags, bool arm, const struct sigevent& event);
+
+    // Forget the blocked read or write of the client
+    void Unblock(int rcvId);
+
+private:
+
+    typedef std::chrono::steady_clock Clock;
+
+    // N_Bs and N_Cr
+    static const std::uint32_t RESPONSE_TIMEOUT_MS = 1000;
+
+    // Flow control WAIT frames accepted in a row (N_WFTmax)
+    static const std::uint32_t MAX_WAIT_FRAMES = 16;
+
+    // Received PDUs kept for the reader, further first frames get OVFLW
+    static const std::size_t MAX_RECEIVED_PDUS = 16;
+
+    // Retry of a consecutive frame refused by a full transmit queue
+    static const std::uint32_t RETRY_US = 1000;
+
+    static const std::uint8_t PCI_SINGLE = 0x00;
+    static const std::uint8_t PCI_FIRST = 0x10;
+    static const std::uint8_t PCI_CONSECUTIVE = 0x20;
+    static const std::uint8_t PCI_FLOW_CONTROL = 0x30;
+
+    static const std::uint8_t FC_CONTINUE = 0;
+    static const std::uint8_t FC_WAIT = 1;
+    static const std::uint8_t FC_OVERFLOW = 2;
+
+    struct Request
+    {
+        int rcvId_;
+        std::uint32_t nbytes_;
+        std::vector<std::uint8_t> pdu_;     // PDU of a write
+    };
+
+    struct Endpoint
+    {
+        CanIsoTpConfig config_;
+
+        // Reassembly
+        bool receiving_;
+        std::vector<std::uint8_t> rxPdu_;
+        std::uint32_t rxLength_;
+        std::uint8_t rxSequence_;
+        std::uint32_t rxBlockLeft_;
+        Clock::time_point rxDeadline_;
+
+        std::deque<std::vector<std::uint8_t>> received_;
+        std::deque<Request> readers_;
+
+        // Segmentation, txActive_ while the PDU of the front writer is sent
+        bool txActive_;
+        bool txWaitFlowControl_;
+        std::uint32_t txOffset_;
+        std::uint8_t txSequence_;
+        std::uint32_t txBlockLeft_;
+        std::uint32_t txWaitFrames_;
+        Clock::duration txSeparation_;
+        Clock::time_point txNext_;
+        Clock::time_point txDeadline_;
+
+        std::deque<Request> writers_;
+
+        // Armed notification
+        int notifyFlags_;
+        int notifyRcvId_;
+        struct sigevent notifyEvent_;
+    };
+
+    void ReceiveSingle(Endpoint& endpoint, const can_frame& canFrame);
+    void ReceiveFirst(Endpoint& endpoint, const can_frame& canFrame);
+    void ReceiveConsecutive(Endpoint& endpoint, const can_frame& canFrame);
+    void ReceiveFlowControl(Endpoint& endpoint, const can_frame& canFrame);
+
+    // Hand the reassembled PDU to a reader or keep it
+    void Deliver(Endpoint& endpoint, std::vector<std::uint8_t>& pdu);
+
+    void SendFlowControl(Endpoint& endpoint, std::uint8_t status);
+
+    // Start the transfer of the front writer, the frames are sent by SendFrames
+    void StartTransfer(Endpoint& endpoint, Clock::time_point now);
+
+    // Queue the frames of the front writer which are due
+    void SendFrames(Endpoint& endpoint, Clock::time_point now);
+
+    // Reply the front writer and start the next one
+    void FinishTransfer(Endpoint& endpoint, int status, Clock::time_point now);
+
+    // False if the transmit queue refused the frame
+    bool SendFrame(const Endpoint& endpoint, const std::uint8_t* data, std::uint32_t len);
+
+    void DeliverNotify(Endpoint& endpoint, int condition);
+
+    static Clock::duration SeparationTime(std::uint8_t stMin);
+
+    // Serve the due timeouts and frames, returns the next time to wake up
+    Clock::time_point Serve(Clock::time_point now);
+
+    void FlowControlThread();
+
+    Transmit transmit_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    std::map<const void*, std::unique_ptr<Endpoint>> endpoints_;
+
+    // Endpoints by received identifier
+    std::unordered_map<canid_t, Endpoint*> receivers_;
+
+    // Lets the receive path skip the lock while there are no endpoints
+    std::atomic<std::size_t> endpointCount_;
+
+    bool terminate_;
+
+    std::thread flowControlThread_;
+};
+
+//------------------------------------------------------------------------------
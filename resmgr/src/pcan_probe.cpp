@@ -0,0 +1,136 @@
+#include <algorithm>
+
+#include "pcan_probe.h"
+
+//------------------------------------------------------------------------------
+
+const std::uint16_t PcanProbe::VENDOR_PEAK_CAN;
+const std::uint32_t PcanProbe::SJA1000_TIMING_CLOCK;
+const unsigned PcanProbe::MAX_CHANNELS;
+
+// All of them carry a PITA bridge in BAR0 and up to four SJA1000 in BAR1
+const PcanModel PcanProbe::MODELS[] =
+{
+    { 0x0001, "PCAN-PCI",               4, 0, 1, 0x400, 2, 16000000 },
+    { 0x0002, "PCAN-ExpressCard",       2, 0, 1, 0x400, 2, 16000000 },
+    { 0x0003, "PCAN-PCI Express",       4, 0, 1, 0x400, 2, 16000000 },
+    { 0x0004, "PCAN-cPCI",              4, 0, 1, 0x400, 2, 16000000 },
+    { 0x0005, "PCAN-miniPCI",           2, 0, 1, 0x400, 2, 16000000 },
+    { 0x0006, "PCAN-PC/104-Plus",       4, 0, 1, 0x400, 2, 16000000 },
+    { 0x0007, "PCAN-PCI/104-Express",   4, 0, 1, 0x400, 2, 16000000 },
+    { 0x0008, "PCAN-miniPCIe",          2, 0, 1, 0x400, 2, 16000000 },
+    { 0x0009, "PCAN-PCI Express OEM",   4, 0, 1, 0x400, 2, 16000000 },
+    { 0x000A, "PCAN-ExpressCard 34",    2, 0, 1, 0x400, 2, 16000000 },
+};
+
+const std::size_t PcanProbe::MODEL_COUNT = sizeof(PcanProbe::MODELS) / sizeof(PcanProbe::MODELS[0]);
+
+//------------------------------------------------------------------------------
+
+PcanProbe::PcanProbe(PciEnumerator& enumerator, const PcanModel* models, std::size_t modelCount)
+ : enumerator_(enumerator)
+ , models_(models)
+ , modelCount_(modelCount)
+{
+}
+
+//------------------------------------------------------------------------------
+
+std::vector<PcanDevice> PcanProbe::FindDevices()
+{
+    std::vector<PcanDevice> devices;
+
+    unsupported_.clear();
+
+    for(std::size_t m = 0; m < modelCount_; ++m)
+    {
+        const PcanModel& model = models_[m];
+
+        std::uint32_t bdf = 0;
+
+        for(unsigned index = 0; enumerator_.Find(index, VENDOR_PEAK_CAN, model.deviceId_, bdf); ++index)
+        {
+            if(model.clockHz_ != SJA1000_TIMING_CLOCK)
+            {
+                unsupported_.push_back(&model);
+                continue;
+            }
+
+            PcanDevice device = { &model, bdf, index, false, 0 };
+
+            device.ssidValid_ = enumerator_.ReadSubsystemId(bdf, device.ssid_);
+
+            devices.push_back(device);
+        }
+    }
+
+    return devices;
+}
+
+//------------------------------------------------------------------------------
+
+bool PcanProbe::SelectBars(const PcanModel& model, const std::vector<PcanBar>& bars, PcanBar& config, PcanBar& chip)
+{
+    const PcanBar* configBar = 0;
+    const PcanBar* chipBar = 0;
+
+    for(const auto& bar: bars)
+    {
+        if(bar.number_ == model.configBar_)
+        {
+            configBar = &bar;
+        }
+        else if(bar.number_ == model.chipBar_)
+        {
+            chipBar = &bar;
+        }
+    }
+
+    if((configBar == 0) || (chipBar == 0) || !chipBar->memory_)
+    {
+        return false;
+    }
+
+    config = *configBar;
+    chip = *chipBar;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+unsigned PcanProbe::ChannelCount(const PcanDevice& device, std::uint64_t chipSize)
+{
+    // PEAK encodes the number of chips in the subsystem ID
+    unsigned channelCount = 1;
+
+    if(device.ssidValid_)
+    {
+        if(device.ssid_ >= 12)
+        {
+            channelCount = 4;
+        }
+        else if(device.ssid_ >= 10)
+        {
+            channelCount = 3;
+        }
+        else if(device.ssid_ >= 4)
+        {
+            channelCount = 2;
+        }
+    }
+
+    channelCount = std::min(channelCount, std::min(device.model_->maxChannels_, MAX_CHANNELS));
+
+    // every channel needs its window in the chip BAR
+    const std::uint64_t windowCount = chipSize / device.model_->channelSize_;
+
+    if(channelCount > windowCount)
+    {
+        channelCount = std::max(unsigned(windowCount), 1u);
+    }
+
+    return channelCount;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "non_copyable.h"
+
+//------------------------------------------------------------------------------
+// PCI access of the device probe. The driver implements it with the QNX PCI
+// server, tests with a table of simulated devices.
+//------------------------------------------------------------------------------
+
+class PciEnumerator
+{
+public:
+
+    virtual ~PciEnumerator() {}
+
+    // Bus, device and function of the index-th device with the IDs, false past the last one
+    virtual bool Find(unsigned index, std::uint16_t vendorId, std::uint16_t deviceId, std::uint32_t& bdf) = 0;
+
+    // False if the subsystem ID can not be read
+    virtual bool ReadSubsystemId(std::uint32_t bdf, std::uint16_t& ssid) = 0;
+};
+
+//------------------------------------------------------------------------------
+
+// Layout of one member of the SJA1000 based PCAN PCI family
+struct PcanModel
+{
+    std::uint16_t deviceId_;
+    const char* name_;
+
+    // Upper bound of the channel count encoded in the subsystem ID
+    unsigned maxChannels_;
+
+    // PITA bridge registers and the SJA1000 register windows
+    std::uint8_t configBar_;
+    std::uint8_t chipBar_;
+
+    std::uint64_t channelSize_;
+    std::uint8_t shift_;
+
+    // SJA1000 oscillator
+    std::uint32_t clockHz_;
+};
+
+// Base address register of a probed function
+struct PcanBar
+{
+    std::uint8_t number_;
+    std::uint64_t address_;
+    std::uint64_t size_;
+    bool memory_;
+};
+
+// A card found by the probe
+struct PcanDevice
+{
+    const PcanModel* model_;
+    std::uint32_t bdf_;
+
+    // Enumeration index among the cards of the model
+    unsigned index_;
+
+    bool ssidValid_;
+    std::uint16_t ssid_;
+};
+
+//------------------------------------------------------------------------------
+// Table lookup, BAR selection and channel count of the PCAN cards. No PCI
+// access except through the enumerator, no side effects.
+//------------------------------------------------------------------------------
+
+class PcanProbe : NonCopyable
+{
+public:
+
+    // Peak SJA1000 PCI controllers, the device IDs are listed in MODELS
+    static const std::uint16_t VENDOR_PEAK_CAN = 0x001C;
+
+    // Oscillator the SJA1000 bit timing tables are computed for
+    static const std::uint32_t SJA1000_TIMING_CLOCK = 16000000;
+
+    static const unsigned MAX_CHANNELS = 4;
+
+    static const PcanModel MODELS[];
+    static const std::size_t MODEL_COUNT;
+
+    PcanProbe(PciEnumerator& enumerator, const PcanModel* models = MODELS, std::size_t modelCount = MODEL_COUNT);
+
+    // Every PEAK card of the enumerator, by model and enumeration order.
+    // Models clocked other than SJA1000_TIMING_CLOCK are not returned
+    std::vector<PcanDevice> FindDevices();
+
+    // Models found with a clock the bit timing tables do not fit, by the last FindDevices
+    const std::vector<const PcanModel*>& UnsupportedModels() const { return unsupported_; }
+
+    // Configuration and chip BAR of the model, false if one is missing or the chip BAR is not memory
+    static bool SelectBars(const PcanModel& model, const std::vector<PcanBar>& bars, PcanBar& config, PcanBar& chip);
+
+    // Channels encoded in the subsystem ID, bounded by the model and by the
+    // register windows of the chip BAR; one channel if the ID is unknown
+    static unsigned ChannelCount(const PcanDevice& device, std::uint64_t chipSize);
+
+private:
+
+    PciEnumerator& enumerator_;
+
+    const PcanModel* models_;
+    std::size_t modelCount_;
+
+    std::vector<const PcanModel*> unsupported_;
+};
+
+//------------------------------------------------------------------------------
@@ -1,5 +1,7 @@
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 #include <string.h>
 
@@ -25,18 +27,40 @@ void PrintUsage()
     " -t            Test variant, not daemon mode\n"
     " -a            After\n"
     " -b            Before\n"
-    " -d name       Alternate registration name\n"
-    " -B size       Buffer size bufsize=2^size\n";
+    " -d name       Alternate registration name of the first channel, further channels count up\n"
+    " -B size       Buffer size bufsize=2^size\n"
+    " -R mode       Receive path: 'thread' (default) or 'direct'\n"
+    " -I mode       Interrupt path: 'pulse' (default) or 'single'\n"
+    " -F mode       Receive FIFO drain: 'count' (default) or 'status'\n"
+    " -T depth      Transmit queue depth in frames (256), writers block or get EAGAIN when it is full\n"
+    " -P mode       Transmit scheduling: 'queue' (default) or 'preempt'\n"
+    " -H            Program the chip acceptance filter from the client filters\n"
+    " -M name       Share the message queue as read only shared memory object, suffixed by the channel number on multi-channel cards\n";
 }
 
 //------------------------------------------------------------------------------------------------
 
-CanManager*       canManager = 0;
-resmgr_context_t* ctp = 0;
+std::vector<std::unique_ptr<CanManager>> canManagers;
+dispatch_context_t* ctp = 0;
 char* __progname;
 
 std::string drvRegPrefix("/dev/");
 
+//------------------------------------------------------------------------------------------------
+// Registration name of the channel, the number at the end of the name is the number of channel 0
+
+std::string ChannelName(const std::string& name, unsigned channel)
+{
+    const std::size_t digits = name.find_last_not_of("0123456789") + 1;
+
+    if (digits == name.size())
+    {
+        return name + std::to_string(channel);
+    }
+
+    return name.substr(0, digits) + std::to_string(std::stoul(name.substr(digits)) + channel);
+}
+
 //------------------------------------------------------------------------------------------------
 
 void Finalize(void)
@@ -46,16 +70,13 @@ void Finalize(void)
 
     if (ctp != 0)
     {
-        resmgr_context_free(ctp);
+        dispatch_context_free(ctp);
         ctp = 0;
     }
 
-    ControllerFactory::Instance().DeleteController();
+    ControllerFactory::Instance().DeleteControllers();
 
-    if (0 != canManager)
-    {
-        delete canManager;
-    }
+    canManagers.clear();
 
     LOG(info) << drvRegPrefix << " Stopped.";
 }
@@ -91,10 +112,6 @@ int main(int argc, char *argv[])
 
     std::string drvRegName("can0");
 
-    resmgr_connect_funcs_t  connect_funcs;
-    resmgr_io_funcs_t       io_funcs;
-    iofunc_attr_t           attr;
-
     dispatch_t              *dpp = 0;
 
     int                     option = 0;
@@ -103,10 +120,24 @@ int main(int argc, char *argv[])
 
     unsigned 				bitRate = 125;
 
+    CanManager::EReceiveMode receiveMode = CanManager::ERM_RECEIVE_THREAD;
+
+    EInterruptMode interruptMode = EIM_PULSE_CHAIN;
+
+    EReceiveDrain receiveDrain = ERD_MESSAGE_COUNT;
+
+    std::size_t transmitQueueDepth = CanController::DEFAULT_TRANSMIT_QUEUE_DEPTH;
+
+    ETransmitScheduling transmitScheduling = ETS_QUEUE;
+
+    bool hardwareFilter = false;
+
+    std::string shmName;
+
     //The flags argument specifies additional information to control the pathname resolution.
     unsigned int resourceFlag = 0;
 
-    while((option = getopt(argc, argv, "abr:B:d:htVs:")) != -1)
+    while((option = getopt(argc, argv, "abr:B:d:hHtVs:R:I:F:M:T:P:")) != -1)
     {
         switch (option)
         {
@@ -165,6 +196,94 @@ int main(int argc, char *argv[])
             testMode = true;
             break;
 
+        case 'H':
+
+            hardwareFilter = true;
+            break;
+
+        case 'M':
+
+            shmName = optarg;
+            break;
+
+        case 'R':
+
+            if(std::string("direct") == optarg)
+            {
+                receiveMode = CanManager::ERM_DIRECT;
+            }
+            else if(std::string("thread") == optarg)
+            {
+                receiveMode = CanManager::ERM_RECEIVE_THREAD;
+            }
+            else
+            {
+                std::cout << "Unknown receive mode: " << optarg << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'I':
+
+            if(std::string("single") == optarg)
+            {
+                interruptMode = EIM_SINGLE_HOP;
+            }
+            else if(std::string("pulse") == optarg)
+            {
+                interruptMode = EIM_PULSE_CHAIN;
+            }
+            else
+            {
+                std::cout << "Unknown interrupt mode: " << optarg << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'F':
+
+            if(std::string("count") == optarg)
+            {
+                receiveDrain = ERD_MESSAGE_COUNT;
+            }
+            else if(std::string("status") == optarg)
+            {
+                receiveDrain = ERD_STATUS_POLL;
+            }
+            else
+            {
+                std::cout << "Unknown receive drain mode: " << optarg << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'T':
+
+            transmitQueueDepth = atoi(optarg);
+            if(0 == transmitQueueDepth)
+            {
+                std::cout << "Error transmit queue depth" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'P':
+
+            if(std::string("queue") == optarg)
+            {
+                transmitScheduling = ETS_QUEUE;
+            }
+            else if(std::string("preempt") == optarg)
+            {
+                transmitScheduling = ETS_PREEMPT;
+            }
+            else
+            {
+                std::cout << "Unknown transmit scheduling: " << optarg << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            break;
+
         case 'r':
 
             if (chdir(optarg))
@@ -209,54 +328,30 @@ int main(int argc, char *argv[])
     sigaction(SIGILL,  &act, 0);
 
     try {
-        canManager = new CanManager(ControllerFactory::Instance().CreateController(bitRate), bufSize);
+        const auto controllers = ControllerFactory::Instance().CreateControllers(bitRate, interruptMode, receiveDrain);
 
-        if(testMode == false)
-        {
-            procmgr_daemon( EXIT_SUCCESS, PROCMGR_DAEMON_NOCLOSE | PROCMGR_DAEMON_NOCHDIR);
-        }
-
-        /* initialize functions for handling messages */
-        iofunc_func_init( _RESMGR_CONNECT_NFUNCS, &connect_funcs,
-                          _RESMGR_IO_NFUNCS, &io_funcs );
-
-        /* initialize attribute structure */
-        iofunc_attr_init( &attr, S_IFNAM | 0666, 0, 0 );
-        attr.inode = 1;
-        attr.nbytes = 0;
-
-        // Replace io_read function
-        io_funcs.read = canManager->io_read;
-
-        //replace write functions
-        io_funcs.write = canManager->io_write;
-
-        //replace open functions
-        connect_funcs.open = canManager->io_open;
+        // one thread releases the cyclic frames of all channels
+        const auto cyclicScheduler = std::make_shared<CyclicScheduler>();
 
-        //replace notify functions
-        io_funcs.notify = canManager->io_notify;
-
-        //replace devctl functions
-        io_funcs.devctl = canManager->io_devctl;
-
-        //replace close functions
-        io_funcs.close_dup = canManager->io_close_dup;
-
-        //replace close ocb functions
-        io_funcs.close_ocb = canManager->io_close_ocb;
+        for (std::size_t channel = 0; channel < controllers.size(); ++channel)
+        {
+            std::string channelShmName(shmName);
 
-        io_funcs.unblock = canManager->io_unblock;
+            if (!shmName.empty() && (controllers.size() > 1))
+            {
+                channelShmName += std::to_string(channel);
+            }
 
-        iofunc_mount_t  mount = {};
-        iofunc_funcs_t  mount_funcs = {};
+            controllers[channel]->SetTransmitQueueDepth(transmitQueueDepth);
+            controllers[channel]->SetTransmitScheduling(transmitScheduling);
 
-        mount_funcs.nfuncs = _IOFUNC_NFUNCS;
-        mount_funcs.ocb_calloc = canManager->ocb_calloc;
-        mount_funcs.ocb_free = canManager->ocb_free;
+            canManagers.emplace_back(new CanManager(controllers[channel], cyclicScheduler, bufSize, receiveMode, hardwareFilter, channelShmName));
+        }
 
-        attr.mount = &mount;
-        attr.mount->funcs = &mount_funcs;
+        if(testMode == false)
+        {
+            procmgr_daemon( EXIT_SUCCESS, PROCMGR_DAEMON_NOCLOSE | PROCMGR_DAEMON_NOCHDIR);
+        }
 
         /* initialize dispatch interface */
         if ((dpp = dispatch_create()) == 0)
@@ -268,38 +363,38 @@ int main(int argc, char *argv[])
         }
         else
         {
+            drvRegPrefix += drvRegName;
 
-            /*  attach our device name (passing in the POSIX defaults
-                      the iofunc_func_init and iofunc_attr_init functions)
-                    */
+            /* all channels are served by one dispatch loop */
+            bool attached = true;
 
-            drvRegPrefix += drvRegName;
+            for (std::size_t channel = 0; channel < canManagers.size(); ++channel)
+            {
+                const std::string path = "/dev/" + ChannelName(drvRegName, channel);
 
-            resmgr_attr_t resmgr_attr = {};
+                if (canManagers[channel]->Attach(dpp, path, resourceFlag) == false)
+                {
+                    std::cerr << "Unable to attach name: " << path << std::endl;
+                    attached = false;
+                    break;
+                }
 
-            /* initialize resource manager attributes */
-            resmgr_attr.nparts_max = 1;
-            resmgr_attr.msg_max_size = 2048;
+                std::cout << "Resource manager is registered as: " << path << std::endl;
+            }
 
-            if(resmgr_attach(dpp, &resmgr_attr, drvRegPrefix.c_str(), _FTYPE_ANY, resourceFlag,
-                             &connect_funcs, &io_funcs, &attr) == -1)
+            if (attached == false)
             {
-                std::cerr << "Unable to attach name: " << argv[0] << std::endl;
-                LOG(error) << "Unable to attach name: " << argv[0];
                 exitStatus = EXIT_FAILURE;
             }
             else
             {
-                std::cout << "Resource manager is registered as: " << drvRegPrefix << std::endl;
-                LOG(info) << "Resource manager is registered as: " << drvRegPrefix;
-
                 /* allocate a context structure */
-                ctp = resmgr_context_alloc(dpp);
+                ctp = dispatch_context_alloc(dpp);
 
                 /* start the resource manager message loop */
                 while (1)
                 {
-                    if ((ctp = resmgr_block(ctp)) == 0)
+                    if ((ctp = dispatch_block(ctp)) == 0)
                     {
                         std::cerr << "Block error" << std::endl;
                         LOG(error) << "Block error";
@@ -307,7 +402,7 @@ int main(int argc, char *argv[])
                         exitStatus = EXIT_FAILURE;
                         break;
                     }
-                    resmgr_handler(ctp);
+                    dispatch_handler(ctp);
                 }
             }
         }
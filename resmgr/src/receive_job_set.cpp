@@ -0,0 +1,244 @@
+#include "receive_job_set.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/neutrino.h>
+#include <sys/syspage.h>
+
+//------------------------------------------------------------------------------
+
+ReceiveJobSet::ReceiveJobSet(std::uint32_t slots)
+ : suppressed_(slots, false)
+ , timedOutJobs_(0)
+ , notifyRcvId_(0)
+ , notifyArmed_(false)
+{
+}
+
+//------------------------------------------------------------------------------
+
+canid_t ReceiveJobSet::JobKey(canid_t canId)
+{
+    const canid_t idMask = (canId & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK;
+
+    return canId & (CAN_EFF_FLAG | CAN_RTR_FLAG | idMask);
+}
+
+//------------------------------------------------------------------------------
+
+int ReceiveJobSet::SetJob(const CanRxJob& job, std::uint64_t now, std::uint64_t& nextDeadline)
+{
+    if(job.canId_ & CAN_ERR_FLAG)
+    {
+        return EINVAL;
+    }
+
+    const canid_t key = JobKey(job.canId_);
+
+    auto found = jobs_.find(key);
+
+    if(found == jobs_.end())
+    {
+        if(jobs_.size() >= CanRxJob::MAX_JOBS)
+        {
+            return ENOSPC;
+        }
+
+        found = jobs_.emplace(key, Job()).first;
+    }
+    else if(found->second.status_.timedOut_)
+    {
+        --timedOutJobs_;
+    }
+
+    const std::uint64_t cyclesPerSec = SYSPAGE_ENTRY(qtime)->cycles_per_sec;
+
+    // a replaced job starts over
+    Job& updated = found->second;
+
+    updated = Job();
+    updated.job_ = job;
+    updated.job_.canId_ = key;
+    updated.throttleCycles_ = job.throttleUs_ * cyclesPerSec / 1000000ULL;
+    updated.timeoutCycles_ = job.timeoutUs_ * cyclesPerSec / 1000000ULL;
+    updated.lastValid_ = false;
+    updated.status_.canId_ = key;
+    updated.status_.lastTimestamp_ = now;
+
+    if(0 != updated.timeoutCycles_)
+    {
+        nextDeadline = std::min(nextDeadline, now + updated.timeoutCycles_);
+    }
+
+    return EOK;
+}
+
+//------------------------------------------------------------------------------
+
+int ReceiveJobSet::DeleteJob(canid_t canId)
+{
+    auto found = jobs_.find(JobKey(canId));
+
+    if(found == jobs_.end())
+    {
+        return ESRCH;
+    }
+
+    if(found->second.status_.timedOut_)
+    {
+        --timedOutJobs_;
+    }
+
+    jobs_.erase(found);
+
+    return EOK;
+}
+
+//------------------------------------------------------------------------------
+
+int ReceiveJobSet::GetStatus(canid_t canId, CanRxJobStatus& status) const
+{
+    auto found = jobs_.find(JobKey(canId));
+
+    if(found == jobs_.end())
+    {
+        return ESRCH;
+    }
+
+    status = found->second.status_;
+
+    return EOK;
+}
+
+//------------------------------------------------------------------------------
+
+bool ReceiveJobSet::Changed(const Job& job, const can_frame& canFrame)
+{
+    if(job.last_.len != canFrame.len)
+    {
+        return true;
+    }
+
+    const std::uint32_t len = std::min<std::uint32_t>(canFrame.len, CAN_MAX_DLEN);
+
+    for(std::uint32_t i = 0; i < len; ++i)
+    {
+        if(0 != ((job.last_.data[i] ^ canFrame.data[i]) & job.job_.dataMask_[i]))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+
+void ReceiveJobSet::Publish(std::uint32_t slot, const CanTimedFrame& timedFrame, std::uint64_t& nextDeadline)
+{
+    const can_frame& canFrame = timedFrame.frame_;
+
+    // error frames are not subject to the jobs
+    auto found = (canFrame.can_id & CAN_ERR_FLAG) ? jobs_.end() : jobs_.find(JobKey(canFrame.can_id));
+
+    if(found == jobs_.end())
+    {
+        suppressed_[slot] = false;
+        return;
+    }
+
+    Job& job = found->second;
+    CanRxJobStatus& status = job.status_;
+
+    ++status.received_;
+    status.lastTimestamp_ = timedFrame.timestamp_;
+
+    if(status.timedOut_)
+    {
+        // the frame is back, watch it again
+        status.timedOut_ = 0;
+        --timedOutJobs_;
+
+        nextDeadline = std::min(nextDeadline, timedFrame.timestamp_ + job.timeoutCycles_);
+    }
+
+    bool pass = true;
+
+    if(job.lastValid_)
+    {
+        if((job.job_.flags_ & CanRxJob::ERJF_CHANGE) && !Changed(job, canFrame))
+        {
+            pass = false;
+        }
+        else if(timedFrame.timestamp_ - job.lastPassed_ < job.throttleCycles_)
+        {
+            pass = false;
+        }
+    }
+
+    suppressed_[slot] = !pass;
+
+    if(pass)
+    {
+        ++status.passed_;
+
+        job.last_ = canFrame;
+        job.lastValid_ = true;
+        job.lastPassed_ = timedFrame.timestamp_;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+bool ReceiveJobSet::CheckTimeouts(std::uint64_t now, std::uint64_t& nextDeadline)
+{
+    bool timedOut = false;
+
+    for(auto& entry: jobs_)
+    {
+        Job& job = entry.second;
+        CanRxJobStatus& status = job.status_;
+
+        if((0 == job.timeoutCycles_) || status.timedOut_)
+        {
+            continue;
+        }
+
+        const std::uint64_t deadline = status.lastTimestamp_ + job.timeoutCycles_;
+
+        if(deadline > now)
+        {
+            nextDeadline = std::min(nextDeadline, deadline);
+            continue;
+        }
+
+        status.timedOut_ = 1;
+        ++status.timeouts_;
+        ++timedOutJobs_;
+
+        // the first frame after the timeout is passed
+        job.lastValid_ = false;
+
+        timedOut = true;
+    }
+
+    return timedOut;
+}
+
+//------------------------------------------------------------------------------
+
+bool ReceiveJobSet::TakeNotify(int& rcvId)
+{
+    if(!notifyArmed_)
+    {
+        return false;
+    }
+
+    rcvId = notifyRcvId_;
+    notifyArmed_ = false;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <canrm.h>
+#include <can.h>
+
+#include "non_copyable.h"
+
+//------------------------------------------------------------------------------
+// Receive jobs of one open file (EDCMD_SET_RX_JOB).
+//
+// Every published frame is judged once, when it is put to the message queue;
+// the verdict is kept per queue slot, so read and notify only test a bit.
+// Times are ClockCycles() like the frame timestamps. The owner serializes
+// the calls with the message queue lock.
+//------------------------------------------------------------------------------
+
+class ReceiveJobSet : NonCopyable
+{
+public:
+
+    // slots is the number of message queue elements
+    explicit ReceiveJobSet(std::uint32_t slots);
+
+    // Returns EOK or an errno value, the timeout of the job is lowered to nextDeadline
+    int SetJob(const CanRxJob& job, std::uint64_t now, std::uint64_t& nextDeadline);
+
+    // Returns EOK or ESRCH
+    int DeleteJob(canid_t canId);
+
+    // Returns EOK or ESRCH
+    int GetStatus(canid_t canId, CanRxJobStatus& status) const;
+
+    // Judge the frame put to the queue slot. The timeout of a job receiving
+    // its frame again after a timeout is lowered to nextDeadline
+    void Publish(std::uint32_t slot, const CanTimedFrame& timedFrame, std::uint64_t& nextDeadline);
+
+    bool Suppressed(std::uint32_t slot) const { return suppressed_[slot]; }
+
+    // Mark the overdue jobs and lower the timeout of the others to nextDeadline.
+    // Returns true if a job has timed out by this check
+    bool CheckTimeouts(std::uint64_t now, std::uint64_t& nextDeadline);
+
+    bool TimedOut() const { return 0 != timedOutJobs_; }
+
+    // Deliver the armed _NOTIFY_COND_OBAND notification on the next timeout
+    void ArmNotify(int rcvId) { notifyRcvId_ = rcvId; notifyArmed_ = true; }
+
+    // The armed notification, false if there is none
+    bool TakeNotify(int& rcvId);
+
+private:
+
+    struct Job
+    {
+        CanRxJob job_;
+
+        std::uint64_t throttleCycles_;
+        std::uint64_t timeoutCycles_;
+
+        // Frame passed before, invalid before the first one and after a timeout
+        can_frame last_;
+        bool lastValid_;
+        std::uint64_t lastPassed_;
+
+        CanRxJobStatus status_;
+    };
+
+    // Identifier fields which select the job
+    static canid_t JobKey(canid_t canId);
+
+    static bool Changed(const Job& job, const can_frame& canFrame);
+
+    std::unordered_map<canid_t, Job> jobs_;
+
+    // Verdict per message queue slot, true if the frame is not returned
+    std::vector<bool> suppressed_;
+
+    std::uint32_t timedOutJobs_;
+
+    int notifyRcvId_;
+    bool notifyArmed_;
+};
+
+//------------------------------------------------------------------------------
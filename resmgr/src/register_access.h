@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chip_mapper.h"
+#include "chip_ports.h"
+
+//------------------------------------------------------------------------------
+// Register accessors of the controller hot paths. The paths are instantiated
+// for each accessor, so a register access is resolved at compile time.
+// Registers are addressed by their offset in the chip map.
+
+// Any mapper through its virtual interface (port I/O, register simulators)
+class MapperRegisterAccess
+{
+public:
+
+    explicit MapperRegisterAccess(const ChipMapperBase& mapper)
+     : mapper_(mapper)
+     , reads_(0)
+    {}
+
+    std::uint8_t Get(const tPort8* reg)
+    {
+        ++reads_;
+        return mapper_.GetByte(reg);
+    }
+
+    void Put(const tPort8* reg, std::uint8_t value)
+    {
+        mapper_.PutByte(reg, value);
+    }
+
+    void GetBlock(const tPort8* reg, std::uint8_t* data, std::size_t count)
+    {
+        reads_ += count;
+        mapper_.GetBlock(reg, data, count);
+    }
+
+    void PutBlock(const tPort8* reg, const std::uint8_t* data, std::size_t count)
+    {
+        mapper_.PutBlock(reg, data, count);
+    }
+
+    std::uint64_t Reads() const { return reads_; }
+
+private:
+
+    const ChipMapperBase& mapper_;
+    std::uint64_t reads_;
+};
+
+//------------------------------------------------------------------------------
+// Memory mapped chip with the address shift known at compile time,
+// an access is a single volatile load or store
+
+template <std::uint8_t SHIFT>
+class DirectRegisterAccess
+{
+public:
+
+    explicit DirectRegisterAccess(volatile std::uint8_t* base)
+     : base_(base)
+     , reads_(0)
+    {}
+
+    inline std::uint8_t Get(const tPort8* reg)
+    {
+        ++reads_;
+        return base_[reinterpret_cast<std::uintptr_t>(reg) << SHIFT];
+    }
+
+    inline void Put(const tPort8* reg, std::uint8_t value)
+    {
+        base_[reinterpret_cast<std::uintptr_t>(reg) << SHIFT] = value;
+    }
+
+    inline void GetBlock(const tPort8* reg, std::uint8_t* data, std::size_t count)
+    {
+        volatile std::uint8_t* ptReg = base_ + (reinterpret_cast<std::uintptr_t>(reg) << SHIFT);
+
+        reads_ += count;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            data[i] = ptReg[i << SHIFT];
+        }
+    }
+
+    inline void PutBlock(const tPort8* reg, const std::uint8_t* data, std::size_t count)
+    {
+        volatile std::uint8_t* ptReg = base_ + (reinterpret_cast<std::uintptr_t>(reg) << SHIFT);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            ptReg[i << SHIFT] = data[i];
+        }
+    }
+
+    std::uint64_t Reads() const { return reads_; }
+
+private:
+
+    volatile std::uint8_t* const base_;
+    std::uint64_t reads_;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,115 @@
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "shared_transmit_ring.h"
+
+//------------------------------------------------------------------------------
+
+std::atomic<std::uint32_t> SharedTransmitRing::counter_(0);
+
+//------------------------------------------------------------------------------
+
+SharedTransmitRing::SharedTransmitRing(std::uint32_t slotCount, uid_t uid, gid_t gid)
+ : ring_(0)
+ , frames_(0)
+ , size_(0)
+ , slotCount_(slotCount)
+{
+    if((0 == slotCount_) || (slotCount_ > MAX_SLOTS) || (0 != (slotCount_ & (slotCount_ - 1))))
+    {
+        throw std::runtime_error("Transmit ring size error");
+    }
+
+    name_ = "/canrmd-tx-" + std::to_string(getpid()) + "-" + std::to_string(counter_++);
+
+    const std::uint32_t frameOffset = (sizeof(CanShmTxRing) + 63) & ~63;
+
+    size_ = frameOffset + slotCount_ * sizeof(can_frame);
+
+    // a left over object of the name is not taken over
+    const int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if(-1 == fd)
+    {
+        throw std::runtime_error("Transmit ring open error");
+    }
+
+    void* memory = MAP_FAILED;
+
+    // sealed: ftruncate() of the client can not shrink the object under the mapping
+    if((-1 != shm_ctl(fd, SHMCTL_ANON | SHMCTL_SEAL, 0, size_)) && (-1 != fchown(fd, uid, gid)))
+    {
+        memory = mmap(0, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);
+
+    if(MAP_FAILED == memory)
+    {
+        shm_unlink(name_.c_str());
+
+        throw std::runtime_error("Transmit ring map error");
+    }
+
+    memset(memory, 0, size_);
+
+    ring_ = static_cast<CanShmTxRing*>(memory);
+    frames_ = reinterpret_cast<const can_frame*>(static_cast<std::uint8_t*>(memory) + frameOffset);
+
+    ring_->slotCount_ = slotCount_;
+    ring_->frameOffset_ = frameOffset;
+    ring_->head_.store(0, std::memory_order_relaxed);
+    ring_->tail_.store(0, std::memory_order_relaxed);
+    ring_->idle_.store(0, std::memory_order_relaxed);
+    ring_->magic_ = CanShmTxRing::MAGIC;
+}
+
+//------------------------------------------------------------------------------
+
+SharedTransmitRing::~SharedTransmitRing()
+{
+    munmap(ring_, size_);
+    shm_unlink(name_.c_str());
+}
+
+//------------------------------------------------------------------------------
+
+const can_frame* SharedTransmitRing::Front()
+{
+    const std::uint32_t tail = ring_->tail_.load(std::memory_order_relaxed);
+
+    if(tail == ring_->head_.load(std::memory_order_acquire))
+    {
+        // ask for the doorbell, then check again for a frame written in between
+        ring_->idle_.store(1, std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if(tail == ring_->head_.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+    }
+
+    front_ = frames_[tail & (slotCount_ - 1)];
+
+    if(front_.len > CAN_MAX_DLEN)
+    {
+        front_.len = CAN_MAX_DLEN;
+    }
+
+    return &front_;
+}
+
+//------------------------------------------------------------------------------
+
+void SharedTransmitRing::Pop()
+{
+    ring_->tail_.store(ring_->tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <sys/types.h>
+
+#include <can_shm.h>
+
+#include "can_controller.h"
+#include "non_copyable.h"
+
+//------------------------------------------------------------------------------
+// Driver side of a transmit ring (CanShmTxRing) of one open file.
+//
+// The driver creates, sizes and seals the shared memory object, so the client
+// can neither resize it under the driver mapping nor hand over a foreign
+// object. The client maps the same memory and may write anything into it, so
+// the indices are checked and the frames copied before they are used.
+//------------------------------------------------------------------------------
+
+class SharedTransmitRing : public TransmitSource, NonCopyable
+{
+public:
+
+    static const std::uint32_t MAX_SLOTS = 1 << 16;
+
+    // The object is opened for read and write by the user of the client only.
+    // Throws std::runtime_error if the object can not be created or the slot
+    // count is not a power of two up to MAX_SLOTS
+    SharedTransmitRing(std::uint32_t slotCount, uid_t uid, gid_t gid);
+
+    // Unmaps and unlinks the object
+    virtual ~SharedTransmitRing();
+
+    virtual const can_frame* Front();
+
+    virtual void Pop();
+
+    const std::string& Name() const { return name_; }
+
+    std::size_t Size() const { return size_; }
+
+private:
+
+    // Numbers the objects of the process
+    static std::atomic<std::uint32_t> counter_;
+
+    std::string name_;
+
+    CanShmTxRing* ring_;
+    const can_frame* frames_;
+
+    std::size_t size_;
+
+    std::uint32_t slotCount_;
+
+    // copy of the front frame, the client can not change it any more
+    can_frame front_;
+};
+
+//------------------------------------------------------------------------------
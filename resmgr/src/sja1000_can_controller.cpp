@@ -1,23 +1,50 @@
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstring>
 #include <iomanip>
 
 #include "sja1000_can_controller.h"
 
+#include <can_error.h>
+
 #include "log.h"
 #include "controller_factory.h"
 
 //------------------------------------------------------------------------------------------------
 
+const std::uint32_t SJA1000CanController::ACCEPTANCE_FILTER_TIMEOUT_MS;
+
+//------------------------------------------------------------------------------------------------
+
 SJA1000CanController::SJA1000CanController(std::unique_ptr<ChipMapperBase> chipMapper, ECanBaudRate baudRate)
  : CanController(std::move(chipMapper), baudRate)
- , sja1000Map_(0)
- , receiveMessageBufHead_(0)
- , receiveMessageBufTail_(0)
- , errorBufHead_(0)
- , errorBufTail_(0)
+ , directBase_(chipMapper_->DirectBase())
+ , directShift_(chipMapper_->Shift())
+ , acceptanceFilter_{ false, { 0xff, 0xff, 0xff, 0xff }, { 0xff, 0xff, 0xff, 0xff } }
+ , pendingAcceptanceFilter_(acceptanceFilter_)
+ , acceptanceFilterPending_(false)
+ , reportedOverflows_(0)
+ , receiveRegisterReads_(0)
+ , receiveFrames_(0)
+ , interruptCycles_(0)
+ , notifyCycles_(0)
+ , interruptToPulseTiming_("interrupt -> pulse handler")
+ , pulseToReaderTiming_("pulse handler -> reader")
+ , reportedErrorOverflows_(0)
+ , errorState_(ES_ACTIVE)
  , interruptChannel_(_NTO_CHF_FIXED_PRIORITY)
+ , transmitSpaceWanted_(false)
+ , transmitFrame_()
+ , abortRequested_(false)
+ , transmitAborted_(false)
+ , inversionStart_(0)
+ , priorityInversions_(0)
+ , abortRequests_(0)
+ , requeuedFrames_(0)
+ , inversionTiming_("priority inversion")
  , transmitBufferFree_(true)
+ , transmitLength_(0)
 {
     memset(&interruptSpinLock_, 0, sizeof(interruptSpinLock_));
 
@@ -86,14 +113,10 @@ bool SJA1000CanController::InitController()
 
     PutByte(&sja1000Map_->clkDiv, CAN_CDR_CANM | CAN_CDR_CLKOFF | 0x00); // PeliCAN mode, bypass CAN input,fosc
     //  PutByte(&sja1000Map_->clkDiv, CAN_CDR_CANM | CAN_CDR_CBP | CAN_CDR_CLKOFF | 0x07); // PeliCAN mode, bypass CAN input,fosc
-    PutByte(&sja1000Map_->ModeReg, CAN_MR_AFM | CAN_MR_RM); // single acceptance filter option is enable
+    PutByte(&sja1000Map_->ModeReg, (acceptanceFilter_.dual_ ? 0 : CAN_MR_AFM) | CAN_MR_RM);
     PutByte(&sja1000Map_->cmndReg, CAN_CM_AT | CAN_CM_COS | CAN_CM_RRB);
-    PutByte(&sja1000Map_->RxTxFrInf, 0xff); // set acceptance code0 0xff
 
-    for(unsigned i = 0; i < 7; ++i)
-    {
-        PutByte(&sja1000Map_->RxTxIdData[i], 0xff) ; // set acceptance code and mask 0xff
-    }
+    WriteAcceptanceFilter(); // everything passes until the clients set their filters
 
     PutByte(&sja1000Map_->busTim0, BitTiming0[baudRate_]);
     PutByte(&sja1000Map_->busTim1, BitTiming1[baudRate_]);
@@ -110,7 +133,7 @@ bool SJA1000CanController::InitController()
     PutByte(&sja1000Map_->TxErrCount, 0); // reset Tx error counter
     PutByte(&sja1000Map_->RxErrCount, 0); // reset Rx error counter
     PutByte(&sja1000Map_->ModeReg, (GetByte(&sja1000Map_->ModeReg) &~ CAN_MR_RM)); //normal mode
-    
+
     const std::uint64_t nTimer = GetNsec();
     
     while (GetByte(&sja1000Map_->ModeReg) & 1) 
@@ -137,6 +160,291 @@ bool SJA1000CanController::InitController()
 
 //------------------------------------------------------------------------------------------------
 
+namespace
+{
+    // Frame as seen by the single acceptance filter: standard frames ID.10-0, RTR and two
+    // data bytes, extended frames ID.28-0 and RTR, both left aligned. care_ bits are compared.
+    // The dual filter compares the upper 16 bits of the same layout.
+    struct AcceptanceWord
+    {
+        std::uint32_t code_;
+        std::uint32_t care_;
+        bool sff_;
+    };
+
+    void AddAcceptanceWords(const can_filter& filter, std::vector<AcceptanceWord>& words)
+    {
+        const canid_t id = filter.can_id & filter.can_mask;
+        const canid_t mask = filter.can_mask;
+        const bool rtrCare = (mask & CAN_RTR_FLAG) != 0;
+        const bool rtr = (id & CAN_RTR_FLAG) != 0;
+
+        // standard frames are possible if the extended flag is not required
+        // and no identifier bit above ID.10 has to be set
+        if(!((mask & CAN_EFF_FLAG) && (id & CAN_EFF_FLAG)) && (0 == (id & CAN_EFF_MASK & ~CAN_SFF_MASK)))
+        {
+            const std::uint32_t care = ((mask & CAN_SFF_MASK) << 21) | (rtrCare ? (1 << 20) : 0);
+            const std::uint32_t code = ((id & CAN_SFF_MASK) << 21) | (rtr ? (1 << 20) : 0);
+
+            words.push_back(AcceptanceWord{ code & care, care, true });
+        }
+
+        if(!((mask & CAN_EFF_FLAG) && !(id & CAN_EFF_FLAG)))
+        {
+            const std::uint32_t care = ((mask & CAN_EFF_MASK) << 3) | (rtrCare ? (1 << 2) : 0);
+            const std::uint32_t code = ((id & CAN_EFF_MASK) << 3) | (rtr ? (1 << 2) : 0);
+
+            words.push_back(AcceptanceWord{ code & care, care, false });
+        }
+    }
+
+    // The tightest pattern passing all words
+    AcceptanceWord Cover(const AcceptanceWord& lhs, const AcceptanceWord& rhs)
+    {
+        const std::uint32_t care = lhs.care_ & rhs.care_ & ~(lhs.code_ ^ rhs.code_);
+
+        return AcceptanceWord{ lhs.code_ & care, care, lhs.sff_ || rhs.sff_ };
+    }
+
+    // Fraction of the identifier space passed by the pattern
+    double PassRatio(std::uint32_t care)
+    {
+        return std::ldexp(1.0, -__builtin_popcount(care));
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+SJA1000CanController::AcceptanceFilter SJA1000CanController::ComputeAcceptanceFilter(const std::vector<can_filter>& filters)
+{
+    std::vector<AcceptanceWord> words;
+
+    for(const auto& filter: filters)
+    {
+        AddAcceptanceWords(filter, words);
+    }
+
+    if(words.empty())
+    {
+        // nothing is needed, pass only the extended remote frame 0x1FFFFFFF
+        return AcceptanceFilter{ false, { 0xff, 0xff, 0xff, 0xff }, { 0x00, 0x00, 0x00, 0x03 } };
+    }
+
+    // single filter over all words
+    AcceptanceWord single = words[0];
+
+    for(const auto& word: words)
+    {
+        single = Cover(single, word);
+    }
+
+    // dual filter: the words are split in two groups, seeded by the first word and the one
+    // most different from it, every other word joins the group which loses less care bits
+    const std::uint32_t DUAL_CARE = 0xffff0000;
+
+    std::size_t seed = 0;
+
+    for(std::size_t i = 1; i < words.size(); ++i)
+    {
+        const auto distance = [&](std::size_t n)
+        {
+            return __builtin_popcount((words[0].code_ ^ words[n].code_) & words[0].care_ & words[n].care_ & DUAL_CARE);
+        };
+
+        if((0 == seed) || (distance(i) > distance(seed)))
+        {
+            seed = i;
+        }
+    }
+
+    AcceptanceWord group[2] = { words[0], words[seed] };
+
+    for(std::size_t i = 1; i < words.size(); ++i)
+    {
+        if(i == seed)
+        {
+            continue;
+        }
+
+        const AcceptanceWord first = Cover(group[0], words[i]);
+        const AcceptanceWord second = Cover(group[1], words[i]);
+
+        const int firstLoss = __builtin_popcount(group[0].care_ & DUAL_CARE) - __builtin_popcount(first.care_ & DUAL_CARE);
+        const int secondLoss = __builtin_popcount(group[1].care_ & DUAL_CARE) - __builtin_popcount(second.care_ & DUAL_CARE);
+
+        if(firstLoss <= secondLoss)
+        {
+            group[0] = first;
+        }
+        else
+        {
+            group[1] = second;
+        }
+    }
+
+    // standard frames compare the data nibble of filter 1 with ACR3 bits 3-0, which
+    // filter 2 uses for ID.16-13 of extended frames
+    if(group[0].sff_)
+    {
+        group[1].care_ &= ~0x000f0000;
+        group[1].code_ &= group[1].care_;
+    }
+
+    AcceptanceFilter acceptanceFilter;
+
+    if(PassRatio(single.care_) <= PassRatio(group[0].care_ & DUAL_CARE) + PassRatio(group[1].care_ & DUAL_CARE))
+    {
+        acceptanceFilter.dual_ = false;
+
+        for(unsigned i = 0; i < 4; ++i)
+        {
+            acceptanceFilter.code_[i] = std::uint8_t(single.code_ >> (24 - 8 * i));
+            acceptanceFilter.mask_[i] = std::uint8_t(~single.care_ >> (24 - 8 * i));
+        }
+    }
+    else
+    {
+        acceptanceFilter.dual_ = true;
+
+        acceptanceFilter.code_[0] = std::uint8_t(group[0].code_ >> 24);
+        acceptanceFilter.code_[1] = std::uint8_t(group[0].code_ >> 16);
+        acceptanceFilter.code_[2] = std::uint8_t(group[1].code_ >> 24);
+        acceptanceFilter.code_[3] = std::uint8_t(group[1].code_ >> 16);
+
+        acceptanceFilter.mask_[0] = std::uint8_t(~group[0].care_ >> 24);
+        acceptanceFilter.mask_[1] = std::uint8_t(~group[0].care_ >> 16);
+        acceptanceFilter.mask_[2] = std::uint8_t(~group[1].care_ >> 24);
+        acceptanceFilter.mask_[3] = std::uint8_t(~group[1].care_ >> 16);
+    }
+
+    return acceptanceFilter;
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SJA1000CanController::WriteAcceptanceFilter()
+{
+    PutByte(&sja1000Map_->RxTxFrInf, acceptanceFilter_.code_[0]); // acceptance code 0
+
+    for(unsigned i = 1; i < 4; ++i)
+    {
+        PutByte(&sja1000Map_->RxTxIdData[i - 1], acceptanceFilter_.code_[i]); // acceptance code 1-3
+    }
+
+    for(unsigned i = 0; i < 4; ++i)
+    {
+        PutByte(&sja1000Map_->RxTxIdData[i + 3], acceptanceFilter_.mask_[i]); // acceptance mask 0-3
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SJA1000CanController::SetAcceptanceFilter(const std::vector<can_filter>& filters)
+{
+    const AcceptanceFilter acceptanceFilter = ComputeAcceptanceFilter(filters);
+
+    std::unique_lock<std::mutex> lock(transmitMutex_);
+
+    const AcceptanceFilter& latest = acceptanceFilterPending_ ? pendingAcceptanceFilter_ : acceptanceFilter_;
+
+    if((acceptanceFilter.dual_ == latest.dual_) &&
+       (0 == memcmp(acceptanceFilter.code_, latest.code_, sizeof(acceptanceFilter.code_))) &&
+       (0 == memcmp(acceptanceFilter.mask_, latest.mask_, sizeof(acceptanceFilter.mask_))))
+    {
+        return;
+    }
+
+    // a later change replaces a filter still waiting
+    pendingAcceptanceFilter_ = acceptanceFilter;
+    acceptanceFilterPending_ = true;
+
+    if(!inited_ || transmitBufferFree_)
+    {
+        ApplyAcceptanceFilter();
+        return;
+    }
+
+    // reset mode would end the transmission unnoticed: abort it, the transmit
+    // interrupt frees the buffer, ProcessTransmitFlag programs the filter and
+    // queues the frame again if it has not been sent
+    AbortTransmission();
+
+    if(acceptanceCond_.wait_for(lock, std::chrono::milliseconds(ACCEPTANCE_FILTER_TIMEOUT_MS), [this] { return !acceptanceFilterPending_; }))
+    {
+        return;
+    }
+
+    // no transmit interrupt, e.g. bus off: reset mode ends the transmission
+    // and the frame is sent again, unless the interrupt came meanwhile
+    LOG(error) << "Transmit buffer not freed, acceptance filter programmed over the transmission";
+
+    if(!transmitBufferFree_)
+    {
+        transmitAborted_ = true;
+        TransmitBufferFree();
+    }
+
+    ApplyAcceptanceFilter();
+    RequeueAbortedFrame();
+
+    can_frame canFrame;
+
+    if(NextTransmitFrame(canFrame))
+    {
+        TransmitMessage(canFrame);
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SJA1000CanController::ApplyAcceptanceFilter()
+{
+    if(!acceptanceFilterPending_)
+    {
+        return;
+    }
+
+    acceptanceFilterPending_ = false;
+    acceptanceFilter_ = pendingAcceptanceFilter_;
+
+    acceptanceCond_.notify_all();
+
+    LOG(info) << (acceptanceFilter_.dual_ ? "dual" : "single") << " acceptance filter, code: " << std::hex
+              << std::setw(2) << std::setfill('0') << int(acceptanceFilter_.code_[0])
+              << std::setw(2) << std::setfill('0') << int(acceptanceFilter_.code_[1])
+              << std::setw(2) << std::setfill('0') << int(acceptanceFilter_.code_[2])
+              << std::setw(2) << std::setfill('0') << int(acceptanceFilter_.code_[3]) << " mask: "
+              << std::setw(2) << std::setfill('0') << int(acceptanceFilter_.mask_[0])
+              << std::setw(2) << std::setfill('0') << int(acceptanceFilter_.mask_[1])
+              << std::setw(2) << std::setfill('0') << int(acceptanceFilter_.mask_[2])
+              << std::setw(2) << std::setfill('0') << int(acceptanceFilter_.mask_[3]);
+
+    // InitController writes the registers
+    if(!inited_)
+    {
+        return;
+    }
+
+    EnterCmdRegWriteCriticalSection();
+
+    PutByte(&sja1000Map_->ModeReg, (acceptanceFilter_.dual_ ? 0 : CAN_MR_AFM) | CAN_MR_RM);
+
+    WriteAcceptanceFilter();
+
+    PutByte(&sja1000Map_->ModeReg, acceptanceFilter_.dual_ ? 0 : CAN_MR_AFM);
+
+    const bool resetMode = (GetByte(&sja1000Map_->ModeReg) & CAN_MR_RM) != 0;
+
+    LeaveCmdRegWriteCriticalSection();
+
+    if(resetMode)
+    {
+        LOG(error) << "Controller stays in reset mode";
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
 bool SJA1000CanController::IsThereDevice()
 {
     LOG(debug);
@@ -198,7 +506,11 @@ void SJA1000CanController::CloseController()
 
     PutByte(&sja1000Map_->ModeReg, 0);
 
-    inited_ = false;
+    {
+        std::unique_lock<std::mutex> lock(receiveMutex_);
+        inited_ = false;
+        receiveCond_.notify_all();
+    }
 
     MsgSendPulse(interruptChannel_.coid, SIGEV_PULSE_PRIO_INHERIT, TERMINATE_PULSE, 0);
    
@@ -210,230 +522,460 @@ void SJA1000CanController::CloseController()
 //------------------------------------------------------------------------------------------------
 
 bool SJA1000CanController::WriteMessage(const can_frame& canFrame)
+{
+    return WriteMessages(&canFrame, 1) == 1;
+}
+
+//------------------------------------------------------------------------------------------------
+
+std::size_t SJA1000CanController::WriteMessages(const can_frame* canFrames, std::size_t count)
 {
     std::unique_lock<std::mutex> lock(transmitMutex_);
 
-    if(transmitDataQueue_.empty() && transmitBufferFree_)
+    std::size_t i = 0;
+
+    if((0 != count) && transmitDataQueue_.Empty() && transmitBufferFree_ && !transmitAborted_)
     {
-        TransmitMessage(canFrame);
+        ApplyAcceptanceFilter();
+
+        TransmitMessage(canFrames[i++]);
     }
-    else
+
+    // frames above the queue depth are refused, the writer waits for the space handler
+    const std::size_t accepted = i + std::min(count - i, FreeTransmitSlots());
+
+    for(; i < accepted; ++i)
     {
-        transmitDataQueue_.push(canFrame);
+        transmitDataQueue_.Push(canFrames[i]);
     }
 
-    return true;
+    ChannelStats::Max(stats_.txQueueHighWater_, transmitDataQueue_.Size());
+
+    if(accepted < count)
+    {
+        transmitSpaceWanted_ = true;
+    }
+
+    CheckPriorityInversion();
+
+    return accepted;
 }
 
 //------------------------------------------------------------------------------------------------
 
-void SJA1000CanController::ReceiveMessage()
+std::size_t SJA1000CanController::TransmitQueueSpace()
 {
-    unsigned messages = MAX_RECEIVED_MESSAGES;
+    std::unique_lock<std::mutex> lock(transmitMutex_);
+
+    const std::size_t space = FreeTransmitSlots();
 
-    do
+    if(0 == space)
     {
-        const tPort8 messageCfg = GetByte(&sja1000Map_->RxTxFrInf);
+        transmitSpaceWanted_ = true;
+    }
 
-        receiveMessageBuf_[receiveMessageBufHead_].can_id = (messageCfg & (EXTENDED_FRAME_FORMAT | REMOTE_REQUEST)) << 24;
-        receiveMessageBuf_[receiveMessageBufHead_].len = messageCfg & DATA_LENGTH_MASK;
+    return space;
+}
 
-        size_t dataOffset = 2;
+//------------------------------------------------------------------------------------------------
 
-        if(messageCfg & EXTENDED_FRAME_FORMAT)
-        {
-            const auto canId = std::uint32_t((GetByte(&sja1000Map_->RxTxIdData[0]) << 21) |
-            		                         (GetByte(&sja1000Map_->RxTxIdData[1]) << 13) |
-											 (GetByte(&sja1000Map_->RxTxIdData[2]) << 5) |
-											 (GetByte(&sja1000Map_->RxTxIdData[3]) >> 3));
+std::size_t SJA1000CanController::FreeTransmitSlots() const
+{
+    return (transmitDataQueue_.Size() < transmitQueueDepth_) ? transmitQueueDepth_ - transmitDataQueue_.Size() : 0;
+}
+
+//------------------------------------------------------------------------------------------------
 
-            receiveMessageBuf_[receiveMessageBufHead_].can_id += canId;
+template <class Access>
+void SJA1000CanController::ReceiveMessage(Access& access)
+{
+    const std::uint64_t startReads = access.Reads();
+    unsigned frames = 0;
 
-            dataOffset = 4;
-        }
-        else
-        {
-        	const auto canId = std::uint32_t((GetByte(&sja1000Map_->RxTxIdData[0]) << 3) |
-        			                         (GetByte(&sja1000Map_->RxTxIdData[1]) >> 5));
+    if(ERD_MESSAGE_COUNT == receiveDrain_)
+    {
+        // the receive interrupt stands for one frame at least,
+        // frames arriving meanwhile keep it pending
+        unsigned messages = std::max(access.Get(&sja1000Map_->RxMsgCount) & RX_MESSAGE_COUNT_MASK, 1);
 
-        	receiveMessageBuf_[receiveMessageBufHead_].can_id += canId;
+        for(; messages != 0; --messages)
+        {
+            ReadReceiveBuffer(access);
+            ++frames;
         }
+    }
+    else
+    {
+        unsigned messages = MAX_RECEIVED_MESSAGES;
 
-        for(size_t i = 0; i < receiveMessageBuf_[receiveMessageBufHead_].len; ++i)
+        do
         {
-            receiveMessageBuf_[receiveMessageBufHead_].data[i] = GetByte(&sja1000Map_->RxTxIdData[i + dataOffset]);
-        }
+            ReadReceiveBuffer(access);
+            access.Get(&sja1000Map_->statusReg);
+            ++frames;
+
+        } while (((access.Get(&GetBasePtr()->statusReg) & CAN_SR_RBS) != 0) &&
+                (messages--));
+    }
+
+    receiveRegisterReads_ += access.Reads() - startReads;
+    receiveFrames_ += frames;
+}
+
+//------------------------------------------------------------------------------------------------
+
+template <class Access>
+inline void SJA1000CanController::ReadReceiveBuffer(Access& access)
+{
+    CanTimedFrame droppedFrame;
+    CanTimedFrame* timedFrame = receiveMessageBuf_.Reserve();
+
+    // the ring is full, the frame is still taken out of the chip but dropped
+    if(timedFrame == nullptr)
+    {
+        timedFrame = &droppedFrame;
+    }
+
+    timedFrame->timestamp_ = ClockCycles();
+
+    can_frame* canFrame = &timedFrame->frame_;
+
+    ReadFrame(access, *canFrame);
+
+    ChannelStats::Add(stats_.rxFrames_);
+    ChannelStats::Add(stats_.rxBytes_, canFrame->len);
+
+    if(timedFrame != &droppedFrame)
+    {
+        receiveMessageBuf_.Commit();
+    }
+    else
+    {
+        ChannelStats::Add(stats_.ringDrops_);
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+template <class Handler>
+inline void SJA1000CanController::WithRegisterAccess(Handler handler)
+{
+    if((directBase_ != nullptr) && (2 == directShift_))
+    {
+        DirectRegisterAccess<2> access(directBase_);
+        handler(access);
+        registerReads_.fetch_add(access.Reads(), std::memory_order_relaxed);
+    }
+    else if((directBase_ != nullptr) && (0 == directShift_))
+    {
+        DirectRegisterAccess<0> access(directBase_);
+        handler(access);
+        registerReads_.fetch_add(access.Reads(), std::memory_order_relaxed);
+    }
+    else
+    {
+        MapperRegisterAccess access(*chipMapper_);
+        handler(access);
+        registerReads_.fetch_add(access.Reads(), std::memory_order_relaxed);
+    }
+}
 
-        PutByte(&sja1000Map_->cmndReg, CAN_CM_RRB);
-        GetByte(&sja1000Map_->statusReg);
+//------------------------------------------------------------------------------------------------
+
+template <class Access>
+inline void SJA1000CanController::AddError(Access& access, std::uint8_t interrupt)
+{
+    ErrorEvent droppedEvent;
+    ErrorEvent* event = errorEventBuf_.Reserve();
+
+    // the ring is full, the captures are still released but the event is dropped
+    if(event == nullptr)
+    {
+        event = &droppedEvent;
+    }
 
-        ++receiveMessageBufHead_;
+    event->timestamp_ = ClockCycles();
+    event->interrupt_ = interrupt & ERROR_INTERRUPTS;
+    event->errorCode_ = (interrupt & CAN_IR_BEI) ? access.Get(&sja1000Map_->ErrCodeCap) : 0;
+    event->arbitrationLost_ = (interrupt & CAN_IR_ALI) ? access.Get(&sja1000Map_->ArbLostCap) : 0;
+    event->status_ = access.Get(&sja1000Map_->statusReg);
+    event->txErrors_ = access.Get(&sja1000Map_->TxErrCount);
+    event->rxErrors_ = access.Get(&sja1000Map_->RxErrCount);
+
+    if(interrupt & CAN_IR_BEI)
+    {
+        ChannelStats::Add(stats_.busErrors_);
 
-        if(receiveMessageBufHead_ == RECEIVE_BUFFER_SIZE)
+        switch(event->errorCode_ & CAN_ECC_TYPE_MASK)
         {
-            receiveMessageBufHead_ = 0;
+            case CAN_ECC_BIT:   ChannelStats::Add(stats_.bitErrors_);   break;
+            case CAN_ECC_FORM:  ChannelStats::Add(stats_.formErrors_);  break;
+            case CAN_ECC_STUFF: ChannelStats::Add(stats_.stuffErrors_); break;
+            default:            ChannelStats::Add(stats_.otherErrors_); break;
         }
+    }
+
+    if(interrupt & CAN_IR_ALI)
+    {
+        ChannelStats::Add(stats_.arbitrationLosses_);
+    }
+
+    if(interrupt & CAN_IR_ERRINT)
+    {
+        ChannelStats::Add(stats_.errorWarnings_);
+    }
 
-    } while (((GetByte(&GetBasePtr()->statusReg) & CAN_SR_RBS) != 0) &&
-            (messages--));
+    if(interrupt & CAN_IR_EPI)
+    {
+        ChannelStats::Add(stats_.errorPassives_);
+    }
+
+    if(interrupt & CAN_IR_OVERRUN)
+    {
+        ChannelStats::Add(stats_.hardwareOverruns_);
+    }
+
+    if(event != &droppedEvent)
+    {
+        errorEventBuf_.Commit();
+    }
+    else
+    {
+        ChannelStats::Add(stats_.ringDrops_);
+    }
 }
 
 //------------------------------------------------------------------------------------------------
 
-void SJA1000CanController::InterruptServiceRoutine()
+template <class Access>
+bool SJA1000CanController::ServiceChip(Access& access)
 {
-    EnterCmdRegWriteCriticalSection();
-
     bool hit = false;
 
     for (;;)
     {
-        const tPort8 ireg = GetByte(&(GetBasePtr())->intrReg);
+        const tPort8 ireg = access.Get(&(GetBasePtr())->intrReg);
 
 //        ControllerFactory::Instance().FinializeInterrupt();
 
-        if ((ireg & 0xF) == 0)
+        // reading the register cleared all but the receive interrupt
+        if (ireg == 0)
             break;
 
         if (ireg & CAN_IR_RX)
         {
-            ReceiveMessage();
+            ReceiveMessage(access);
             hit = true;
         }
 
         if (ireg & CAN_IR_TX)
         {
+            // an aborted frame which has not been sent is queued again
+            if (abortRequested_ && ((access.Get(&sja1000Map_->statusReg) & CAN_SR_TCS) == 0))
+            {
+                transmitAborted_ = true;
+            }
+            else
+            {
+                ChannelStats::Add(stats_.txFrames_);
+                ChannelStats::Add(stats_.txBytes_, transmitLength_);
+            }
+
             TransmitBufferFree();
             hit = true;
         }
 
-        if(ireg & (CAN_IR_BEI | CAN_IR_ALI | CAN_IR_EPI | CAN_IR_WUI | CAN_IR_OVERRUN | CAN_IR_ERRINT))
+        if(ireg & ERROR_INTERRUPTS)
         {
-            AddError(ireg);
+            AddError(access, ireg);
             hit = true;
 
             if (ireg & CAN_IR_OVERRUN)
             {
                 //Clear overrun status
-                PutByte(&(GetBasePtr())->cmndReg, CAN_CM_COS | CAN_CM_RRB);
+                access.Put(&(GetBasePtr())->cmndReg, CAN_CM_COS | CAN_CM_RRB);
             }
         }
     }
 
+    return hit;
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SJA1000CanController::InterruptServiceRoutine()
+{
+    EnterCmdRegWriteCriticalSection();
+
+    bool hit = false;
+
+    WithRegisterAccess([&](auto& access) { hit = this->ServiceChip(access); });
+
     LeaveCmdRegWriteCriticalSection();
 
     if(hit)
     {
-        MsgSendPulse(interruptChannel_.coid, SIGEV_PULSE_PRIO_INHERIT, INTERRUPT_PULSE, 0);
+        ChannelStats::Add(stats_.interrupts_);
+
+        if(EIM_SINGLE_HOP == interruptMode_)
+        {
+            ProcessBuffers();
+        }
+        else
+        {
+            interruptCycles_.store(ClockCycles(), std::memory_order_relaxed);
+
+            MsgSendPulse(interruptChannel_.coid, SIGEV_PULSE_PRIO_INHERIT, INTERRUPT_PULSE, 0);
+        }
     }
 }
 
 //------------------------------------------------------------------------------------------------
 
-inline void SJA1000CanController::AddError(std::uint8_t error)
+void SJA1000CanController::ProcessBuffers()
 {
-    errorMessageBuf_[errorBufHead_++] = error;
+    ProcessMessageBuffer();
+    ProcessErrorBuffer();
+    ProcessTransmitFlag();
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SJA1000CanController::ProcessErrorBuffer()
+{
+    // with a receive handler the events are published by ProcessMessageBuffer, in order with the frames
+    if(!receiveHandler_ && !errorEventBuf_.Empty())
+    {
+        std::unique_lock<std::mutex> lock(receiveMutex_);
+        notifyCycles_.store(ClockCycles(), std::memory_order_relaxed);
+        receiveCond_.notify_all();
+    }
 
-    if(errorBufHead_ == ERROR_BUFFER_SIZE)
+    const std::uint32_t overflows = errorEventBuf_.Overflows();
+
+    if(overflows != reportedErrorOverflows_)
     {
-        errorBufHead_ = 0;
+        LOG(error) << "Error buffer overflow, dropped events: " << (overflows - reportedErrorOverflows_);
+
+        reportedErrorOverflows_ = overflows;
     }
 }
 
 //------------------------------------------------------------------------------------------------
 
-void SJA1000CanController::ProcessErrorBuffer()
+void SJA1000CanController::TranslateError(const ErrorEvent& event, CanTimedFrame& timedFrame)
 {
-    while(errorBufHead_ != errorBufTail_)
+    can_frame& canFrame = timedFrame.frame_;
+
+    memset(&canFrame, 0, sizeof(canFrame));
+
+    timedFrame.timestamp_ = event.timestamp_;
+
+    canFrame.can_id = CAN_ERR_FLAG | CAN_ERR_CNT;
+    canFrame.len = CAN_ERR_DLC;
+    canFrame.data[6] = event.txErrors_;
+    canFrame.data[7] = event.rxErrors_;
+
+    if(event.interrupt_ & CAN_IR_OVERRUN)
     {
-        if (errorMessageBuf_[errorBufTail_] & CAN_IR_BEI)
-        {
-            auto capturedErrorCode = GetByte(&sja1000Map_->ErrCodeCap);
-            
-            std::string capturedError;
-            
-            switch (capturedErrorCode & 0xC0)
-            {
-                case 0x00 : capturedError + "bit error in "           ; break;
-                case 0x40 : capturedError + "form error in "          ; break;
-                case 0x80 : capturedError + "stuff error in "         ; break;
-                case 0xC0 : capturedError + "other type of error in " ; break;
-            }
+        canFrame.can_id |= CAN_ERR_CRTL;
+        canFrame.data[1] |= CAN_ERR_CRTL_RX_OVERFLOW;
+    }
 
-            switch (capturedErrorCode & 0x1F)
-            {
-                case 0x03 : capturedError + "start of frame"         ; break;
-                case 0x02 : capturedError + "ID.28 to ID.21"         ; break;
-                case 0x06 : capturedError + "ID.20 to ID.18"         ; break;
-                case 0x04 : capturedError + "bit SRTR"               ; break;
-                case 0x05 : capturedError + "bit IDE"                ; break;
-                case 0x07 : capturedError + "ID.17 to ID.13"         ; break;
-                case 0x0F : capturedError + "ID.12 to ID.5"          ; break;
-                case 0x0E : capturedError + "ID.4 to ID.0"           ; break;
-                case 0x0C : capturedError + "bit RTR"                ; break;
-                case 0x0D : capturedError + "reserved bit 1"         ; break;
-                case 0x09 : capturedError + "reserved bit 0"         ; break;
-                case 0x0B : capturedError + "data length code"       ; break;
-                case 0x0A : capturedError + "data ﬁeld"              ; break;
-                case 0x08 : capturedError + "CRC sequence"           ; break;
-                case 0x18 : capturedError + "CRC delimiter"          ; break;
-                case 0x19 : capturedError + "ackno wledge slot"      ; break;
-                case 0x1B : capturedError + "ackno wledge delimiter" ; break;
-                case 0x1A : capturedError + "end of frame"           ; break;
-                case 0x12 : capturedError + "intermission"           ; break;
-                case 0x11 : capturedError + "active error ﬂag"       ; break;
-                case 0x16 : capturedError + "passive error ﬂag"      ; break;
-                case 0x13 : capturedError + "tolerate dominant bits" ; break;
-                case 0x17 : capturedError + "error delimiter"        ; break;
-                case 0x1C : capturedError + "overload flag"          ; break;
-                default:    capturedError + "undefined position";
-            }
-    
-            LOG(error) << "Bus error: " << capturedError;
-        }
-        if (errorMessageBuf_[errorBufTail_] & CAN_IR_ALI)
-        {
-            auto arbLostBit = GetByte(&sja1000Map_->ArbLostCap);
-            LOG(error) << "Arbitration lost position: " << arbLostBit;
-        }
-        if (errorMessageBuf_[errorBufTail_] & CAN_IR_EPI)
-        {
-            LOG(error) << "Error passive";
-        }
-        if (errorMessageBuf_[errorBufTail_] & CAN_IR_WUI)
-        {
-            LOG(error) << "Wake-up";
-        }
-        if (errorMessageBuf_[errorBufTail_] & CAN_IR_OVERRUN)
-        {
-            LOG(error) << "Overrun";
-        }
-        if (errorMessageBuf_[errorBufTail_] & CAN_IR_ERRINT)
+    if(event.interrupt_ & CAN_IR_BEI)
+    {
+        canFrame.can_id |= CAN_ERR_PROT | CAN_ERR_BUSERROR;
+
+        switch(event.errorCode_ & CAN_ECC_TYPE_MASK)
         {
-            LOG(error) << "Error warning: "
-                       << " ErrWarLim: "  << std::dec << int(GetByte(&GetBasePtr()->ErrWarLim))
-                       << " RxErrCount: " << std::dec << int(GetByte(&GetBasePtr()->RxErrCount))
-                       << " TxErrCount: " << std::dec << int(GetByte(&GetBasePtr()->TxErrCount))
-                       << " RxMsgCount: " << std::dec << int(GetByte(&GetBasePtr()->RxMsgCount));
+            case CAN_ECC_BIT:   canFrame.data[2] |= CAN_ERR_PROT_BIT;   break;
+            case CAN_ECC_FORM:  canFrame.data[2] |= CAN_ERR_PROT_FORM;  break;
+            case CAN_ECC_STUFF: canFrame.data[2] |= CAN_ERR_PROT_STUFF; break;
+            default: break;
         }
 
-        errorBufTail_++;
+        canFrame.data[3] = event.errorCode_ & CAN_ECC_SEG_MASK;
 
-        if(errorBufTail_ == ERROR_BUFFER_SIZE)
+        if((event.errorCode_ & CAN_ECC_DIR) == 0)
         {
-            errorBufTail_ = 0;
+            canFrame.data[2] |= CAN_ERR_PROT_TX;
         }
     }
+
+    if(event.interrupt_ & CAN_IR_ALI)
+    {
+        canFrame.can_id |= CAN_ERR_LOSTARB;
+        canFrame.data[0] = event.arbitrationLost_ & CAN_ALC_BIT_MASK;
+    }
+
+    ErrorState state = ES_ACTIVE;
+
+    if(event.status_ & CAN_SR_BOS)
+    {
+        state = ES_BUS_OFF;
+    }
+    else if(std::max(event.txErrors_, event.rxErrors_) >= CAN_ERROR_PASSIVE_THRESHOLD)
+    {
+        state = ES_PASSIVE;
+    }
+    else if(event.status_ & CAN_SR_ES)
+    {
+        state = ES_WARNING;
+    }
+
+    if(state == errorState_)
+    {
+        return;
+    }
+
+    errorState_ = state;
+
+    // the direction with the higher counter has reached the state
+    const bool tx = event.txErrors_ >= event.rxErrors_;
+    const bool rx = event.txErrors_ <= event.rxErrors_;
+
+    switch(state)
+    {
+        case ES_ACTIVE:
+            canFrame.can_id |= CAN_ERR_CRTL;
+            canFrame.data[1] |= CAN_ERR_CRTL_ACTIVE;
+            break;
+
+        case ES_WARNING:
+            canFrame.can_id |= CAN_ERR_CRTL;
+            canFrame.data[1] |= (tx ? CAN_ERR_CRTL_TX_WARNING : 0) | (rx ? CAN_ERR_CRTL_RX_WARNING : 0);
+            break;
+
+        case ES_PASSIVE:
+            canFrame.can_id |= CAN_ERR_CRTL;
+            canFrame.data[1] |= (tx ? CAN_ERR_CRTL_TX_PASSIVE : 0) | (rx ? CAN_ERR_CRTL_RX_PASSIVE : 0);
+            break;
+
+        case ES_BUS_OFF:
+            canFrame.can_id |= CAN_ERR_BUSOFF;
+            ChannelStats::Add(stats_.busOffs_);
+
+            LOG(error) << "Bus off";
+            break;
+    }
 }
 
 //------------------------------------------------------------------------------------------------
 
-bool SJA1000CanController::ReadMessage(can_frame& canFrame)
+bool SJA1000CanController::ReadMessage(CanTimedFrame& canFrame)
 {
-    while(receiveMessageBufHead_ == receiveMessageBufTail_ && inited_)
+    std::unique_lock<std::mutex> lock(receiveMutex_);
+
+    // woken up by ProcessMessageBuffer, ProcessErrorBuffer or CloseController only
+    if(receiveMessageBuf_.Empty() && errorEventBuf_.Empty())
     {
-        std::unique_lock<std::mutex> lock(receiveMutex_);
-        receiveCond_.wait_for(lock, std::chrono::milliseconds(2));
+        receiveCond_.wait(lock, [this] { return !receiveMessageBuf_.Empty() || !errorEventBuf_.Empty() || !inited_; });
+
+        // a wakeup by CloseController has no notify time
+        if(inited_)
+        {
+            pulseToReaderTiming_.Add(ClockCycles() - notifyCycles_.load(std::memory_order_relaxed));
+        }
     }
 
     if(!inited_)
@@ -441,13 +983,33 @@ bool SJA1000CanController::ReadMessage(can_frame& canFrame)
     	return false;
     }
 
-    canFrame = receiveMessageBuf_[receiveMessageBufTail_++];
+    return PopReceived(canFrame);
+}
+
+//------------------------------------------------------------------------------------------------
+
+bool SJA1000CanController::PopReceived(CanTimedFrame& timedFrame)
+{
+    // the frame ring is read first: an event committed before the front frame is visible then
+    const CanTimedFrame* canFrame = receiveMessageBuf_.Front();
+    const ErrorEvent* event = errorEventBuf_.Front();
 
-    if(receiveMessageBufTail_ == RECEIVE_BUFFER_SIZE)
+    if((event != nullptr) && ((canFrame == nullptr) || (event->timestamp_ < canFrame->timestamp_)))
     {
-        receiveMessageBufTail_ = 0;
+        TranslateError(*event, timedFrame);
+        errorEventBuf_.Pop();
+
+        return true;
     }
 
+    if(canFrame == nullptr)
+    {
+        return false;
+    }
+
+    timedFrame = *canFrame;
+    receiveMessageBuf_.Pop();
+
     return true;
 }
 
@@ -455,31 +1017,48 @@ bool SJA1000CanController::ReadMessage(can_frame& canFrame)
 
 void SJA1000CanController::ProcessMessageBuffer()
 {
-    if(receiveMessageBufHead_ != receiveMessageBufTail_)
+    if(receiveHandler_)
+    {
+        // publish directly from this thread, error frames in between
+        CanTimedFrame timedFrame;
+
+        while(PopReceived(timedFrame))
+        {
+            receiveHandler_(timedFrame);
+        }
+    }
+    else if(!receiveMessageBuf_.Empty())
     {
         std::unique_lock<std::mutex> lock(receiveMutex_);
+        notifyCycles_.store(ClockCycles(), std::memory_order_relaxed);
         receiveCond_.notify_all();
     }
+
+    const std::uint32_t overflows = receiveMessageBuf_.Overflows();
+
+    if(overflows != reportedOverflows_)
+    {
+        LOG(error) << "Receive buffer overflow, dropped frames: " << (overflows - reportedOverflows_);
+
+        reportedOverflows_ = overflows;
+    }
 }
 
 //------------------------------------------------------------------------------------------------
 
 void SJA1000CanController::InterruptHandleTh()
 {
-    const std::uint64_t timeout = 100'000'000ULL;
-
     while(1)
     {
-        sigevent event;
-        event.sigev_notify = SIGEV_UNBLOCK;
         _pulse incomePulse;
 
-        TimerTimeout(CLOCK_REALTIME, _NTO_TIMEOUT_RECEIVE, &event, &timeout, 0);
-
-        MsgReceivePulse(interruptChannel_.chid,
+        if(MsgReceivePulse(interruptChannel_.chid,
                 &incomePulse,
                 sizeof(incomePulse),
-                0);
+                0) == -1)
+        {
+            continue;
+        }
 
         switch(incomePulse.code)
         {
@@ -488,9 +1067,10 @@ void SJA1000CanController::InterruptHandleTh()
                 return;
 
             case INTERRUPT_PULSE:
-                ProcessMessageBuffer();
-                ProcessErrorBuffer();
-                ProcessTransmitFlag();
+                interruptToPulseTiming_.Add(ClockCycles() - interruptCycles_.load(std::memory_order_relaxed));
+                ChannelStats::Add(stats_.pulses_);
+
+                ProcessBuffers();
                 break;
 
             default:
@@ -501,61 +1081,220 @@ void SJA1000CanController::InterruptHandleTh()
 
 //------------------------------------------------------------------------------------------------
 
+void SJA1000CanController::ReportTimings() const
+{
+    interruptToPulseTiming_.Report();
+    pulseToReaderTiming_.Report();
+    inversionTiming_.Report();
+
+    if(0 != priorityInversions_)
+    {
+        LOG(info) << "Priority inversions: " << priorityInversions_
+                  << " aborted transmissions: " << abortRequests_
+                  << " requeued frames: " << requeuedFrames_;
+    }
+
+    if(0 != receiveFrames_)
+    {
+        LOG(info) << "Received frames: " << receiveFrames_
+                  << " register reads per frame: " << std::fixed << std::setprecision(2)
+                  << double(receiveRegisterReads_) / receiveFrames_;
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
 void SJA1000CanController::ProcessTransmitFlag()
 {
     std::unique_lock<std::mutex> lock(transmitMutex_);
 
-    if(transmitBufferFree_ && !transmitDataQueue_.empty())
+    can_frame canFrame;
+
+    if(transmitBufferFree_)
     {
-        can_frame canFrame = transmitDataQueue_.top();
-        transmitDataQueue_.pop();
-        TransmitMessage(canFrame);
+        ApplyAcceptanceFilter();
+
+        RequeueAbortedFrame();
+
+        if(NextTransmitFrame(canFrame))
+        {
+            TransmitMessage(canFrame);
+        }
+    }
+    else
+    {
+        // transmit sources may have got frames
+        CheckPriorityInversion();
+    }
+
+    if(transmitSpaceWanted_ && (0 != FreeTransmitSlots()))
+    {
+        transmitSpaceWanted_ = false;
+
+        lock.unlock();
+
+        // the handler may write again
+        if(transmitSpaceHandler_)
+        {
+            transmitSpaceHandler_();
+        }
     }
 }
 
 //------------------------------------------------------------------------------------------------
 
-std::uint8_t SJA1000CanController::TransmitMessage(const can_frame& canFrame)
+const can_frame* SJA1000CanController::PeekTransmitFrame(TransmitSource*& nextSource)
 {
-    std::uint8_t value = 0;
+    nextSource = nullptr;
+    const can_frame* next = transmitDataQueue_.Empty() ? nullptr : &transmitDataQueue_.Front();
 
-    EnterCmdRegWriteCriticalSection();
+    for(auto source: transmitSources_)
+    {
+        const can_frame* front = source->Front();
 
-    transmitBufferFree_ = false;
+        if((front != nullptr) && ((next == nullptr) || TransmitQueue::HigherPriority(*front, *next)))
+        {
+            next = front;
+            nextSource = source;
+        }
+    }
 
-    const std::uint8_t rxTxFrInf = (((canFrame.can_id >> 24) & (EXTENDED_FRAME_FORMAT | REMOTE_REQUEST)) |
-            (canFrame.len & DATA_LENGTH_MASK));
+    return next;
+}
 
-    PutByte(&sja1000Map_->RxTxFrInf, rxTxFrInf);
-    
-    size_t dataOffset = 2;
+//------------------------------------------------------------------------------------------------
+
+bool SJA1000CanController::NextTransmitFrame(can_frame& canFrame)
+{
+    TransmitSource* nextSource = nullptr;
+    const can_frame* next = PeekTransmitFrame(nextSource);
 
-    if(canFrame.can_id & CAN_EFF_FLAG)
+    if(next == nullptr)
     {
-    	const std::uint32_t arbitration = (canFrame.can_id & CAN_EFF_MASK) << 3;
+        return false;
+    }
 
-        PutByte(&sja1000Map_->RxTxIdData[0], (arbitration >> 24) & 0xFF);
-        PutByte(&sja1000Map_->RxTxIdData[1], (arbitration >> 16) & 0xFF);
-        PutByte(&sja1000Map_->RxTxIdData[2], (arbitration >> 8) & 0xFF);
-        PutByte(&sja1000Map_->RxTxIdData[3], arbitration & 0xFF);
+    canFrame = *next;
 
-        dataOffset = 4;
+    if(nextSource != nullptr)
+    {
+        nextSource->Pop();
     }
     else
     {
-    	const std::uint32_t arbitration = (canFrame.can_id & CAN_SFF_MASK) << 5;
+        transmitDataQueue_.Pop();
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SJA1000CanController::AddTransmitSource(TransmitSource* source)
+{
+    std::unique_lock<std::mutex> lock(transmitMutex_);
+
+    transmitSources_.push_back(source);
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SJA1000CanController::RemoveTransmitSource(TransmitSource* source)
+{
+    std::unique_lock<std::mutex> lock(transmitMutex_);
+
+    transmitSources_.erase(std::remove(transmitSources_.begin(), transmitSources_.end(), source), transmitSources_.end());
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SJA1000CanController::KickTransmit()
+{
+    ProcessTransmitFlag();
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SJA1000CanController::CheckPriorityInversion()
+{
+    if(transmitBufferFree_ || (0 != inversionStart_))
+    {
+        return;
+    }
+
+    TransmitSource* source = nullptr;
+    const can_frame* next = PeekTransmitFrame(source);
+
+    if((next == nullptr) || !TransmitQueue::HigherPriority(*next, transmitFrame_))
+    {
+        return;
+    }
+
+    inversionStart_ = ClockCycles();
+    ++priorityInversions_;
+
+    if(ETS_PREEMPT == transmitScheduling_)
+    {
+        AbortTransmission();
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SJA1000CanController::AbortTransmission()
+{
+    // a transmission in progress is not cancelled, it completes or fails
+    // and is not repeated; the interrupt tells which
+    EnterCmdRegWriteCriticalSection();
+
+    if(!transmitBufferFree_ && !abortRequested_)
+    {
+        abortRequested_ = true;
+        PutByte(&sja1000Map_->cmndReg, CAN_CM_AT);
+        ++abortRequests_;
+    }
+
+    LeaveCmdRegWriteCriticalSection();
+}
+
+//------------------------------------------------------------------------------------------------
+
+void SJA1000CanController::RequeueAbortedFrame()
+{
+    if(transmitAborted_)
+    {
+        transmitAborted_ = false;
 
-        PutByte(&sja1000Map_->RxTxIdData[0], (arbitration >> 8) & 0xFF);
-        PutByte(&sja1000Map_->RxTxIdData[1], arbitration & 0xFF);
+        // ahead of the later frames with the same identifier
+        transmitDataQueue_.PushFront(transmitFrame_);
+        ++requeuedFrames_;
+
+        ChannelStats::Max(stats_.txQueueHighWater_, transmitDataQueue_.Size());
     }
+}
 
-    for(size_t i = 0; i < canFrame.len; ++i)
+//------------------------------------------------------------------------------------------------
+
+std::uint8_t SJA1000CanController::TransmitMessage(const can_frame& canFrame)
+{
+    std::uint8_t value = 0;
+
+    // the frame waiting for the transmit buffer gets it now
+    if(0 != inversionStart_)
     {
-        PutByte(&sja1000Map_->RxTxIdData[i + dataOffset], canFrame.data[i]);
+        inversionTiming_.Add(ClockCycles() - inversionStart_);
+        inversionStart_ = 0;
     }
 
-    PutByte(&sja1000Map_->cmndReg, CAN_CM_TR);
-    value = GetByte(&sja1000Map_->statusReg);
+    transmitFrame_ = canFrame;
+
+    EnterCmdRegWriteCriticalSection();
+
+    transmitBufferFree_ = false;
+    abortRequested_ = false;
+    transmitLength_ = canFrame.len;
+
+    WithRegisterAccess([&](auto& access) { value = this->WriteFrame(access, canFrame); });
 
     LeaveCmdRegWriteCriticalSection();
 
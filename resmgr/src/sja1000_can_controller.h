@@ -2,7 +2,6 @@
 
 #include <atomic>
 #include <thread>
-#include <queue>
 #include <vector>
 #include <memory>
 #include <mutex>
@@ -12,10 +11,15 @@
 #include <sys/neutrino.h>
 
 #include "can_controller.h"
+#include "register_access.h"
+#include "sja1000_registers.h"
+#include "spsc_ring.h"
+#include "stage_timing.h"
+#include "transmit_queue.h"
 
 //------------------------------------------------------------------------------------------------
 
-class SJA1000CanController : public CanController
+class SJA1000CanController : public CanController, private SJA1000Registers
 {
 public:
     
@@ -28,120 +32,140 @@ public:
 
     virtual bool WriteMessage(const can_frame& canFrame);
 
-    virtual bool ReadMessage(can_frame& canFrame);
+    virtual std::size_t WriteMessages(const can_frame* canFrames, std::size_t count);
+
+    virtual std::size_t TransmitQueueSpace();
+
+    virtual bool ReadMessage(CanTimedFrame& canFrame);
+
+    virtual void ReportTimings() const;
+
+    virtual void SetAcceptanceFilter(const std::vector<can_filter>& filters);
+
+    virtual void AddTransmitSource(TransmitSource* source);
+    virtual void RemoveTransmitSource(TransmitSource* source);
+
+    virtual void KickTransmit();
 
 private:
 
-    enum ModeRegister
-    {
-        CAN_MR_SM          = 0x10, // Sleep mode 
-        CAN_MR_AFM         = 0x08, // Acceptance filter mode
-        CAN_MR_STM         = 0x04, // Self test mode
-        CAN_MR_LOM         = 0x02, // Listen only mode
-        CAN_MR_RM          = 0x01  // Reset mode
-    };
+    // Mapped chip memory and address shift for the direct register access
+    volatile std::uint8_t* directBase_;
+    std::uint8_t directShift_;
 
-    enum ClkDivideRegister
-    {
-        CAN_CDR_CANM       = 0x80, // Set for PeliCAN mode
-        CAN_CDR_CBP        = 0x40, // Bypass CAN input
-        CAN_CDR_RXINTEN    = 0x20, // TX1 output to be used as a dedicated receive interrupt output
-        CAN_CDR_CLKOFF     = 0x08  // Clock off
-    };
+    // Calls handler(access) with the fastest register accessor of the chip mapper
+    template <class Handler>
+    void WithRegisterAccess(Handler handler);
 
-    enum StatusRegister
-    {
-        CAN_SR_BOS         = 0x80, // Bus off
-        CAN_SR_ES          = 0x40, // Error status
-        CAN_SR_TS          = 0x20, // Transmitting a message
-        CAN_SR_RS          = 0x10, // Receiving a message
-        CAN_SR_TCS         = 0x08, // Transmission complete
-        CAN_SR_TBS         = 0x04, // Transmit buffer status
-        CAN_SR_DOS         = 0x02, // Data overrun status
-        CAN_SR_RBS         = 0x01  // Receive buffer status
-    };
+    // Hot paths, instantiated for every register accessor
+    template <class Access>
+    bool ServiceChip(Access& access);
 
-    enum ComandRegister
-    {
-        CAN_CM_COS         = 0x08, // Clear overrun status
-        CAN_CM_RRB         = 0x04, // Release receive buffer
-        CAN_CM_AT          = 0x02, // Abort transmission
-        CAN_CM_TR          = 0x01  // Transmission request
-    };
+    template <class Access>
+    void ReceiveMessage(Access& access);
+
+    // Take one frame out of the receive FIFO into the receive ring
+    template <class Access>
+    void ReadReceiveBuffer(Access& access);
 
-    enum InterruptRegister
+    // Acceptance code and mask registers, programmed in reset mode
+    struct AcceptanceFilter
     {
-        CAN_IR_BEI         = 0x80, // Bus error interrupt
-        CAN_IR_ALI         = 0x40, // Arbitration lost interrupt
-        CAN_IR_EPI         = 0x20, // Error Passive interrupt
-        CAN_IR_WUI         = 0x10, // Wake-up interrupt
-        CAN_IR_OVERRUN     = 0x08, // Overrun interrupt
-        CAN_IR_ERRINT      = 0x04, // Error interrupt
-        CAN_IR_TX          = 0x02, // TX interrupt
-        CAN_IR_RX          = 0x01  // RX interrupt
+        bool dual_;
+        std::uint8_t code_[4];
+        std::uint8_t mask_[4];
     };
 
-    enum MessageConfigurationRegister
-	{
-    	EXTENDED_FRAME_FORMAT	= 0x80,
-    	REMOTE_REQUEST			= 0x40,
-		DATA_LENGTH_MASK 		= 0x0F
-	};
+    static AcceptanceFilter ComputeAcceptanceFilter(const std::vector<can_filter>& filters);
 
-    #pragma pack(push,1)
-    struct SJA1000Map
-    {
-        tPort8 ModeReg;            // 00 Mode register
-        tPort8 cmndReg;            // 01 command register
-        tPort8 statusReg;          // 02 status register
-        tPort8 intrReg;            // 03 interrupt register
-        tPort8 intrEnReg;          // 04 interrupt enable register
-        tPort8 Reserved;           // 05 Reserved
-        tPort8 busTim0;            // 06 bus timing register 0
-        tPort8 busTim1;            // 07 bus timing register 1
-        tPort8 outCtrl;            // 08 output Control
-        tPort8 testReg;            // 09 test register
-        tPort8 Reserved1;          // 0A Reserved
-        tPort8 ArbLostCap;         // 0B arbitration lost capture
-        tPort8 ErrCodeCap;         // 0C error code capture
-        tPort8 ErrWarLim;          // 0D error warning limit
-        tPort8 RxErrCount;         // 0E RX error counter
-        tPort8 TxErrCount;         // 0F TX error counter
-        tPort8 RxTxFrInf;          // 10 for Read RX frame information, for Write TX frame information(Operation mode)
-                                   // acceptence code 0 (Reset mode)
-        tPort8 RxTxIdData[12];     // 11-1C for Read RX identifier and data, for Read TX identifier and data
-                                   // 1D acceptence code 1-3 and acceptence mask 0-3 (Reset mode)
-        tPort8 RxMsgCount;         // 1E RX message counter
-        tPort8 RxBufStartAddr;     // 1F RX buffer start address
-        tPort8 clkDiv;             // 20 clock divider
-        tPort8 IntrlRamAddr[64];   // 21-... internal RAM address
-        tPort8 IntrlRamAddrTx[13]; // internal RAM address TX buffer
-    } ;
-    #pragma pack(pop) 
-
-    SJA1000Map* sja1000Map_;
+    void WriteAcceptanceFilter();
+
+    // Programs the pending filter, transmitMutex_ must be locked and the transmit buffer free.
+    // Reset mode flushes the receive FIFO: frames not yet read from the chip are lost.
+    void ApplyAcceptanceFilter();
+
+    // Time SetAcceptanceFilter waits for the aborted transmission before it enters reset mode anyway
+    static const std::uint32_t ACCEPTANCE_FILTER_TIMEOUT_MS = 20;
+
+    AcceptanceFilter acceptanceFilter_;
+
+    // Filter waiting for the transmit buffer to become free, under transmitMutex_
+    AcceptanceFilter pendingAcceptanceFilter_;
+    bool acceptanceFilterPending_;
+
+    // Signalled when the pending filter has been programmed
+    std::condition_variable acceptanceCond_;
 
     static const unsigned  RECEIVE_BUFFER_SIZE = 1024;
     static const unsigned  ERROR_BUFFER_SIZE = 1024;
     static const unsigned  MAX_RECEIVED_MESSAGES = 8;
 
+    // Valid bits of RxMsgCount
+    static const std::uint8_t RX_MESSAGE_COUNT_MASK = 0x1F;
+
     std::uint8_t TransmitMessage(const can_frame& canFrame);
 
     virtual void InterruptServiceRoutine();
 
     virtual void InterruptHandleTh();
 
+    void ProcessBuffers();
     void ProcessErrorBuffer();
     void ProcessMessageBuffer();
     void ProcessTransmitFlag();
 
-    can_frame receiveMessageBuf_[RECEIVE_BUFFER_SIZE];
-    std::atomic_uint receiveMessageBufHead_;
-    std::atomic_uint receiveMessageBufTail_;
+    // Take the older of the front frame and the front error event, so frames and
+    // error frames are consumed in the order the interrupt handling thread saw them
+    bool PopReceived(CanTimedFrame& timedFrame);
+
+    // Filled by the interrupt handling thread, drained by ReadMessage
+    SpscRing<CanTimedFrame, RECEIVE_BUFFER_SIZE> receiveMessageBuf_;
+    std::uint32_t reportedOverflows_;
 
-    std::uint8_t errorMessageBuf_[ERROR_BUFFER_SIZE];
-    std::atomic_uint errorBufHead_;
-    std::atomic_uint errorBufTail_;
+    // Register reads of the receive path, written by the interrupt handling thread
+    std::uint64_t receiveRegisterReads_;
+    std::uint64_t receiveFrames_;
+
+    // Per stage receive latency
+    std::atomic<std::uint64_t> interruptCycles_;
+    std::atomic<std::uint64_t> notifyCycles_;
+    StageTiming interruptToPulseTiming_;
+    StageTiming pulseToReaderTiming_;
+
+    // Error interrupt with the registers belonging to it. They are read in the
+    // interrupt, which also releases the captures for the next error
+    struct ErrorEvent
+    {
+        std::uint64_t timestamp_;
+        std::uint8_t interrupt_;        // error bits of intrReg
+        std::uint8_t status_;
+        std::uint8_t errorCode_;        // ErrCodeCap, valid with CAN_IR_BEI
+        std::uint8_t arbitrationLost_;  // ArbLostCap, valid with CAN_IR_ALI
+        std::uint8_t txErrors_;
+        std::uint8_t rxErrors_;
+    };
+
+    // Interrupts which are put to errorEventBuf_
+    static const std::uint8_t ERROR_INTERRUPTS = CAN_IR_BEI | CAN_IR_ALI | CAN_IR_EPI | CAN_IR_OVERRUN | CAN_IR_ERRINT;
+
+    enum ErrorState
+    {
+        ES_ACTIVE,
+        ES_WARNING,
+        ES_PASSIVE,
+        ES_BUS_OFF
+    };
+
+    // Build the CAN_ERR_FLAG frame of the event, a change of the error state is reported once.
+    // Called by the consumer of errorEventBuf_ only
+    void TranslateError(const ErrorEvent& event, CanTimedFrame& timedFrame);
+
+    // Filled by the interrupt handling thread, drained with receiveMessageBuf_
+    SpscRing<ErrorEvent, ERROR_BUFFER_SIZE> errorEventBuf_;
+    std::uint32_t reportedErrorOverflows_;
+
+    // State of the last error frame
+    ErrorState errorState_;
 
     sigevent intSignal_;
     CChannel interruptChannel_;
@@ -152,20 +176,61 @@ private:
     std::mutex transmitMutex_;
     std::condition_variable transmitCond_;
 
-    struct Comp
-    {
-    	bool operator() (const can_frame& lhs, const can_frame& rhs)
-		{
-			return (lhs.can_id & CAN_EFF_MASK) > (rhs.can_id & CAN_EFF_MASK);
-		};
-    };
+    // Arbitration order, FIFO for equal identifiers
+    TransmitQueue transmitDataQueue_;
+
+    std::vector<TransmitSource*> transmitSources_;
+
+    // A writer found the transmit queue full, protected by transmitMutex_
+    bool transmitSpaceWanted_;
+
+    // Frames the queue accepts now, transmitMutex_ must be locked
+    std::size_t FreeTransmitSlots() const;
 
-    std::priority_queue<can_frame, std::vector<can_frame>, Comp> transmitDataQueue_;
+    // Takes the frame of the highest priority from the queue and the sources,
+    // transmitMutex_ must be locked
+    bool NextTransmitFrame(can_frame& canFrame);
+
+    // The frame NextTransmitFrame would take and its source, nullptr for the queue
+    const can_frame* PeekTransmitFrame(TransmitSource*& source);
+
+    // A higher priority frame waits behind the frame in the transmit buffer:
+    // start the inversion time, abort the transmission in ETS_PREEMPT mode.
+    // transmitMutex_ must be locked
+    void CheckPriorityInversion();
+
+    // Issue the abort transmission command once for the frame in the transmit buffer
+    void AbortTransmission();
+
+    // Queue the frame of an aborted transmission again, transmitMutex_ must be locked
+    void RequeueAbortedFrame();
+
+    // Frame in the transmit buffer, protected by transmitMutex_
+    can_frame transmitFrame_;
+
+    // Abort transmission command issued for transmitFrame_
+    std::atomic_bool abortRequested_;
+
+    // The interrupt found the aborted frame not sent
+    std::atomic_bool transmitAborted_;
+
+    // Start of the current priority inversion, 0 if none
+    std::uint64_t inversionStart_;
+
+    std::uint64_t priorityInversions_;
+    std::uint64_t abortRequests_;
+    std::uint64_t requeuedFrames_;
+
+    // Time a higher priority frame waits for the transmit buffer
+    StageTiming inversionTiming_;
 
     intrspin_t interruptSpinLock_;
 
     std::atomic_bool transmitBufferFree_;
 
+    // Data length of the frame in the transmit buffer, under the interrupt spin lock
+    std::uint8_t transmitLength_;
+
 protected:
 
     enum 
@@ -176,13 +241,12 @@ protected:
 
     virtual bool IsThereDevice();
 
-    inline void ReceiveMessage();
-
     inline const SJA1000Map* GetBasePtr() { return sja1000Map_; }
 
     inline void TransmitBufferFree() { transmitBufferFree_ = true; }
 
-    inline void AddError(std::uint8_t error);
+    template <class Access>
+    inline void AddError(Access& access, std::uint8_t interrupt);
 
     inline void EnterCmdRegWriteCriticalSection() { InterruptLock(&interruptSpinLock_); }
     inline void LeaveCmdRegWriteCriticalSection() { InterruptUnlock(&interruptSpinLock_); }
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include <can.h>
+
+#include "chip_ports.h"
+
+//------------------------------------------------------------------------------------------------
+// SJA1000 PeliCAN registers and the copy of a frame between can_frame and the frame
+// information, identifier and data registers. The copy runs on any register accessor of
+// register_access.h and needs no QNX, so the accessors are benchmarked on the host.
+//------------------------------------------------------------------------------------------------
+
+class SJA1000Registers
+{
+public:
+
+    enum ModeRegister
+    {
+        CAN_MR_SM          = 0x10, // Sleep mode 
+        CAN_MR_AFM         = 0x08, // Acceptance filter mode
+        CAN_MR_STM         = 0x04, // Self test mode
+        CAN_MR_LOM         = 0x02, // Listen only mode
+        CAN_MR_RM          = 0x01  // Reset mode
+    };
+
+    enum ClkDivideRegister
+    {
+        CAN_CDR_CANM       = 0x80, // Set for PeliCAN mode
+        CAN_CDR_CBP        = 0x40, // Bypass CAN input
+        CAN_CDR_RXINTEN    = 0x20, // TX1 output to be used as a dedicated receive interrupt output
+        CAN_CDR_CLKOFF     = 0x08  // Clock off
+    };
+
+    enum StatusRegister
+    {
+        CAN_SR_BOS         = 0x80, // Bus off
+        CAN_SR_ES          = 0x40, // Error status
+        CAN_SR_TS          = 0x20, // Transmitting a message
+        CAN_SR_RS          = 0x10, // Receiving a message
+        CAN_SR_TCS         = 0x08, // Transmission complete
+        CAN_SR_TBS         = 0x04, // Transmit buffer status
+        CAN_SR_DOS         = 0x02, // Data overrun status
+        CAN_SR_RBS         = 0x01  // Receive buffer status
+    };
+
+    enum ComandRegister
+    {
+        CAN_CM_COS         = 0x08, // Clear overrun status
+        CAN_CM_RRB         = 0x04, // Release receive buffer
+        CAN_CM_AT          = 0x02, // Abort transmission
+        CAN_CM_TR          = 0x01  // Transmission request
+    };
+
+    enum InterruptRegister
+    {
+        CAN_IR_BEI         = 0x80, // Bus error interrupt
+        CAN_IR_ALI         = 0x40, // Arbitration lost interrupt
+        CAN_IR_EPI         = 0x20, // Error Passive interrupt
+        CAN_IR_WUI         = 0x10, // Wake-up interrupt
+        CAN_IR_OVERRUN     = 0x08, // Overrun interrupt
+        CAN_IR_ERRINT      = 0x04, // Error interrupt
+        CAN_IR_TX          = 0x02, // TX interrupt
+        CAN_IR_RX          = 0x01  // RX interrupt
+    };
+
+    enum ErrorCodeCaptureRegister
+    {
+        CAN_ECC_TYPE_MASK  = 0xC0, // Error type
+        CAN_ECC_BIT        = 0x00, // Bit error
+        CAN_ECC_FORM       = 0x40, // Form error
+        CAN_ECC_STUFF      = 0x80, // Stuff error
+        CAN_ECC_DIR        = 0x20, // Set for an error during reception
+        CAN_ECC_SEG_MASK   = 0x1F  // Position in the frame, equal to CAN_ERR_PROT_LOC_*
+    };
+
+    // Bit position of the lost arbitration in ArbLostCap
+    static const std::uint8_t CAN_ALC_BIT_MASK = 0x1F;
+
+    enum MessageConfigurationRegister
+	{
+    	EXTENDED_FRAME_FORMAT	= 0x80,
+    	REMOTE_REQUEST			= 0x40,
+		DATA_LENGTH_MASK 		= 0x0F
+	};
+
+    #pragma pack(push,1)
+    struct SJA1000Map
+    {
+        tPort8 ModeReg;            // 00 Mode register
+        tPort8 cmndReg;            // 01 command register
+        tPort8 statusReg;          // 02 status register
+        tPort8 intrReg;            // 03 interrupt register
+        tPort8 intrEnReg;          // 04 interrupt enable register
+        tPort8 Reserved;           // 05 Reserved
+        tPort8 busTim0;            // 06 bus timing register 0
+        tPort8 busTim1;            // 07 bus timing register 1
+        tPort8 outCtrl;            // 08 output Control
+        tPort8 testReg;            // 09 test register
+        tPort8 Reserved1;          // 0A Reserved
+        tPort8 ArbLostCap;         // 0B arbitration lost capture
+        tPort8 ErrCodeCap;         // 0C error code capture
+        tPort8 ErrWarLim;          // 0D error warning limit
+        tPort8 RxErrCount;         // 0E RX error counter
+        tPort8 TxErrCount;         // 0F TX error counter
+        tPort8 RxTxFrInf;          // 10 for Read RX frame information, for Write TX frame information(Operation mode)
+                                   // acceptence code 0 (Reset mode)
+        tPort8 RxTxIdData[12];     // 11-1C for Read RX identifier and data, for Read TX identifier and data
+                                   // 1D acceptence code 1-3 and acceptence mask 0-3 (Reset mode)
+        tPort8 RxMsgCount;         // 1E RX message counter
+        tPort8 RxBufStartAddr;     // 1F RX buffer start address
+        tPort8 clkDiv;             // 20 clock divider
+        tPort8 IntrlRamAddr[64];   // 21-... internal RAM address
+        tPort8 IntrlRamAddrTx[13]; // internal RAM address TX buffer
+    } ;
+    #pragma pack(pop) 
+
+    // Registers are addressed by their offset, the map is placed at 0
+    static constexpr SJA1000Map* sja1000Map_ = nullptr;
+
+    // Take the frame in the receive buffer and release it
+    template <class Access>
+    static void ReadFrame(Access& access, can_frame& canFrame);
+
+    // Fill the transmit buffer and request the transmission, returns the status register
+    template <class Access>
+    static std::uint8_t WriteFrame(Access& access, const can_frame& canFrame);
+};
+
+//------------------------------------------------------------------------------------------------
+
+template <class Access>
+inline void SJA1000Registers::ReadFrame(Access& access, can_frame& canFrame)
+{
+    const tPort8 messageCfg = access.Get(&sja1000Map_->RxTxFrInf);
+
+    canFrame.can_id = (messageCfg & (EXTENDED_FRAME_FORMAT | REMOTE_REQUEST)) << 24;
+    canFrame.len = std::min<std::uint8_t>(messageCfg & DATA_LENGTH_MASK, CAN_MAX_DLEN);
+
+    // identifier and data in one block, only the bytes the frame uses
+    std::uint8_t idData[sizeof(SJA1000Map::RxTxIdData)];
+
+    if(messageCfg & EXTENDED_FRAME_FORMAT)
+    {
+        access.GetBlock(&sja1000Map_->RxTxIdData[0], idData, 4 + canFrame.len);
+
+        const auto canId = std::uint32_t((idData[0] << 21) |
+                                         (idData[1] << 13) |
+                                         (idData[2] << 5) |
+                                         (idData[3] >> 3));
+
+        canFrame.can_id += canId;
+
+        std::copy(idData + 4, idData + 4 + canFrame.len, canFrame.data);
+    }
+    else
+    {
+        access.GetBlock(&sja1000Map_->RxTxIdData[0], idData, 2 + canFrame.len);
+
+        const auto canId = std::uint32_t((idData[0] << 3) |
+                                         (idData[1] >> 5));
+
+        canFrame.can_id += canId;
+
+        std::copy(idData + 2, idData + 2 + canFrame.len, canFrame.data);
+    }
+
+    access.Put(&sja1000Map_->cmndReg, CAN_CM_RRB);
+}
+
+//------------------------------------------------------------------------------------------------
+
+template <class Access>
+inline std::uint8_t SJA1000Registers::WriteFrame(Access& access, const can_frame& canFrame)
+{
+    const std::uint8_t rxTxFrInf = (((canFrame.can_id >> 24) & (EXTENDED_FRAME_FORMAT | REMOTE_REQUEST)) |
+            (canFrame.len & DATA_LENGTH_MASK));
+
+    // frame information, identifier and data are consecutive registers
+    std::uint8_t frame[1 + sizeof(SJA1000Map::RxTxIdData)];
+
+    frame[0] = rxTxFrInf;
+
+    const std::uint8_t len = std::min<std::uint8_t>(canFrame.len, CAN_MAX_DLEN);
+
+    std::size_t dataOffset = 3;
+
+    if(canFrame.can_id & CAN_EFF_FLAG)
+    {
+    	const std::uint32_t arbitration = (canFrame.can_id & CAN_EFF_MASK) << 3;
+
+        frame[1] = (arbitration >> 24) & 0xFF;
+        frame[2] = (arbitration >> 16) & 0xFF;
+        frame[3] = (arbitration >> 8) & 0xFF;
+        frame[4] = arbitration & 0xFF;
+
+        dataOffset = 5;
+    }
+    else
+    {
+    	const std::uint32_t arbitration = (canFrame.can_id & CAN_SFF_MASK) << 5;
+
+        frame[1] = (arbitration >> 8) & 0xFF;
+        frame[2] = arbitration & 0xFF;
+    }
+
+    std::copy(canFrame.data, canFrame.data + len, frame + dataOffset);
+
+    access.PutBlock(&sja1000Map_->RxTxFrInf, frame, dataOffset + len);
+
+    access.Put(&sja1000Map_->cmndReg, CAN_CM_TR);
+    return access.Get(&sja1000Map_->statusReg);
+}
+
+//------------------------------------------------------------------------------------------------
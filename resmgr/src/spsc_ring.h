@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "non_copyable.h"
+
+//------------------------------------------------------------------------------------------------
+// Single producer / single consumer ring buffer.
+//
+// The producer fills a slot in place (Reserve/Commit), the consumer takes it out (Front/Pop).
+// Indices are free running, the producer publishes the head with release ordering and
+// the consumer publishes the tail the same way, so no lock is needed between both sides.
+// A full ring never overwrites unread slots: the rejected element is counted as an overflow.
+//------------------------------------------------------------------------------------------------
+
+template <typename T, std::uint32_t SIZE>
+class SpscRing : NonCopyable
+{
+    static_assert((SIZE != 0) && ((SIZE & (SIZE - 1)) == 0), "Ring size must be a power of two");
+
+public:
+
+    SpscRing()
+     : head_(0)
+     , tail_(0)
+     , overflows_(0)
+    { }
+
+    // Producer side
+
+    inline T* Reserve()
+    {
+        const std::uint32_t head = head_.load(std::memory_order_relaxed);
+
+        if((head - tail_.load(std::memory_order_acquire)) == SIZE)
+        {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        return &buffer_[head & (SIZE - 1)];
+    }
+
+    inline void Commit()
+    {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    inline bool Push(const T& element)
+    {
+        T* slot = Reserve();
+
+        if(slot == nullptr)
+        {
+            return false;
+        }
+
+        *slot = element;
+        Commit();
+
+        return true;
+    }
+
+    // Consumer side
+
+    inline const T* Front() const
+    {
+        const std::uint32_t tail = tail_.load(std::memory_order_relaxed);
+
+        if(tail == head_.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        return &buffer_[tail & (SIZE - 1)];
+    }
+
+    inline void Pop()
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    inline bool Pop(T& element)
+    {
+        const T* slot = Front();
+
+        if(slot == nullptr)
+        {
+            return false;
+        }
+
+        element = *slot;
+        Pop();
+
+        return true;
+    }
+
+    // Any side
+
+    inline bool Empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    inline std::uint32_t Overflows() const
+    {
+        return overflows_.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    T buffer_[SIZE];
+
+    alignas(64) std::atomic<std::uint32_t> head_;
+    alignas(64) std::atomic<std::uint32_t> tail_;
+
+    std::atomic<std::uint32_t> overflows_;
+};
+
+//------------------------------------------------------------------------------------------------
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <sys/neutrino.h>
+#include <sys/syspage.h>
+
+#include "log.h"
+#include "non_copyable.h"
+
+//------------------------------------------------------------------------------------------------
+// Latency statistics of one receive pipeline stage, measured in ClockCycles() units.
+// Add() is called from the stage thread, Report() from any thread.
+//------------------------------------------------------------------------------------------------
+
+class StageTiming : NonCopyable
+{
+public:
+
+    explicit StageTiming(const char* name)
+     : name_(name)
+     , count_(0)
+     , sum_(0)
+     , max_(0)
+    { }
+
+    inline void Add(std::uint64_t cycles)
+    {
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(cycles, std::memory_order_relaxed);
+
+        if(cycles > max_.load(std::memory_order_relaxed))
+        {
+            max_.store(cycles, std::memory_order_relaxed);
+        }
+    }
+
+    void Report() const
+    {
+        const std::uint64_t count = count_.load(std::memory_order_relaxed);
+
+        if(count == 0)
+        {
+            return;
+        }
+
+        const std::uint64_t cyclesPerSec = SYSPAGE_ENTRY(qtime)->cycles_per_sec;
+        const std::uint64_t cyclesPerUsec = (cyclesPerSec < 1000000ULL) ? 1 : cyclesPerSec / 1000000ULL;
+
+        LOG(info) << name_ << ": samples: " << count
+                  << " avg: " << (sum_.load(std::memory_order_relaxed) / count) / cyclesPerUsec << " us"
+                  << " max: " << max_.load(std::memory_order_relaxed) / cyclesPerUsec << " us";
+    }
+
+private:
+
+    const char* name_;
+
+    std::atomic<std::uint64_t> count_;
+    std::atomic<std::uint64_t> sum_;
+    std::atomic<std::uint64_t> max_;
+};
+
+//------------------------------------------------------------------------------------------------
@@ -0,0 +1,181 @@
+#include "transmit_queue.h"
+
+//------------------------------------------------------------------------------
+
+TransmitQueue::TransmitQueue()
+ : freeNodes_(NIL)
+ , buckets_(BASE_IDS)
+ , bitmap_()
+ , summary_(0)
+ , frontBase_(BASE_IDS)
+ , size_(0)
+{
+}
+
+//------------------------------------------------------------------------------
+
+std::uint32_t TransmitQueue::AllocateNode(const can_frame& canFrame)
+{
+    std::uint32_t node = freeNodes_;
+
+    if(NIL == node)
+    {
+        node = nodes_.size();
+        nodes_.emplace_back();
+    }
+    else
+    {
+        freeNodes_ = nodes_[node].next_;
+    }
+
+    nodes_[node].frame_ = canFrame;
+    nodes_[node].next_ = NIL;
+
+    return node;
+}
+
+//------------------------------------------------------------------------------
+
+void TransmitQueue::Link(Fifo& fifo, std::uint32_t node, bool head)
+{
+    if(head)
+    {
+        nodes_[node].next_ = fifo.head_;
+        fifo.head_ = node;
+    }
+    else
+    {
+        nodes_[fifo.tail_].next_ = node;
+        fifo.tail_ = node;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void TransmitQueue::Push(const can_frame& canFrame)
+{
+    Insert(canFrame, false);
+}
+
+//------------------------------------------------------------------------------
+
+void TransmitQueue::PushFront(const can_frame& canFrame)
+{
+    Insert(canFrame, true);
+}
+
+//------------------------------------------------------------------------------
+
+void TransmitQueue::Insert(const can_frame& canFrame, bool head)
+{
+    const std::uint32_t key = ArbitrationKey(canFrame.can_id);
+    const std::uint32_t base = key >> 21;
+    const std::uint32_t subKey = key & 0x1FFFFF;
+
+    const std::uint32_t node = AllocateNode(canFrame);
+    const Fifo fifo = { subKey, node, node };
+
+    Bucket& bucket = buckets_[base];
+
+    std::uint64_t& word = bitmap_[base / WORD_BITS];
+    const std::uint64_t bit = 1ULL << (base % WORD_BITS);
+
+    if(0 == (word & bit))
+    {
+        bucket.front_ = fifo;
+
+        word |= bit;
+        summary_ |= 1U << (base / WORD_BITS);
+
+        if(base < frontBase_)
+        {
+            frontBase_ = base;
+        }
+    }
+    else if(bucket.front_.subKey_ == subKey)
+    {
+        Link(bucket.front_, node, head);
+    }
+    else if(subKey < bucket.front_.subKey_)
+    {
+        bucket.rest_.insert(bucket.rest_.begin(), bucket.front_);
+        bucket.front_ = fifo;
+    }
+    else
+    {
+        auto next = bucket.rest_.begin();
+
+        while((next != bucket.rest_.end()) && (next->subKey_ < subKey))
+        {
+            ++next;
+        }
+
+        if((next != bucket.rest_.end()) && (next->subKey_ == subKey))
+        {
+            Link(*next, node, head);
+        }
+        else
+        {
+            bucket.rest_.insert(next, fifo);
+        }
+    }
+
+    ++size_;
+}
+
+//------------------------------------------------------------------------------
+
+const can_frame& TransmitQueue::Front() const
+{
+    return nodes_[buckets_[frontBase_].front_.head_].frame_;
+}
+
+//------------------------------------------------------------------------------
+
+void TransmitQueue::Pop()
+{
+    const std::uint32_t base = frontBase_;
+
+    Bucket& bucket = buckets_[base];
+
+    const std::uint32_t node = bucket.front_.head_;
+
+    if(bucket.front_.tail_ != node)
+    {
+        bucket.front_.head_ = nodes_[node].next_;
+    }
+    else if(!bucket.rest_.empty())
+    {
+        bucket.front_ = bucket.rest_.front();
+        bucket.rest_.erase(bucket.rest_.begin());
+    }
+    else
+    {
+        const std::uint32_t word = base / WORD_BITS;
+
+        bitmap_[word] &= ~(1ULL << (base % WORD_BITS));
+
+        if(0 == bitmap_[word])
+        {
+            summary_ &= ~(1U << word);
+        }
+
+        if(0 == summary_)
+        {
+            frontBase_ = BASE_IDS;
+        }
+        else
+        {
+            const std::uint32_t next = __builtin_ctz(summary_);
+
+            frontBase_ = next * WORD_BITS + __builtin_ctzll(bitmap_[next]);
+        }
+    }
+
+    nodes_[node].next_ = freeNodes_;
+    freeNodes_ = node;
+
+    --size_;
+}
+
+//------------------------------------------------------------------------------
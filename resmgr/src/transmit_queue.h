@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <can.h>
+
+#include "non_copyable.h"
+
+//------------------------------------------------------------------------------
+// Frames waiting for transmission in bus arbitration order.
+//
+// Frames with the same identifier fields leave in the order they were pushed.
+// The queue is bucketed by the 11 bit base identifier, which decides the
+// arbitration of standard and extended frames alike; a bitmap of the
+// non-empty buckets finds the next bucket with two bit scans when the front
+// bucket runs empty. A bucket holds
+// one FIFO per arbitration key, usually only one.
+//------------------------------------------------------------------------------
+
+class TransmitQueue : NonCopyable
+{
+public:
+
+    TransmitQueue();
+
+    void Push(const can_frame& canFrame);
+
+    // Push the frame ahead of the frames with the same identifier fields,
+    // for a frame taken out before them which has to be sent again
+    void PushFront(const can_frame& canFrame);
+
+    // The frame which wins the arbitration, the queue must not be empty
+    const can_frame& Front() const;
+
+    void Pop();
+
+    bool Empty() const { return 0 == size_; }
+
+    std::size_t Size() const { return size_; }
+
+    // Identifier fields in the order they are sent on the bus, the lower key wins:
+    // base identifier, RTR or SRR, IDE, extended identifier, RTR
+    static inline std::uint32_t ArbitrationKey(canid_t canId)
+    {
+        const std::uint32_t rtr = (canId & CAN_RTR_FLAG) ? 1 : 0;
+
+        if(canId & CAN_EFF_FLAG)
+        {
+            const std::uint32_t id = canId & CAN_EFF_MASK;
+
+            return ((id >> 18) << 21) | (1U << 20) | (1U << 19) | ((id & 0x3FFFF) << 1) | rtr;
+        }
+
+        return ((canId & CAN_SFF_MASK) << 21) | (rtr << 20);
+    }
+
+    static inline bool HigherPriority(const can_frame& lhs, const can_frame& rhs)
+    {
+        return ArbitrationKey(lhs.can_id) < ArbitrationKey(rhs.can_id);
+    }
+
+private:
+
+    static const std::uint32_t BASE_IDS = 2048;
+    static const std::uint32_t WORD_BITS = 64;
+    static const std::uint32_t NIL = 0xFFFFFFFF;
+
+    struct Node
+    {
+        can_frame frame_;
+        std::uint32_t next_;
+    };
+
+    struct Fifo
+    {
+        std::uint32_t subKey_;  // arbitration key bits below the base identifier
+        std::uint32_t head_;
+        std::uint32_t tail_;
+    };
+
+    // FIFOs of one base identifier, the one with the lowest key is kept
+    // in place, further keys are rare
+    struct Bucket
+    {
+        Fifo front_;
+        std::vector<Fifo> rest_;    // ascending key order
+    };
+
+    std::uint32_t AllocateNode(const can_frame& canFrame);
+
+    void Insert(const can_frame& canFrame, bool head);
+
+    // Add the node at the head or the tail of the FIFO
+    void Link(Fifo& fifo, std::uint32_t node, bool head);
+
+    // Node pool, free nodes are linked by next_
+    std::vector<Node> nodes_;
+    std::uint32_t freeNodes_;
+
+    // Buckets of the base identifiers, valid if set in bitmap_
+    std::vector<Bucket> buckets_;
+
+    std::uint64_t bitmap_[BASE_IDS / WORD_BITS];
+    std::uint32_t summary_;
+
+    // Lowest non-empty base identifier, BASE_IDS if the queue is empty
+    std::uint32_t frontBase_;
+
+    std::size_t size_;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,78 @@
+//------------------------------------------------------------------------------
+// Chip mapper over plain memory with the register stride of ChipMapperMemory.
+// Kept in its own translation unit, so the benchmark calls it through the
+// virtual interface like the driver does.
+//------------------------------------------------------------------------------
+
+#include <memory>
+
+#include "chip_mapper.h"
+
+namespace
+{
+
+class BufferChipMapper : public ChipMapperBase
+{
+public:
+
+    BufferChipMapper(volatile std::uint8_t* base, std::uint8_t shift)
+     : base_(base)
+     , shift_(shift)
+    {}
+
+    virtual void PutByte(const tPort8* byteAddr, std::uint8_t value) const
+    {
+        base_[reinterpret_cast<std::uintptr_t>(byteAddr) << shift_] = value;
+    }
+
+    virtual std::uint8_t GetByte(const tPort8* byteAddr) const
+    {
+        return base_[reinterpret_cast<std::uintptr_t>(byteAddr) << shift_];
+    }
+
+    virtual void PutWord(const tPort16* byteAddr, std::uint16_t value) const
+    {
+        *reinterpret_cast<tPort16*>(base_ + (reinterpret_cast<std::uintptr_t>(byteAddr) << shift_)) = value;
+    }
+
+    virtual std::uint16_t GetWord(const tPort16* byteAddr) const
+    {
+        return *reinterpret_cast<tPort16*>(base_ + (reinterpret_cast<std::uintptr_t>(byteAddr) << shift_));
+    }
+
+    virtual void PutBlock(const tPort8* byteAddr, const std::uint8_t* data, std::size_t count) const
+    {
+        volatile std::uint8_t* ptReg = base_ + (reinterpret_cast<std::uintptr_t>(byteAddr) << shift_);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            ptReg[i << shift_] = data[i];
+        }
+    }
+
+    virtual void GetBlock(const tPort8* byteAddr, std::uint8_t* data, std::size_t count) const
+    {
+        const volatile std::uint8_t* ptReg = base_ + (reinterpret_cast<std::uintptr_t>(byteAddr) << shift_);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            data[i] = ptReg[i << shift_];
+        }
+    }
+
+private:
+
+    volatile std::uint8_t* base_;
+    std::uint8_t shift_;
+};
+
+}
+
+//------------------------------------------------------------------------------
+
+std::unique_ptr<ChipMapperBase> MakeBufferChipMapper(volatile std::uint8_t* base, std::uint8_t shift)
+{
+    return std::unique_ptr<ChipMapperBase>(new BufferChipMapper(base, shift));
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,188 @@
+//------------------------------------------------------------------------------
+// Blocked readers served per received frame: DelayedQueue against the linear
+// scan of the delayed request vector it replaced.
+//
+// Every reader waits with an 11 bit mask filter for its own identifier, the
+// frames carry pseudo random standard identifiers. A served reader blocks
+// again right after the frame, as a reading client does.
+//------------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <can.h>
+#include <canrm.h>
+
+#include "delayed_queue.h"
+
+namespace
+{
+
+const std::uint32_t FRAMES = 1000000;
+
+struct Waiter
+{
+    std::uint32_t reader_;
+};
+
+bool CheckFilter(std::uint32_t arbitration, const CanMessageFilter& filter)
+{
+    switch(filter.type_)
+    {
+    case CanMessageFilter::ET_AMASK:
+        return (arbitration & filter.acceptanceMask_) == (filter.acceptancePattern_ & filter.acceptanceMask_);
+    case CanMessageFilter::ET_RANGE:
+        return (arbitration >= filter.lower_) && (arbitration <= filter.upper_);
+    default:
+        return true;
+    }
+}
+
+std::vector<std::uint32_t> MakeFrames()
+{
+    std::vector<std::uint32_t> frames(FRAMES);
+    std::uint32_t seed = 12345;
+
+    for(std::uint32_t& id : frames)
+    {
+        seed = seed * 1103515245 + 12345;
+        id = (seed >> 16) & CAN_SFF_MASK;
+    }
+
+    return frames;
+}
+
+std::vector<CanMessageFilter> MakeFilters(std::uint32_t readers)
+{
+    std::vector<CanMessageFilter> filters;
+
+    for(std::uint32_t reader = 0; reader < readers; ++reader)
+    {
+        filters.push_back(CanMessageFilter(CanMessageFilter::ET_AMASK, CAN_SFF_MASK, (reader * 37) & CAN_SFF_MASK));
+    }
+
+    return filters;
+}
+
+// Returns ns per frame and the number of served requests
+double RunLinear(const std::vector<std::uint32_t>& frames, const std::vector<CanMessageFilter>& filters,
+                 std::uint64_t& served)
+{
+    std::vector<Waiter> queue;
+    std::vector<Waiter> woken;
+
+    for(std::uint32_t reader = 0; reader < filters.size(); ++reader)
+    {
+        queue.push_back(Waiter{ reader });
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for(const std::uint32_t id : frames)
+    {
+        auto it = queue.begin();
+
+        while(it != queue.end())
+        {
+            if(CheckFilter(id, filters[it->reader_]))
+            {
+                woken.push_back(*it);
+                it = queue.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        served += woken.size();
+
+        for(const Waiter& waiter : woken)
+        {
+            queue.push_back(waiter);
+        }
+        woken.clear();
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / frames.size();
+}
+
+double RunIndexed(const std::vector<std::uint32_t>& frames, const std::vector<CanMessageFilter>& filters,
+                  std::uint64_t& served)
+{
+    DelayedQueue<Waiter> queue;
+    std::vector<Waiter> woken;
+
+    for(std::uint32_t reader = 0; reader < filters.size(); ++reader)
+    {
+        queue.Push(Waiter{ reader }, &filters[reader]);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for(const std::uint32_t id : frames)
+    {
+        queue.ForEachCandidate(id, [&](const Waiter& waiter)
+        {
+            if(!CheckFilter(id, filters[waiter.reader_]))
+            {
+                return false;
+            }
+
+            woken.push_back(waiter);
+            return true;
+        });
+
+        served += woken.size();
+
+        for(const Waiter& waiter : woken)
+        {
+            queue.Push(waiter, &filters[waiter.reader_]);
+        }
+        woken.clear();
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / frames.size();
+}
+
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    const std::vector<std::uint32_t> frames = MakeFrames();
+
+    std::printf("%8s %14s %14s\n", "readers", "linear ns/fr", "indexed ns/fr");
+
+    for(const std::uint32_t readers : { 1u, 4u, 8u, 16u, 100u, 1000u })
+    {
+        const std::vector<CanMessageFilter> filters = MakeFilters(readers);
+
+        std::uint64_t linearServed = 0;
+        std::uint64_t indexedServed = 0;
+
+        const double linear = RunLinear(frames, filters, linearServed);
+        const double indexed = RunIndexed(frames, filters, indexedServed);
+
+        if(linearServed != indexedServed)
+        {
+            std::printf("served requests differ: %llu linear, %llu indexed\n",
+                        static_cast<unsigned long long>(linearServed),
+                        static_cast<unsigned long long>(indexedServed));
+            return 1;
+        }
+
+        std::printf("%8u %14.1f %14.1f\n", readers, linear, indexed);
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,299 @@
+//------------------------------------------------------------------------------
+// Device probe of the PCAN family against simulated PCI functions.
+//------------------------------------------------------------------------------
+
+#include <cstdio>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "pcan_probe.h"
+
+namespace
+{
+
+int failures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if(!(condition)) \
+        { \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++failures; \
+        } \
+    } while(0)
+
+// Functions by vendor and device ID in enumeration order
+class MockPciEnumerator : public PciEnumerator
+{
+public:
+
+    struct Function
+    {
+        std::uint32_t bdf_;
+        bool ssidValid_;
+        std::uint16_t ssid_;
+    };
+
+    void Add(std::uint16_t vendorId, std::uint16_t deviceId, const Function& function)
+    {
+        functions_[std::make_pair(vendorId, deviceId)].push_back(function);
+    }
+
+    virtual bool Find(unsigned index, std::uint16_t vendorId, std::uint16_t deviceId, std::uint32_t& bdf)
+    {
+        const auto it = functions_.find(std::make_pair(vendorId, deviceId));
+
+        if((it == functions_.end()) || (index >= it->second.size()))
+        {
+            return false;
+        }
+
+        bdf = it->second[index].bdf_;
+
+        return true;
+    }
+
+    virtual bool ReadSubsystemId(std::uint32_t bdf, std::uint16_t& ssid)
+    {
+        ++ssidReads_;
+
+        for(const auto& entry: functions_)
+        {
+            for(const auto& function: entry.second)
+            {
+                if((function.bdf_ == bdf) && function.ssidValid_)
+                {
+                    ssid = function.ssid_;
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    unsigned ssidReads_ = 0;
+
+private:
+
+    std::map<std::pair<std::uint16_t, std::uint16_t>, std::vector<Function>> functions_;
+};
+
+const std::uint16_t PEAK = PcanProbe::VENDOR_PEAK_CAN;
+
+// The shipped table is clocked at 16 MHz only, the 20 MHz entry checks the clock filter
+const PcanModel TEST_MODELS[] =
+{
+    { 0x0001, "four channels",  4, 0, 1, 0x400, 2, 16000000 },
+    { 0x0002, "two channels",   2, 0, 1, 0x400, 2, 16000000 },
+    { 0x0003, "20 MHz",         4, 0, 1, 0x400, 2, 20000000 },
+    { 0x0004, "other BARs",     4, 2, 3, 0x200, 0, 16000000 },
+};
+
+const std::size_t TEST_MODEL_COUNT = sizeof(TEST_MODELS) / sizeof(TEST_MODELS[0]);
+
+PcanDevice Device(const PcanModel& model, std::uint16_t ssid, bool ssidValid = true)
+{
+    return PcanDevice{ &model, 0, 0, ssidValid, ssid };
+}
+
+//------------------------------------------------------------------------------
+
+void TestNothingFound()
+{
+    MockPciEnumerator enumerator;
+
+    enumerator.Add(0x10EE, 0x0001, { 0x100, true, 12 });   // same device ID, other vendor
+
+    PcanProbe probe(enumerator);
+
+    CHECK(probe.FindDevices().empty());
+    CHECK(probe.UnsupportedModels().empty());
+}
+
+void TestModelAndEnumerationOrder()
+{
+    MockPciEnumerator enumerator;
+
+    enumerator.Add(PEAK, 0x0002, { 0x300, true, 4 });
+    enumerator.Add(PEAK, 0x0001, { 0x200, true, 12 });
+    enumerator.Add(PEAK, 0x0001, { 0x100, false, 0 });
+    enumerator.Add(PEAK, 0x0004, { 0x400, true, 10 });
+
+    PcanProbe probe(enumerator, TEST_MODELS, TEST_MODEL_COUNT);
+
+    const std::vector<PcanDevice> devices = probe.FindDevices();
+
+    CHECK(devices.size() == 4);
+
+    if(devices.size() == 4)
+    {
+        CHECK(devices[0].model_ == &TEST_MODELS[0]);
+        CHECK(devices[0].bdf_ == 0x200);
+        CHECK(devices[0].index_ == 0);
+        CHECK(devices[0].ssidValid_ && (devices[0].ssid_ == 12));
+
+        CHECK(devices[1].model_ == &TEST_MODELS[0]);
+        CHECK(devices[1].bdf_ == 0x100);
+        CHECK(devices[1].index_ == 1);
+        CHECK(!devices[1].ssidValid_);
+
+        CHECK(devices[2].model_ == &TEST_MODELS[1]);
+        CHECK(devices[2].bdf_ == 0x300);
+
+        CHECK(devices[3].model_ == &TEST_MODELS[3]);
+        CHECK(devices[3].bdf_ == 0x400);
+    }
+}
+
+void TestUnsupportedClock()
+{
+    MockPciEnumerator enumerator;
+
+    enumerator.Add(PEAK, 0x0003, { 0x100, true, 12 });
+    enumerator.Add(PEAK, 0x0003, { 0x200, true, 12 });
+    enumerator.Add(PEAK, 0x0002, { 0x300, true, 4 });
+
+    PcanProbe probe(enumerator, TEST_MODELS, TEST_MODEL_COUNT);
+
+    const std::vector<PcanDevice> devices = probe.FindDevices();
+
+    CHECK(devices.size() == 1);
+    CHECK(!devices.empty() && (devices[0].bdf_ == 0x300));
+
+    // the skipped cards are reported, their subsystem ID is not read
+    CHECK(probe.UnsupportedModels().size() == 2);
+    CHECK(!probe.UnsupportedModels().empty() && (probe.UnsupportedModels()[0] == &TEST_MODELS[2]));
+    CHECK(enumerator.ssidReads_ == 1);
+}
+
+void TestShippedTable()
+{
+    MockPciEnumerator enumerator;
+
+    for(std::size_t m = 0; m < PcanProbe::MODEL_COUNT; ++m)
+    {
+        enumerator.Add(PEAK, PcanProbe::MODELS[m].deviceId_, { std::uint32_t(m), true, 12 });
+    }
+
+    PcanProbe probe(enumerator);
+
+    const std::vector<PcanDevice> devices = probe.FindDevices();
+
+    CHECK(devices.size() == PcanProbe::MODEL_COUNT);
+    CHECK(probe.UnsupportedModels().empty());
+
+    for(const auto& device: devices)
+    {
+        CHECK(device.model_->maxChannels_ <= PcanProbe::MAX_CHANNELS);
+        CHECK(PcanProbe::ChannelCount(device, 4 * device.model_->channelSize_) == device.model_->maxChannels_);
+    }
+}
+
+void TestChannelCount()
+{
+    const PcanModel& four = TEST_MODELS[0];
+    const PcanModel& two = TEST_MODELS[1];
+
+    const std::uint64_t window = four.channelSize_;
+
+    // subsystem ID ranges
+    CHECK(PcanProbe::ChannelCount(Device(four, 0), 4 * window) == 1);
+    CHECK(PcanProbe::ChannelCount(Device(four, 3), 4 * window) == 1);
+    CHECK(PcanProbe::ChannelCount(Device(four, 4), 4 * window) == 2);
+    CHECK(PcanProbe::ChannelCount(Device(four, 9), 4 * window) == 2);
+    CHECK(PcanProbe::ChannelCount(Device(four, 10), 4 * window) == 3);
+    CHECK(PcanProbe::ChannelCount(Device(four, 11), 4 * window) == 3);
+    CHECK(PcanProbe::ChannelCount(Device(four, 12), 4 * window) == 4);
+    CHECK(PcanProbe::ChannelCount(Device(four, 0xFFFF), 4 * window) == 4);
+
+    // unreadable subsystem ID
+    CHECK(PcanProbe::ChannelCount(Device(four, 12, false), 4 * window) == 1);
+
+    // bounded by the model
+    CHECK(PcanProbe::ChannelCount(Device(two, 12), 4 * window) == 2);
+
+    // bounded by the register windows of the chip BAR, at least one
+    CHECK(PcanProbe::ChannelCount(Device(four, 12), 3 * window) == 3);
+    CHECK(PcanProbe::ChannelCount(Device(four, 12), 2 * window + window / 2) == 2);
+    CHECK(PcanProbe::ChannelCount(Device(four, 12), window / 2) == 1);
+    CHECK(PcanProbe::ChannelCount(Device(four, 12), 0) == 1);
+}
+
+void TestSelectBars()
+{
+    const PcanModel& standard = TEST_MODELS[0];
+    const PcanModel& other = TEST_MODELS[3];
+
+    PcanBar config = {};
+    PcanBar chip = {};
+
+    const std::vector<PcanBar> bars =
+    {
+        { 0, 0xF0000000, 0x1000, true },
+        { 1, 0xF0001000, 0x1000, true },
+        { 2, 0x0000E000, 0x0100, false },
+        { 3, 0xF0002000, 0x0800, true },
+    };
+
+    CHECK(PcanProbe::SelectBars(standard, bars, config, chip));
+    CHECK((config.number_ == 0) && (config.address_ == 0xF0000000));
+    CHECK((chip.number_ == 1) && (chip.address_ == 0xF0001000) && (chip.size_ == 0x1000));
+
+    // the configuration BAR may be I/O, the chip BAR has to be memory
+    CHECK(PcanProbe::SelectBars(other, bars, config, chip));
+    CHECK((config.number_ == 2) && !config.memory_);
+    CHECK((chip.number_ == 3) && (chip.size_ == 0x800));
+
+    const std::vector<PcanBar> ioChip =
+    {
+        { 0, 0xF0000000, 0x1000, true },
+        { 1, 0x0000E000, 0x0100, false },
+    };
+
+    CHECK(!PcanProbe::SelectBars(standard, ioChip, config, chip));
+
+    const std::vector<PcanBar> noChip =
+    {
+        { 0, 0xF0000000, 0x1000, true },
+        { 2, 0xF0001000, 0x1000, true },
+    };
+
+    CHECK(!PcanProbe::SelectBars(standard, noChip, config, chip));
+
+    const std::vector<PcanBar> noConfig =
+    {
+        { 1, 0xF0001000, 0x1000, true },
+    };
+
+    CHECK(!PcanProbe::SelectBars(standard, noConfig, config, chip));
+    CHECK(!PcanProbe::SelectBars(standard, std::vector<PcanBar>(), config, chip));
+}
+
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    TestNothingFound();
+    TestModelAndEnumerationOrder();
+    TestUnsupportedClock();
+    TestShippedTable();
+    TestChannelCount();
+    TestSelectBars();
+
+    if(0 != failures)
+    {
+        std::printf("pcan_probe_test: %d check(s) failed\n", failures);
+        return 1;
+    }
+
+    std::printf("pcan_probe_test: passed\n");
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
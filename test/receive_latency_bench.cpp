@@ -0,0 +1,169 @@
+//------------------------------------------------------------------------------
+// Latency from the interrupt handling thread committing a frame to the reader
+// taking it out of the receive ring.
+//
+// The polling reader is the loop ReadMessage had before the SpscRing: it
+// tests the ring without the lock and sleeps in wait_for(2 ms), so a notify
+// between the test and the wait is only seen at the next timeout. The event
+// reader waits with the predicate under the lock, as ReadMessage does now.
+//------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+
+namespace
+{
+
+const std::uint32_t FRAMES = 20000;
+const std::uint32_t RING_SIZE = 1024;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Frame
+{
+    Clock::time_point committed_;
+};
+
+struct Receiver
+{
+    SpscRing<Frame, RING_SIZE> ring_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::atomic<bool> running_ { true };
+    std::uint64_t wakeups_ = 0;
+};
+
+// Like the old ReadMessage
+bool PollingRead(Receiver& receiver, Frame& frame)
+{
+    while(receiver.ring_.Empty() && receiver.running_)
+    {
+        std::unique_lock<std::mutex> lock(receiver.mutex_);
+        receiver.cond_.wait_for(lock, std::chrono::milliseconds(2));
+        ++receiver.wakeups_;
+    }
+
+    return receiver.ring_.Pop(frame);
+}
+
+// Like ReadMessage
+bool EventRead(Receiver& receiver, Frame& frame)
+{
+    std::unique_lock<std::mutex> lock(receiver.mutex_);
+
+    if(receiver.ring_.Empty())
+    {
+        receiver.cond_.wait(lock, [&receiver] { return !receiver.ring_.Empty() || !receiver.running_; });
+        ++receiver.wakeups_;
+    }
+
+    return receiver.ring_.Pop(frame);
+}
+
+std::uint32_t Random(std::uint32_t& seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+template <class Read>
+void Run(const char* name, Read read)
+{
+    Receiver receiver;
+    std::vector<std::uint64_t> latencies;
+
+    latencies.reserve(FRAMES);
+
+    std::thread reader([&receiver, &latencies, read]
+    {
+        Frame frame;
+
+        while(latencies.size() < FRAMES)
+        {
+            if(read(receiver, frame))
+            {
+                latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - frame.committed_).count());
+            }
+        }
+    });
+
+    // Frames arrive one by one with gaps of 20 to 200 us, as ProcessMessageBuffer signals them
+    std::uint32_t seed = 3;
+
+    for(std::uint32_t i = 0; i < FRAMES; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(20 + Random(seed) % 180));
+
+        Frame frame;
+        frame.committed_ = Clock::now();
+
+        receiver.ring_.Push(frame);
+
+        std::unique_lock<std::mutex> lock(receiver.mutex_);
+        receiver.cond_.notify_all();
+    }
+
+    reader.join();
+
+    // Wakeups of an idle reader
+    const std::uint64_t busyWakeups = receiver.wakeups_;
+    const auto idle = std::chrono::milliseconds(200);
+
+    std::thread idleReader([&receiver, read]
+    {
+        Frame frame;
+
+        while(receiver.running_)
+        {
+            read(receiver, frame);
+        }
+    });
+
+    std::this_thread::sleep_for(idle);
+
+    std::uint64_t idleWakeups;
+
+    {
+        std::unique_lock<std::mutex> lock(receiver.mutex_);
+        idleWakeups = receiver.wakeups_ - busyWakeups;
+        receiver.running_ = false;
+        receiver.cond_.notify_all();
+    }
+
+    idleReader.join();
+
+    std::sort(latencies.begin(), latencies.end());
+
+    std::printf("%-10s %10.1f %10.1f %10.1f %10.1f %12.0f\n", name,
+                latencies[latencies.size() / 2] / 1000.0,
+                latencies[latencies.size() * 99 / 100] / 1000.0,
+                latencies[latencies.size() * 999 / 1000] / 1000.0,
+                latencies.back() / 1000.0,
+                idleWakeups * 1000.0 / idle.count());
+}
+
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    std::printf("%-10s %10s %10s %10s %10s %12s\n", "reader", "p50 us", "p99 us", "p99.9 us", "max us", "idle wake/s");
+
+    Run("polling", PollingRead);
+    Run("event", EventRead);
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
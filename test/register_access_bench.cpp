@@ -0,0 +1,142 @@
+//------------------------------------------------------------------------------
+// Cycles per frame of the SJA1000 frame copy with the compile time register
+// access (DirectRegisterAccess<2>, as for the PCAN cards) and with the
+// virtual chip mapper interface (MapperRegisterAccess), both over a memory
+// buffer standing in for the mapped chip.
+//
+// Every round takes an 8 byte extended frame out of the receive registers and
+// writes it to the transmit registers, as ReadReceiveBuffer and
+// TransmitMessage do.
+//------------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <can.h>
+
+#include "chip_mapper.h"
+#include "register_access.h"
+#include "sja1000_registers.h"
+
+std::unique_ptr<ChipMapperBase> MakeBufferChipMapper(volatile std::uint8_t* base, std::uint8_t shift);
+
+namespace
+{
+
+const std::uint32_t FRAMES = 4000000;
+const std::uint8_t SHIFT = 2;
+const canid_t FRAME_ID = CAN_EFF_FLAG | 0x12345678;
+
+// Registers of the chip, 1 << SHIFT bytes apart
+volatile std::uint8_t chip[sizeof(SJA1000Registers::SJA1000Map) << SHIFT];
+
+class Test : public SJA1000Registers
+{
+public:
+
+    static void LoadReceiveBuffer()
+    {
+        const std::uint32_t arbitration = (FRAME_ID & CAN_EFF_MASK) << 3;
+        const std::uint8_t registers[] =
+        {
+            EXTENDED_FRAME_FORMAT | 8,
+            std::uint8_t(arbitration >> 24), std::uint8_t(arbitration >> 16),
+            std::uint8_t(arbitration >> 8), std::uint8_t(arbitration),
+            0, 1, 2, 3, 4, 5, 6, 7
+        };
+
+        const std::size_t offset = reinterpret_cast<std::uintptr_t>(&sja1000Map_->RxTxFrInf);
+
+        for(std::size_t i = 0; i < sizeof(registers); ++i)
+        {
+            chip[(offset + i) << SHIFT] = registers[i];
+        }
+    }
+};
+
+inline std::uint64_t Cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+bool Valid(const can_frame& canFrame)
+{
+    static const std::uint8_t data[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+    return (FRAME_ID == canFrame.can_id) && (8 == canFrame.len) && (0 == memcmp(data, canFrame.data, 8));
+}
+
+template <class Access>
+bool Run(const char* name, Access& access)
+{
+    can_frame canFrame = can_frame();
+    std::uint64_t readCycles = 0;
+    std::uint64_t writeCycles = 0;
+    bool valid = true;
+
+    for(std::uint32_t i = 0; i < FRAMES; ++i)
+    {
+        const std::uint64_t start = Cycles();
+
+        SJA1000Registers::ReadFrame(access, canFrame);
+
+        const std::uint64_t read = Cycles();
+
+        SJA1000Registers::WriteFrame(access, canFrame);
+
+        writeCycles += Cycles() - read;
+        readCycles += read - start;
+
+        valid = valid && Valid(canFrame);
+    }
+
+    std::printf("%-28s %12.1f %12.1f %12.1f\n", name, double(readCycles) / FRAMES, double(writeCycles) / FRAMES,
+                double(access.Reads()) / FRAMES);
+
+    return valid;
+}
+
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    Test::LoadReceiveBuffer();
+
+    const std::unique_ptr<ChipMapperBase> mapper = MakeBufferChipMapper(chip, SHIFT);
+
+    DirectRegisterAccess<SHIFT> direct(chip);
+    MapperRegisterAccess virtualMapper(*mapper);
+
+#if defined(__x86_64__) || defined(__i386__)
+    std::printf("%-28s %12s %12s %12s\n", "register access", "rx cyc/fr", "tx cyc/fr", "reads/fr");
+#else
+    std::printf("%-28s %12s %12s %12s\n", "register access", "rx ns/fr", "tx ns/fr", "reads/fr");
+#endif
+
+    bool valid = Run("DirectRegisterAccess<2>", direct);
+    valid = Run("MapperRegisterAccess", virtualMapper) && valid;
+
+    if(!valid)
+    {
+        std::printf("register_access_bench: frame read back wrong\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,199 @@
+//------------------------------------------------------------------------------
+// Push and drain throughput of TransmitQueue against the std::priority_queue
+// ordered by can_id & CAN_EFF_MASK it replaced.
+//
+// Each round pushes a burst of frames and drains the queue, as a writer
+// filling the queue faster than the bus takes it.
+//------------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+#include <can.h>
+
+#include "transmit_queue.h"
+
+namespace
+{
+
+const std::uint32_t FRAMES = 4000000;
+
+struct Comp
+{
+    bool operator() (const can_frame& lhs, const can_frame& rhs)
+    {
+        return (lhs.can_id & CAN_EFF_MASK) > (rhs.can_id & CAN_EFF_MASK);
+    }
+};
+
+typedef std::priority_queue<can_frame, std::vector<can_frame>, Comp> PriorityQueue;
+
+// Write order of the frame in its data bytes
+void SetSequence(can_frame& canFrame, std::uint32_t sequence)
+{
+    memcpy(canFrame.data, &sequence, sizeof(sequence));
+}
+
+std::uint32_t Sequence(const can_frame& canFrame)
+{
+    std::uint32_t sequence;
+    memcpy(&sequence, canFrame.data, sizeof(sequence));
+    return sequence;
+}
+
+std::uint32_t Random(std::uint32_t& seed)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// Bursts of 16 extended identifiers in write order
+std::vector<can_frame> ExtendedFrames(std::size_t count)
+{
+    std::vector<can_frame> frames(count);
+    std::uint32_t seed = 1;
+    std::uint32_t ids[16];
+
+    for(auto& id: ids)
+    {
+        id = CAN_EFF_FLAG | (Random(seed) & CAN_EFF_MASK);
+    }
+
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        frames[i] = can_frame();
+        frames[i].can_id = ids[i % 16];
+        frames[i].len = 8;
+        SetSequence(frames[i], i);
+    }
+
+    return frames;
+}
+
+std::vector<can_frame> StandardFrames(std::size_t count)
+{
+    std::vector<can_frame> frames(count);
+    std::uint32_t seed = 2;
+
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        frames[i] = can_frame();
+        frames[i].can_id = Random(seed) & CAN_SFF_MASK;
+        frames[i].len = 8;
+        SetSequence(frames[i], i);
+    }
+
+    return frames;
+}
+
+template <class Queue, class Push, class Front, class Pop>
+double Run(const std::vector<can_frame>& frames, std::size_t depth, Push push, Front front, Pop pop,
+           std::uint64_t& checksum)
+{
+    Queue queue;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for(std::size_t i = 0; i < frames.size(); i += depth)
+    {
+        for(std::size_t n = 0; n < depth; ++n)
+        {
+            push(queue, frames[i + n]);
+        }
+
+        for(std::size_t n = 0; n < depth; ++n)
+        {
+            checksum += front(queue).can_id;
+            pop(queue);
+        }
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / frames.size();
+}
+
+// TransmitQueue leaves in arbitration order, equal identifiers in write order
+bool CheckOrder(const std::vector<can_frame>& frames, std::size_t depth)
+{
+    TransmitQueue queue;
+
+    for(std::size_t i = 0; i < depth; ++i)
+    {
+        queue.Push(frames[i]);
+    }
+
+    can_frame previous = queue.Front();
+    queue.Pop();
+
+    while(!queue.Empty())
+    {
+        const can_frame& next = queue.Front();
+
+        if(TransmitQueue::HigherPriority(next, previous) ||
+           ((next.can_id == previous.can_id) && (Sequence(next) < Sequence(previous))))
+        {
+            return false;
+        }
+
+        previous = next;
+        queue.Pop();
+    }
+
+    return true;
+}
+
+bool Compare(const char* name, const std::vector<can_frame>& frames, std::size_t depth)
+{
+    std::uint64_t priorityChecksum = 0;
+    std::uint64_t transmitChecksum = 0;
+
+    const double priority = Run<PriorityQueue>(frames, depth,
+        [](PriorityQueue& q, const can_frame& f) { q.push(f); },
+        [](PriorityQueue& q) -> const can_frame& { return q.top(); },
+        [](PriorityQueue& q) { q.pop(); },
+        priorityChecksum);
+
+    const double transmit = Run<TransmitQueue>(frames, depth,
+        [](TransmitQueue& q, const can_frame& f) { q.Push(f); },
+        [](TransmitQueue& q) -> const can_frame& { return q.Front(); },
+        [](TransmitQueue& q) { q.Pop(); },
+        transmitChecksum);
+
+    const bool ordered = (depth < 2) || CheckOrder(frames, depth);
+
+    std::printf("%-24s %6zu %16.1f %16.1f\n", name, depth, priority, transmit);
+
+    return (priorityChecksum == transmitChecksum) && ordered;
+}
+
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    const std::vector<can_frame> extended = ExtendedFrames(FRAMES);
+    const std::vector<can_frame> standard = StandardFrames(FRAMES);
+
+    std::printf("%-24s %6s %16s %16s\n", "frames", "depth", "priority ns/fr", "transmit ns/fr");
+
+    bool valid = Compare("16 extended ids", extended, 256);
+    valid = Compare("random standard ids", standard, 256) && valid;
+    valid = Compare("random standard ids", standard, 16) && valid;
+    valid = Compare("random standard ids", standard, 1) && valid;
+
+    if(!valid)
+    {
+        std::printf("transmit_queue_bench: frames or their order differ\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
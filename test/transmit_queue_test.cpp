@@ -0,0 +1,195 @@
+//------------------------------------------------------------------------------
+// Transmit order of TransmitQueue, with frames requeued after an aborted
+// transmission.
+//------------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <can.h>
+
+#include "transmit_queue.h"
+
+namespace
+{
+
+int failures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if(!(condition)) \
+        { \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++failures; \
+        } \
+    } while(0)
+
+// Frame with its write order in the first data byte
+can_frame Frame(canid_t canId, std::uint8_t sequence)
+{
+    can_frame canFrame = can_frame();
+
+    canFrame.can_id = canId;
+    canFrame.len = 1;
+    canFrame.data[0] = sequence;
+
+    return canFrame;
+}
+
+// Write orders of the frames in transmit order, the queue is drained
+std::vector<int> Drain(TransmitQueue& queue)
+{
+    std::vector<int> order;
+
+    while(!queue.Empty())
+    {
+        order.push_back(queue.Front().data[0]);
+        queue.Pop();
+    }
+
+    return order;
+}
+
+// Take the front frame as the controller does when it fills the transmit buffer
+can_frame Take(TransmitQueue& queue)
+{
+    const can_frame canFrame = queue.Front();
+    queue.Pop();
+
+    return canFrame;
+}
+
+//------------------------------------------------------------------------------
+
+void TestArbitrationOrder()
+{
+    TransmitQueue queue;
+
+    queue.Push(Frame(0x200, 1));
+    queue.Push(Frame(0x100, 2));
+    queue.Push(Frame(0x200, 3));
+    queue.Push(Frame(CAN_EFF_FLAG | (0x100 << 18), 4));   // same base identifier, IDE loses
+    queue.Push(Frame(CAN_RTR_FLAG | 0x100, 5));            // RTR loses against the data frame
+    queue.Push(Frame(0x100, 6));
+
+    CHECK(queue.Size() == 6);
+    CHECK((Drain(queue) == std::vector<int>{ 2, 6, 5, 4, 1, 3 }));
+    CHECK(queue.Size() == 0);
+}
+
+void TestRequeueAheadOfSameId()
+{
+    TransmitQueue queue;
+
+    queue.Push(Frame(0x123, 1));
+    queue.Push(Frame(0x123, 2));
+
+    const can_frame aborted = Take(queue);
+
+    queue.Push(Frame(0x123, 3));
+    queue.PushFront(aborted);
+
+    CHECK((Drain(queue) == std::vector<int>{ 1, 2, 3 }));
+}
+
+void TestRequeueIntoEmptyQueue()
+{
+    TransmitQueue queue;
+
+    queue.Push(Frame(0x123, 1));
+
+    const can_frame aborted = Take(queue);
+
+    CHECK(queue.Empty());
+
+    queue.PushFront(aborted);
+    queue.Push(Frame(0x123, 2));
+
+    CHECK(queue.Size() == 2);
+    CHECK((Drain(queue) == std::vector<int>{ 1, 2 }));
+}
+
+void TestRequeueKeepsArbitration()
+{
+    TransmitQueue queue;
+
+    queue.Push(Frame(0x300, 1));
+
+    const can_frame aborted = Take(queue);
+
+    // the higher priority frame which caused the abort
+    queue.Push(Frame(0x010, 2));
+    queue.Push(Frame(0x300, 3));
+    queue.Push(Frame(0x400, 4));
+    queue.PushFront(aborted);
+
+    CHECK((Drain(queue) == std::vector<int>{ 2, 1, 3, 4 }));
+}
+
+void TestRequeueBehindLowerKeyOfBucket()
+{
+    const canid_t extended = CAN_EFF_FLAG | (0x123 << 18) | 0x55;
+
+    TransmitQueue queue;
+
+    queue.Push(Frame(extended, 1));
+    queue.Push(Frame(extended, 2));
+
+    const can_frame aborted = Take(queue);
+
+    // the standard frame of the same base identifier heads the bucket now,
+    // the extended frames are in a further FIFO of it
+    queue.Push(Frame(0x123, 3));
+    queue.Push(Frame(extended, 4));
+    queue.PushFront(aborted);
+
+    CHECK((Drain(queue) == std::vector<int>{ 3, 1, 2, 4 }));
+}
+
+void TestRequeueAfterRepeatedAborts()
+{
+    TransmitQueue queue;
+
+    for(int i = 1; i <= 4; ++i)
+    {
+        queue.Push(Frame(0x7FF, i));
+    }
+
+    // the same frame is aborted twice, the next ones are taken in between
+    can_frame aborted = Take(queue);
+    queue.PushFront(aborted);
+
+    aborted = Take(queue);
+    queue.Push(Frame(0x7FF, 5));
+    queue.PushFront(aborted);
+
+    CHECK((Drain(queue) == std::vector<int>{ 1, 2, 3, 4, 5 }));
+}
+
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    TestArbitrationOrder();
+    TestRequeueAheadOfSameId();
+    TestRequeueIntoEmptyQueue();
+    TestRequeueKeepsArbitration();
+    TestRequeueBehindLowerKeyOfBucket();
+    TestRequeueAfterRepeatedAborts();
+
+    if(0 != failures)
+    {
+        std::printf("transmit_queue_test: %d check(s) failed\n", failures);
+        return 1;
+    }
+
+    std::printf("transmit_queue_test: passed\n");
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------